@@ -0,0 +1,251 @@
+#include "autosave.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace tetris
+{
+
+  namespace
+  {
+    const char magic[4] = {'T', 'S', 'A', 'V'};
+    const std::uint16_t current_version = 1;
+    const std::size_t header_bytes = 4 + 2 + 2 + 2 + 4 + 8 + 4 * 4 + 2 * 2 + 1 + 1 + 2;
+
+    void put(std::vector<std::uint8_t> &out, std::uint64_t value, int bytes)
+    {
+      for (int i = 0; i < bytes; ++i)
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+
+    std::uint64_t get(const std::vector<std::uint8_t> &in, std::size_t &at, int bytes)
+    {
+      std::uint64_t value = 0;
+      for (int i = 0; i < bytes; ++i)
+        value |= std::uint64_t(in[at++]) << (8 * i);
+      return value;
+    }
+
+    std::uint32_t fnv1a(const std::uint8_t *bytes, std::size_t count)
+    {
+      std::uint32_t hash = 2166136261u;
+      for (std::size_t i = 0; i < count; ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+      return hash;
+    }
+
+    // minstd_rand's whole state is one number below 2^31, but the standard only lets it out
+    // through the stream operators
+    std::uint32_t rng_state(const std::minstd_rand &rng)
+    {
+      std::ostringstream text;
+      text << rng;
+      return static_cast<std::uint32_t>(std::stoul(text.str()));
+    }
+
+    std::minstd_rand rng_from(std::uint32_t state)
+    {
+      std::minstd_rand rng;
+      std::istringstream text(std::to_string(state));
+      text >> rng;
+      return rng;
+    }
+
+    // the falling piece's 4x4 box as it always went in the file, a bit per cell row by row. the
+    // board has it from its block and rotation now, it stays in the file as a check on them
+    std::uint16_t piece_mask(const BoardState &board)
+    {
+      const PieceShape &shape = PieceSet::standard().shape(board.block, board.rotation);
+      std::uint16_t mask = 0;
+      for (int i = 0; i < shape.cell_count; ++i)
+        mask |= 1 << (shape.cells_y[i] * 4 + shape.cells_x[i]);
+      return mask;
+    }
+
+    void write_atomically(const std::string &path, const std::vector<std::uint8_t> &bytes)
+    {
+      std::string temporary = path + ".tmp";
+      int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd < 0)
+        throw std::runtime_error("Cannot write the saved game " + temporary);
+      bool ok = write(fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size()) && fsync(fd) == 0;
+      ok = close(fd) == 0 && ok;
+      if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+      {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot write the saved game " + path);
+      }
+    }
+  }
+
+  void encode_save(const SaveGame &save, std::vector<std::uint8_t> &out)
+  {
+    const BoardState &board = save.board;
+    std::size_t cells = static_cast<std::size_t>(save.width) * save.height;
+    out.clear();
+    out.reserve(header_bytes + (cells + 1) / 2 + 4);
+
+    out.insert(out.end(), magic, magic + 4);
+    put(out, current_version, 2);
+    put(out, save.width, 2);
+    put(out, save.height, 2);
+    put(out, save.seed, 4);
+    put(out, static_cast<std::uint64_t>(save.tick), 8);
+    put(out, static_cast<std::uint32_t>(board.score), 4);
+    put(out, static_cast<std::uint32_t>(board.lines_cleared), 4);
+    put(out, static_cast<std::uint32_t>(board.pieces), 4);
+    put(out, rng_state(board.rng), 4);
+    put(out, static_cast<std::uint16_t>(board.b_x), 2);
+    put(out, static_cast<std::uint16_t>(board.b_y), 2);
+    put(out, static_cast<std::uint8_t>(board.block), 1);
+    put(out, static_cast<std::uint8_t>(board.rotation), 1);
+
+    put(out, piece_mask(board), 2);
+
+    // colors go up to 7, two of them fit in a byte
+    for (std::size_t i = 0; i < cells; i += 2)
+    {
+      std::uint8_t low = board.cells[i] & 15;
+      std::uint8_t high = i + 1 < cells ? board.cells[i + 1] & 15 : 0;
+      out.push_back(static_cast<std::uint8_t>(low | high << 4));
+    }
+
+    put(out, fnv1a(out.data(), out.size()), 4);
+  }
+
+  SaveGame decode_save(const std::vector<std::uint8_t> &bytes)
+  {
+    if (bytes.size() < header_bytes + 4 || !std::equal(magic, magic + 4, bytes.begin()))
+      throw std::runtime_error("not a saved game");
+
+    std::size_t at = 4;
+    if (get(bytes, at, 2) != current_version)
+      throw std::runtime_error("a saved game from another version");
+
+    SaveGame save;
+    save.width = static_cast<int>(get(bytes, at, 2));
+    save.height = static_cast<int>(get(bytes, at, 2));
+    if (save.width < 5 || save.width > 50 || save.height < 5 || save.height > 50)
+      throw std::runtime_error("a saved game with a bad board size");
+    std::size_t cells = static_cast<std::size_t>(save.width) * save.height;
+    std::size_t total = header_bytes + (cells + 1) / 2 + 4;
+    std::size_t body = total - 4;
+    if (bytes.size() != total || fnv1a(bytes.data(), body) != static_cast<std::uint32_t>(get(bytes, body, 4)))
+      throw std::runtime_error("a saved game that is cut short or damaged");
+
+    BoardState &board = save.board;
+    save.seed = static_cast<unsigned>(get(bytes, at, 4));
+    save.tick = static_cast<long long>(get(bytes, at, 8));
+    board.score = static_cast<int>(get(bytes, at, 4));
+    board.lines_cleared = static_cast<int>(get(bytes, at, 4));
+    board.pieces = static_cast<int>(get(bytes, at, 4));
+    board.rng = rng_from(static_cast<std::uint32_t>(get(bytes, at, 4)));
+    board.b_x = static_cast<std::int16_t>(get(bytes, at, 2));
+    board.b_y = static_cast<std::int16_t>(get(bytes, at, 2));
+    board.block = static_cast<int>(get(bytes, at, 1));
+    board.rotation = static_cast<int>(get(bytes, at, 1));
+    if (board.block < 1 || board.block > 7 || board.rotation > 3)
+      throw std::runtime_error("a saved game with a bad piece");
+
+    if (get(bytes, at, 2) != piece_mask(board))
+      throw std::runtime_error("a saved game with a bad piece");
+
+    board.cells.resize(cells);
+    for (std::size_t i = 0; i < cells; ++i)
+    {
+      std::uint8_t pair = bytes[at + i / 2];
+      board.cells[i] = i % 2 ? pair >> 4 : pair & 15;
+      if (board.cells[i] > 7)
+        throw std::runtime_error("a saved game with a bad cell");
+    }
+    return save;
+  }
+
+  void write_save_file(const std::string &path, const SaveGame &save)
+  {
+    std::vector<std::uint8_t> bytes;
+    encode_save(save, bytes);
+    write_atomically(path, bytes);
+  }
+
+  SaveGame read_save_file(const std::string &path)
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      throw std::runtime_error("Cannot open the saved game " + path);
+    std::vector<std::uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    try
+    {
+      return decode_save(bytes);
+    }
+    catch (const std::runtime_error &e)
+    {
+      throw std::runtime_error(path + " is " + e.what());
+    }
+  }
+
+  AutosaveWriter::AutosaveWriter(const std::string &path) : path(path)
+  {
+    thread = std::thread(&AutosaveWriter::run, this);
+  }
+
+  AutosaveWriter::~AutosaveWriter()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+  }
+
+  void AutosaveWriter::submit()
+  {
+    saves.publish();
+    pending.store(true, std::memory_order_release);
+    // no lock, so a wakeup can slip past the writer just as it goes to sleep. it looks again
+    // every so often anyway, a save that's a moment late doesn't matter
+    wake.notify_one();
+  }
+
+  void AutosaveWriter::run()
+  {
+    std::vector<std::uint8_t> bytes;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+      wake.wait_for(lock, std::chrono::milliseconds(100), [this]
+                    { return stopping || pending.load(std::memory_order_acquire); });
+      bool last = stopping;
+      lock.unlock();
+
+      if (pending.exchange(false, std::memory_order_acq_rel) && saves.update())
+      {
+        try
+        {
+          encode_save(saves.read_buffer(), bytes);
+          write_atomically(path, bytes);
+          written.fetch_add(1, std::memory_order_relaxed);
+        }
+        catch (const std::runtime_error &e)
+        {
+          // only the first one is worth saying, the rest would be the same every few seconds
+          if (failed.fetch_add(1, std::memory_order_relaxed) == 0)
+            std::cerr << e.what() << ", the game isn't being autosaved" << std::endl;
+        }
+      }
+
+      lock.lock();
+      if (last)
+        return;
+    }
+  }
+
+}
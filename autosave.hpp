@@ -0,0 +1,80 @@
+#ifndef AUTOSAVE_HPP
+#define AUTOSAVE_HPP
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "grid.hpp"
+#include "triple_buffer.hpp"
+
+namespace tetris
+{
+
+    // A game in progress, everything it takes to carry on with it: the board (pile, falling piece,
+    // score and where the pieces are in their sequence), the seed it started from and the tick it
+    // was on, so gravity keeps the same beat after a resume
+    struct SaveGame
+    {
+        int width = 10;
+        int height = 20;
+        unsigned seed = 0;
+        long long tick = 0;
+        BoardState board;
+    };
+
+    // The file is little endian and versioned, 10x20 comes to about 150 bytes:
+    //
+    //   "TSAV"  u16 version  u16 width  u16 height  u32 seed  u64 tick
+    //   u32 score  u32 lines  u32 pieces  u32 rng  i16 b_x  i16 b_y  u8 block  u8 rotation
+    //   u16 piece (a bit a cell, row by row)  the pile two cells a byte  u32 FNV-1a of all of it
+    //
+    // out is reused, so saving over and over doesn't allocate
+    void encode_save(const SaveGame &save, std::vector<std::uint8_t> &out);
+
+    // throws std::runtime_error when it isn't a save this version understands (or it got cut short)
+    SaveGame decode_save(const std::vector<std::uint8_t> &bytes);
+
+    // Writes path.tmp, fsyncs it and renames it over path, so whoever reads path (or a crash halfway
+    // through) sees the old save or the new one and never half of one. throws std::runtime_error
+    void write_save_file(const std::string &path, const SaveGame &save);
+    SaveGame read_save_file(const std::string &path);
+
+    // Writes the autosaves on a thread of its own so the game never waits on the disk. The
+    // simulation fills in next() and hands it over with submit(), which is a triple buffer publish
+    // and a wakeup, it never takes a lock. If the disk is slower than the saves come in, the ones
+    // in between are skipped and the newest is what gets written
+    class AutosaveWriter
+    {
+    public:
+        explicit AutosaveWriter(const std::string &path);
+        ~AutosaveWriter(); // writes the last one submitted if it hasn't been yet
+
+        AutosaveWriter(const AutosaveWriter &) = delete;
+        AutosaveWriter &operator=(const AutosaveWriter &) = delete;
+
+        // game side, one thread only: fill this in and submit() it
+        SaveGame &next() { return saves.write_buffer(); }
+        void submit();
+
+        long long saves_written() const { return written.load(std::memory_order_relaxed); }
+        long long saves_failed() const { return failed.load(std::memory_order_relaxed); }
+
+    private:
+        void run();
+
+        std::string path;
+        TripleBuffer<SaveGame> saves;
+        std::atomic<bool> pending{false};
+        std::atomic<long long> written{0};
+        std::atomic<long long> failed{0};
+        bool stopping = false; // under mutex
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread thread;
+    };
+
+}
+#endif // AUTOSAVE_HPP
@@ -0,0 +1,167 @@
+#include "bot.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace tetris
+{
+
+  Bot::Bot(int height, int width) : scratch(height, width), copy(height, width) {}
+
+  void Bot::reset()
+  {
+    moves.clear();
+    next = 0;
+    planned_for = -1;
+  }
+
+  bool Bot::next_move(GameBoard &board, Input &move)
+  {
+    if (board.is_game_over())
+      return false;
+
+    // a new piece, either ours finished its drop or gravity locked it before we got there
+    if (board.pieces_placed() != planned_for)
+      plan(board);
+
+    if (next >= moves.size())
+      return false;
+    move = moves[next++];
+    return true;
+  }
+
+  bool Bot::best_placement(GameBoard &board, Placement &best)
+  {
+    legal_placements(board, scratch, start, placements);
+
+    double best_value = -std::numeric_limits<double>::infinity();
+    for (Placement placement : placements)
+    {
+      scratch.load_state(start);
+      move_to(scratch, placement);
+      scratch.handle_input(Input::Drop);
+
+      double value = evaluate(scratch);
+      if (value > best_value)
+      {
+        best_value = value;
+        best = placement;
+      }
+    }
+    return !placements.empty();
+  }
+
+  void Bot::plan(GameBoard &board)
+  {
+    planned_for = board.pieces_placed();
+    moves.clear();
+    next = 0;
+
+    Placement best;
+    if (!best_placement(board, best))
+      return;
+    scratch.load_state(start);
+    move_to(scratch, best, &moves);
+    moves.push_back(Input::Drop);
+  }
+
+  double Bot::evaluate(GameBoard &board) const
+  {
+    return placement_value(board, start.lines_cleared);
+  }
+
+  double placement_value(GameBoard &board, int lines_before)
+  {
+    if (board.is_game_over())
+      return -1e9;
+
+    BoardFeatures features = board_features(board);
+    int lines = board.lines_cleared_count() - lines_before;
+    return -0.510066 * features.aggregate_height + 0.760666 * lines - 0.35663 * features.holes -
+           0.184483 * features.bumpiness;
+  }
+
+  bool move_to(GameBoard &board, Placement placement, std::vector<Input> *moves)
+  {
+    // the same moves the real board will get, a move that doesn't fit rules the placement out
+    for (int turn = 0; turn < placement.turns; ++turn)
+    {
+      board.handle_input(Input::Rotate);
+      if (moves)
+        moves->push_back(Input::Rotate);
+      if (board.getRotation() != turn + 1)
+        return false;
+    }
+    while (board.b_x != placement.x)
+    {
+      int before = board.b_x;
+      Input step = board.b_x < placement.x ? Input::Right : Input::Left;
+      board.handle_input(step);
+      if (moves)
+        moves->push_back(step);
+      if (board.b_x == before)
+        return false;
+    }
+    return true;
+  }
+
+  void legal_placements(GameBoard &board, GameBoard &scratch, BoardState &start, std::vector<Placement> &out)
+  {
+    out.clear();
+    board.save_state(start);
+    // the save has the piece's number in it, not the set it's from or the gravity
+    if (&scratch.get_piece_set() != &board.get_piece_set())
+      scratch.set_piece_set(board.get_piece_set());
+    scratch.set_cascade(board.get_cascade());
+    if (board.is_game_over())
+      return;
+
+    for (int turns = 0; turns < 4; ++turns)
+    {
+      // the piece's cells can start up to box - 1 columns right of b_x, so b_x can go a bit past the left wall
+      for (int x = 1 - board.get_piece_set().box_size(); x < board.getWidth(); ++x)
+      {
+        scratch.load_state(start);
+        if (move_to(scratch, {turns, x}))
+          out.push_back({turns, x});
+      }
+    }
+  }
+
+  BoardFeatures board_features(GameBoard &board)
+  {
+    // goes along the rows, top down, the grid is stored that way. a column's height is set by the
+    // first block found in it, and every empty cell in a column that has a height is a hole
+    int width = board.getWidth();
+    int height = board.getHeight();
+    int heights[50] = {};
+    BoardFeatures features;
+    const Grid &grid = board.getGameState();
+    for (int y = 0; y < height; ++y)
+    {
+      const int *row = grid[y].data();
+      for (int x = 0; x < width; ++x)
+      {
+        if (row[x])
+        {
+          if (!heights[x])
+            heights[x] = height - y;
+        }
+        else if (heights[x])
+        {
+          ++features.holes;
+        }
+      }
+    }
+
+    for (int x = 0; x < width; ++x)
+    {
+      features.aggregate_height += heights[x];
+      features.max_height = std::max(features.max_height, heights[x]);
+      if (x > 0)
+        features.bumpiness += std::abs(heights[x] - heights[x - 1]);
+    }
+    return features;
+  }
+
+}
@@ -0,0 +1,87 @@
+#ifndef BOT_HPP
+#define BOT_HPP
+#include <vector>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // where the falling piece goes: turned this many times (0 to 3), then moved until b_x is x, then dropped
+    struct Placement
+    {
+        int turns;
+        int x;
+    };
+
+    // the turns and the sideways moves of a placement, played on the board. false as soon as one of
+    // them doesn't fit, the board is left wherever it got to then. moves (if not null) gets what was played
+    bool move_to(GameBoard &board, Placement placement, std::vector<Input> *moves = nullptr);
+
+    // every placement the falling piece can get to, tried out on scratch (the same size as the board).
+    // start is left holding the board as it is, the memory of all three gets reused call after call
+    void legal_placements(GameBoard &board, GameBoard &scratch, BoardState &start, std::vector<Placement> &out);
+
+    // what the pile looks like, column heights are counted from the floor
+    struct BoardFeatures
+    {
+        int aggregate_height = 0; // all the column heights added up
+        int max_height = 0;
+        int holes = 0;            // empty cells with something above them
+        int bumpiness = 0;        // how much neighbouring columns differ in height, added up
+    };
+    BoardFeatures board_features(GameBoard &board);
+
+    // how good the pile left behind is, what the bot goes by: lines cleared since the board had
+    // lines_before of them are good, height, holes and bumpiness are bad. a lost game is -1e9
+    double placement_value(GameBoard &board, int lines_before);
+
+    // A player that looks one piece ahead. When a piece spawns it tries every rotation at every column
+    // on a scratch board, scores the pile each one leaves behind (lines cleared are good, height, holes
+    // and bumpiness are bad, with the weights from Yiyuan Lee's "El-Tetris" write up) and then plays
+    // the moves to get there one at a time, so it can be fed to a board at whatever pace the caller
+    // likes. The same board and seed always get the same moves
+    class Bot
+    {
+    public:
+        Bot(int height, int width); // the size of the boards it will play
+
+        // the next move for the board's falling piece, false if there's nothing left to do
+        bool next_move(GameBoard &board, Input &move);
+
+        // the same for a board of another kind (a FixedGameBoard), it's copied into a GameBoard of
+        // the bot's own once a piece to make the plan on
+        template <typename Board>
+        bool next_move(Board &board, Input &move)
+        {
+            if (board.is_game_over())
+                return false;
+            if (board.pieces_placed() != planned_for)
+            {
+                board.save_state(start);
+                copy.load_state(start);
+            }
+            return next_move(copy, move);
+        }
+
+        // forgets the plan, for when the board is reset under it
+        void reset();
+
+        // the placement it would play for the board's falling piece, false if there's none. for
+        // callers that play whole placements themselves, it doesn't touch the plan
+        bool best_placement(GameBoard &board, Placement &best);
+
+    private:
+        void plan(GameBoard &board);
+        double evaluate(GameBoard &board) const;
+
+        GameBoard scratch;   // where the placements are tried, it never has a listener or a bus
+        GameBoard copy;      // the board the plan was made on, when it isn't a GameBoard
+        BoardState start;    // the board as it was when the placements were last tried
+        std::vector<Placement> placements;
+        std::vector<Input> moves;
+        std::size_t next = 0;
+        int planned_for = -1; // pieces_placed() when the plan was made
+    };
+
+}
+#endif // BOT_HPP
@@ -0,0 +1,210 @@
+#include "cascade.hpp"
+#include <algorithm>
+#include <climits>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // the bits of word w that are columns x0 to x1
+    std::uint64_t span_mask(int w, int x0, int x1)
+    {
+      int lo = std::max(x0, w * 64) - w * 64;
+      int hi = std::min(x1, w * 64 + 63) - w * 64;
+      return (~std::uint64_t(0) >> (63 - hi)) & (~std::uint64_t(0) << lo);
+    }
+
+    bool any_in(const std::uint64_t *row, int x0, int x1)
+    {
+      for (int w = x0 >> 6; w <= x1 >> 6; ++w)
+      {
+        if (row[w] & span_mask(w, x0, x1))
+          return true;
+      }
+      return false;
+    }
+  }
+
+  int CascadePlanner::find(int run)
+  {
+    while (parent[run] != run)
+    {
+      parent[run] = parent[parent[run]];
+      run = parent[run];
+    }
+    return run;
+  }
+
+  void CascadePlanner::runs_of(const std::uint64_t *row, std::vector<Run> &out, int y)
+  {
+    // a run starts on a set bit with a clear one to its left and ends on one with a clear one to its
+    // right, the neighbouring words' edge bits count too so a run can go over a word boundary. the
+    // runs don't nest, so the k-th end is always the k-th start's
+    out.clear();
+    std::size_t closed = 0;
+    for (int w = 0; w < words; ++w)
+    {
+      std::uint64_t bits = row[w];
+      if (!bits)
+        continue;
+      std::uint64_t left = w > 0 ? row[w - 1] >> 63 : 0;
+      std::uint64_t right = w + 1 < words ? row[w + 1] & 1 : 0;
+      std::uint64_t starts = bits & ~(bits << 1 | left);
+      std::uint64_t ends = bits & ~(bits >> 1 | right << 63);
+      for (; starts; starts &= starts - 1)
+        out.push_back({y, w * 64 + __builtin_ctzll(starts), -1});
+      for (; ends; ends &= ends - 1)
+        out[closed++].x1 = w * 64 + __builtin_ctzll(ends);
+    }
+  }
+
+  int CascadePlanner::ground_below(int x)
+  {
+    if (ground[x] < 0)
+    {
+      int y = last + 1;
+      while (y < height && !(board[y][x >> 6] >> (x & 63) & 1))
+        ++y;
+      ground[x] = y;
+    }
+    return ground[x];
+  }
+
+  bool CascadePlanner::plan(const std::uint64_t *const *rows, int height, int width, int first, int last,
+                            std::vector<CascadeMove> &moves)
+  {
+    moves.clear();
+    first = std::max(first, 0);
+    last = std::min(last, height - 1);
+    if (first > last)
+      return false;
+
+    board = rows;
+    this->height = height;
+    this->last = last;
+    words = (width + 63) / 64;
+    runs.assign(1, {height, 0, width - 1});
+    parent.assign(1, 0);
+    below_row.assign(width, -1);
+    below_run.assign(width, 0);
+    ground.assign(width, -1);
+    gaps.clear();
+    below_runs.clear();
+    int below_first = 0; // the run number of below_runs[0]
+
+    for (int y = last; y >= first; --y)
+    {
+      runs_of(rows[y], row_runs, y);
+      int row_first = static_cast<int>(runs.size());
+      std::size_t overlap = 0;
+      for (const Run &run : row_runs)
+      {
+        int id = static_cast<int>(runs.size());
+        runs.push_back(run);
+        parent.push_back(id);
+
+        // joins every run it touches in the row below, the bottom row of the window joins the
+        // ground when it sits on it
+        while (overlap < below_runs.size() && below_runs[overlap].x1 < run.x0)
+          ++overlap;
+        for (std::size_t o = overlap; o < below_runs.size() && below_runs[o].x0 <= run.x1; ++o)
+        {
+          int a = find(id);
+          int b = find(below_first + static_cast<int>(o));
+          parent[std::max(a, b)] = std::min(a, b);
+        }
+        if (y == last && (y + 1 == height || any_in(rows[y + 1], run.x0, run.x1)))
+          parent[find(id)] = 0;
+
+        // the cells with nothing right under them, each stands over the nearest cell further down
+        // (or the floor) with a gap between. cells side by side over the same run share a gap
+        if (y + 1 < height)
+        {
+          std::size_t run_gaps = gaps.size();
+          for (int w = run.x0 >> 6; w <= run.x1 >> 6; ++w)
+          {
+            for (std::uint64_t open = span_mask(w, run.x0, run.x1) & ~rows[y + 1][w]; open; open &= open - 1)
+            {
+              int x = w * 64 + __builtin_ctzll(open);
+              Gap gap = below_row[x] >= 0 ? Gap{below_run[x], id, below_row[x] - y - 1}
+                                          : Gap{0, id, ground_below(x) - y - 1};
+              if (gaps.size() > run_gaps && gaps.back().lower == gap.lower)
+                gaps.back().rows = std::min(gaps.back().rows, gap.rows);
+              else
+                gaps.push_back(gap);
+            }
+          }
+        }
+      }
+
+      for (std::size_t i = 0; i < row_runs.size(); ++i)
+      {
+        std::fill(below_row.begin() + row_runs[i].x0, below_row.begin() + row_runs[i].x1 + 1, y);
+        std::fill(below_run.begin() + row_runs[i].x0, below_run.begin() + row_runs[i].x1 + 1, row_first + static_cast<int>(i));
+      }
+      below_runs.swap(row_runs);
+      below_first = row_first;
+    }
+
+    // the gaps by the groups they're between, counted into place by the lower one, and the ones
+    // inside a group (a U's middle) dropped
+    int count = static_cast<int>(runs.size());
+    std::size_t kept = 0;
+    first_gap.assign(count + 1, 0);
+    for (const Gap &gap : gaps)
+    {
+      Gap group = {find(gap.lower), find(gap.upper), gap.rows};
+      if (group.lower == group.upper)
+        continue;
+      gaps[kept++] = group;
+      ++first_gap[group.lower + 1];
+    }
+    for (int g = 0; g < count; ++g)
+      first_gap[g + 1] += first_gap[g];
+    by_lower.resize(kept);
+    for (std::size_t i = 0; i < kept; ++i)
+      by_lower[first_gap[gaps[i].lower]++] = gaps[i];
+    for (int g = count; g > 0; --g)
+      first_gap[g] = first_gap[g - 1];
+    first_gap[0] = 0;
+
+    // up from the ground, a group falls as far as the group it lands on plus the gap. a group can
+    // be in a bucket more than once, only the bucket it ended up in counts
+    drop.assign(count, INT_MAX);
+    if (static_cast<int>(falls_by.size()) < height + 1)
+      falls_by.resize(height + 1);
+    for (std::vector<int> &bucket : falls_by)
+      bucket.clear();
+    drop[find(0)] = 0;
+    falls_by[0].push_back(find(0));
+    for (int falls = 0; falls <= height; ++falls)
+    {
+      std::vector<int> &bucket = falls_by[falls];
+      for (std::size_t b = 0; b < bucket.size(); ++b)
+      {
+        int group = bucket[b];
+        if (drop[group] != falls)
+          continue;
+        for (int i = first_gap[group]; i < first_gap[group + 1]; ++i)
+        {
+          int further = falls + by_lower[i].rows;
+          if (further < drop[by_lower[i].upper])
+          {
+            drop[by_lower[i].upper] = further;
+            falls_by[further].push_back(by_lower[i].upper);
+          }
+        }
+      }
+    }
+
+    for (int i = 1; i < count; ++i)
+    {
+      int falls = drop[find(i)];
+      if (falls > 0 && falls != INT_MAX)
+        moves.push_back({runs[i].y, runs[i].x0, runs[i].x1 - runs[i].x0 + 1, falls});
+    }
+    return !moves.empty();
+  }
+
+}
@@ -0,0 +1,81 @@
+#ifndef CASCADE_HPP
+#define CASCADE_HPP
+#include <cstdint>
+#include <vector>
+
+namespace tetris
+{
+
+    // cells of one row that fall together, x to x + length - 1 of row y go down drop rows
+    struct CascadeMove
+    {
+        int y = 0;
+        int x = 0;
+        int length = 0;
+        int drop = 0;
+    };
+
+    // The cascade gravity mode (GameBoard::set_cascade, HugeGameBoard::set_cascade): after a clear,
+    // every group of blocks that touch (up, down, left, right) falls on its own until it lands, and
+    // what it lands on can fill a line for another clear. This works out how far every group falls,
+    // the boards move the cells themselves.
+    //  - a row is taken as bits, 64 columns a word, and cut into runs of set bits with shifts, so
+    //    the groups are put together a run at a time instead of a cell at a time
+    //  - the runs are joined into groups with a union-find as the rows go by bottom up, a run joins
+    //    the runs it overlaps in the row below, so it's one pass over the rows
+    //  - the groups all fall at the same speed, so they only ever land on the floor or on a group
+    //    that already landed. how far a group falls is the least of (how far the group under it
+    //    falls + the gap between them) over the columns, which is a shortest path up from the
+    //    floor (Dijkstra, the gaps are the lengths, and with a bucket per row instead of a heap
+    //    since no group falls further than the board is tall)
+    // The rows can be looked at a window at a time, the rows under it are taken as ground that
+    // never moves (a clear can cut loose what hangs under it, so the boards always look at the
+    // whole pile)
+    class CascadePlanner
+    {
+    public:
+        // rows[y] is row y as bits (bit x of word x / 64), words of them, and the bits past the
+        // width are 0. rows first to last can fall, the rows above first have to be empty, and the
+        // rows below last stay where they are. moves gets every run that falls, false if none do
+        bool plan(const std::uint64_t *const *rows, int height, int width, int first, int last,
+                  std::vector<CascadeMove> &moves);
+
+    private:
+        struct Run
+        {
+            int y;
+            int x0; // the first and last column, inclusive
+            int x1;
+        };
+        struct Gap
+        {
+            int lower; // the run the cells stand over, 0 is the ground
+            int upper;
+            int rows;  // the empty rows between them
+        };
+
+        int find(int run);
+        void runs_of(const std::uint64_t *row, std::vector<Run> &out, int y);
+        int ground_below(int x);
+
+        const std::uint64_t *const *board = nullptr;
+        int height = 0;
+        int words = 0;
+        int last = 0;
+
+        std::vector<Run> runs;          // every run, runs[0] stands for the ground
+        std::vector<int> parent;        // the union-find over the runs
+        std::vector<Run> row_runs;      // the runs of the row being looked at and the row below it
+        std::vector<Run> below_runs;
+        std::vector<int> below_row;     // the nearest cell under the current row in each column, and its run
+        std::vector<int> below_run;
+        std::vector<int> ground;        // where the ground starts under last in each column, -1 until it's looked for
+        std::vector<Gap> gaps;
+        std::vector<Gap> by_lower;      // the gaps between groups, sorted by the lower one
+        std::vector<int> first_gap;     // where group g's start in by_lower
+        std::vector<int> drop;          // how far each group falls, by its root run
+        std::vector<std::vector<int>> falls_by; // the groups by how far they fall so far, the Dijkstra queue
+    };
+
+}
+#endif // CASCADE_HPP
@@ -0,0 +1,351 @@
+#include "dataset.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tetris
+{
+
+  static_assert(sizeof(DatasetColumn) == 32, "DatasetColumn is written to disk as it is");
+  static_assert(sizeof(DatasetChunk) == 16 + 8 * DatasetHeader::max_columns, "DatasetChunk is written to disk as it is");
+  static_assert(dataset_column_count <= DatasetHeader::max_columns, "the header has no room for the columns");
+
+  namespace
+  {
+    // columns start on a cache line, that's plenty for any type a loader wants to view them as
+    std::uint64_t align(std::uint64_t offset)
+    {
+      return (offset + 63) & ~std::uint64_t(63);
+    }
+
+    void write_at(int fd, const void *data, std::size_t size, std::uint64_t offset)
+    {
+      const char *bytes = static_cast<const char *>(data);
+      while (size > 0)
+      {
+        ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (written < 0)
+          throw std::runtime_error(std::string("Cannot write the dataset: ") + std::strerror(errno));
+        bytes += written;
+        size -= written;
+        offset += written;
+      }
+    }
+
+    // the cells one bit each, the same order they're in the grid
+    void pack_board(const Grid &grid, int width, std::uint8_t *out)
+    {
+      unsigned bits = 0;
+      int used = 0;
+      for (const std::vector<int> &row : grid)
+      {
+        const int *cells = row.data();
+        for (int x = 0; x < width; ++x)
+        {
+          bits |= static_cast<unsigned>(cells[x] != 0) << used;
+          if (++used == 8)
+          {
+            *out++ = static_cast<std::uint8_t>(bits);
+            bits = 0;
+            used = 0;
+          }
+        }
+      }
+      if (used)
+        *out = static_cast<std::uint8_t>(bits);
+    }
+
+    void set_column(DatasetColumn &column, const char *name, ColumnType type, std::uint32_t row_bytes)
+    {
+      std::memset(&column, 0, sizeof(column));
+      std::strncpy(column.name, name, sizeof(column.name) - 1);
+      column.type = type;
+      column.row_bytes = row_bytes;
+    }
+  }
+
+  DatasetWriter::DatasetWriter(const std::string &prefix, int height, int width, int chunk_rows, int chunks_per_file)
+      : prefix(prefix), height(height), width(width), board_bytes((height * width + 7) / 8),
+        chunk_rows(chunk_rows), chunks_per_file(chunks_per_file), filling(&chunks[0])
+  {
+    if (height < 1 || width < 1 || height > 0xffff || width > 0xffff || chunk_rows < 1 || chunks_per_file < 1)
+      throw std::runtime_error("Bad dataset sizes");
+
+    // every buffer is as big as it will get now, adding never allocates
+    for (Chunk &chunk : chunks)
+    {
+      chunk.board.resize(this->chunk_rows * board_bytes);
+      chunk.piece.resize(chunk_rows);
+      chunk.turns.resize(chunk_rows);
+      chunk.x.resize(chunk_rows);
+      chunk.reward.resize(chunk_rows);
+      chunk.done.resize((chunk_rows + 7) / 8);
+    }
+    writer = std::thread(&DatasetWriter::run, this);
+  }
+
+  DatasetWriter::~DatasetWriter()
+  {
+    try
+    {
+      close();
+    }
+    catch (...)
+    {
+    }
+  }
+
+  void DatasetWriter::add(GameBoard &board, Placement placement)
+  {
+    if (filling->rows == chunk_rows)
+      hand_off();
+
+    Chunk &chunk = *filling;
+    std::size_t row = chunk.rows;
+    pack_board(board.getGameState(), width, &chunk.board[row * board_bytes]);
+    chunk.piece[row] = static_cast<std::uint8_t>(board.getBlock());
+    chunk.turns[row] = static_cast<std::uint8_t>(placement.turns);
+    chunk.x[row] = static_cast<std::int8_t>(placement.x);
+    chunk.reward[row] = 0;
+    if (row % 8 == 0)
+      chunk.done[row / 8] = 0;
+    ++chunk.rows;
+    ++total_rows;
+  }
+
+  void DatasetWriter::finish(int reward, bool done)
+  {
+    Chunk &chunk = *filling;
+    if (chunk.rows == 0)
+      return;
+    std::size_t row = chunk.rows - 1;
+    chunk.reward[row] = static_cast<std::uint16_t>(std::min(std::max(reward, 0), 0xffff));
+    if (done)
+      chunk.done[row / 8] |= static_cast<std::uint8_t>(1u << (row % 8));
+  }
+
+  void DatasetWriter::close()
+  {
+    if (closed)
+      return;
+    closed = true;
+
+    std::exception_ptr error;
+    try
+    {
+      if (filling->rows)
+        hand_off();
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    changed.notify_all();
+    writer.join();
+
+    if (!error)
+      error = failure;
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  void DatasetWriter::hand_off()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pending)
+    {
+      // the disk is behind, there's nowhere to put the next sample until it catches up
+      auto start = std::chrono::steady_clock::now();
+      changed.wait(lock, [this]
+                   { return pending == nullptr; });
+      stalled += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (failure)
+      std::rethrow_exception(failure);
+
+    pending = filling;
+    filling = filling == &chunks[0] ? &chunks[1] : &chunks[0];
+    filling->rows = 0; // the writer is done with it
+    lock.unlock();
+    changed.notify_all();
+  }
+
+  void DatasetWriter::run()
+  {
+    for (;;)
+    {
+      Chunk *chunk;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]
+                     { return pending != nullptr || stopping; });
+        if (!pending)
+          break;
+        chunk = pending;
+      }
+
+      // after a failure the chunks are only taken off the game's hands, add() throws it
+      std::exception_ptr error;
+      try
+      {
+        if (!failure)
+          write_chunk(*chunk);
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error)
+          failure = error;
+        pending = nullptr;
+      }
+      changed.notify_all();
+    }
+
+    try
+    {
+      if (!failure)
+        finish_file();
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      failure = std::current_exception();
+    }
+  }
+
+  void DatasetWriter::write_chunk(const Chunk &chunk)
+  {
+    if (fd < 0)
+    {
+      char name[32];
+      std::snprintf(name, sizeof(name), "-%05d.tds", file_number);
+      std::string path = prefix + name;
+      fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd < 0)
+        throw std::runtime_error("Cannot create " + path);
+
+      // the header goes in last, until then a reader sees an unfinished file
+      DatasetHeader header = {};
+      write_at(fd, &header, sizeof(header), 0);
+      file_offset = align(sizeof(DatasetHeader));
+      file_rows = 0;
+      table.clear();
+    }
+
+    std::size_t rows = chunk.rows;
+    const void *data[dataset_column_count] = {chunk.board.data(), chunk.piece.data(), chunk.turns.data(),
+                                              chunk.x.data(), chunk.reward.data(), chunk.done.data()};
+    std::size_t sizes[dataset_column_count] = {rows * board_bytes, rows, rows, rows, rows * sizeof(std::uint16_t),
+                                               (rows + 7) / 8};
+
+    DatasetChunk entry = {};
+    entry.first_row = file_rows;
+    entry.rows = static_cast<std::uint32_t>(rows);
+    for (int column = 0; column < dataset_column_count; ++column)
+    {
+      file_offset = align(file_offset);
+      entry.column_offsets[column] = file_offset;
+      write_at(fd, data[column], sizes[column], file_offset);
+      file_offset += sizes[column];
+    }
+    table.push_back(entry);
+    file_rows += rows;
+
+    if (static_cast<int>(table.size()) == chunks_per_file)
+      finish_file();
+  }
+
+  void DatasetWriter::finish_file()
+  {
+    if (fd < 0)
+      return;
+
+    DatasetHeader header = {};
+    header.magic = DatasetHeader::magic_value;
+    header.version = DatasetHeader::current_version;
+    header.width = static_cast<std::uint16_t>(width);
+    header.height = static_cast<std::uint16_t>(height);
+    header.column_count = dataset_column_count;
+    header.chunk_rows = static_cast<std::uint32_t>(chunk_rows);
+    header.chunk_count = static_cast<std::uint32_t>(table.size());
+    header.rows = file_rows;
+    header.table_offset = align(file_offset);
+    header.complete = 1;
+    set_column(header.columns[dataset_board], "board", column_bytes, static_cast<std::uint32_t>(board_bytes));
+    set_column(header.columns[dataset_piece], "piece", column_u8, 1);
+    set_column(header.columns[dataset_turns], "turns", column_u8, 1);
+    set_column(header.columns[dataset_x], "x", column_i8, 1);
+    set_column(header.columns[dataset_reward], "reward", column_u16, 2);
+    set_column(header.columns[dataset_done], "done", column_bits, 0);
+
+    std::size_t table_bytes = table.size() * sizeof(DatasetChunk);
+    if (table_bytes)
+      write_at(fd, table.data(), table_bytes, header.table_offset);
+    write_at(fd, &header, sizeof(header), 0);
+    ::close(fd);
+    fd = -1;
+    total_bytes += header.table_offset + table_bytes;
+    ++file_number;
+  }
+
+  DatasetReader::DatasetReader(const std::string &path)
+  {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      throw std::runtime_error("Cannot open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(DatasetHeader))
+    {
+      ::close(fd);
+      throw std::runtime_error(path + " is too short to be a dataset");
+    }
+    size = info.st_size;
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file
+    if (memory == MAP_FAILED)
+      throw std::runtime_error("Cannot map " + path);
+    base = static_cast<const std::uint8_t *>(memory);
+    head = reinterpret_cast<const DatasetHeader *>(base);
+
+    bool fits = head->magic == DatasetHeader::magic_value && head->version == DatasetHeader::current_version &&
+                head->complete && head->column_count == dataset_column_count &&
+                head->table_offset + std::uint64_t(head->chunk_count) * sizeof(DatasetChunk) <= size;
+    if (fits)
+    {
+      table = reinterpret_cast<const DatasetChunk *>(base + head->table_offset);
+      board_bytes = head->columns[dataset_board].row_bytes;
+      for (std::uint32_t i = 0; i < head->chunk_count && fits; ++i)
+      {
+        // only the last column needs to be checked, they're written in order
+        std::uint64_t done_end = table[i].column_offsets[dataset_done] + (table[i].rows + 7) / 8;
+        fits = table[i].rows <= head->chunk_rows && done_end <= size;
+      }
+    }
+    if (!fits)
+    {
+      munmap(const_cast<std::uint8_t *>(base), size);
+      throw std::runtime_error(path + " is not a finished dataset this version understands");
+    }
+  }
+
+  DatasetReader::~DatasetReader()
+  {
+    munmap(const_cast<std::uint8_t *>(base), size);
+  }
+
+}
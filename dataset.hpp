@@ -0,0 +1,206 @@
+#ifndef DATASET_HPP
+#define DATASET_HPP
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bot.hpp"
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // Training data from simulated games, one row per placement: the board before it, the piece,
+    // where it went, the points it scored and whether the game ended with it.
+    //
+    // A file (.tds) is a header, then chunks, then a table of the chunks. Inside a chunk every column
+    // is one array, 64 byte aligned, so a loader maps the file, looks the chunk up in the table and
+    // has the column in hand (as a numpy array, say) without parsing anything. The columns are
+    //
+    //   board   (width * height + 7) / 8 bytes per row, the cells row by row from the top, one bit
+    //           each (the lowest bit first), 1 where the pile has a block. 25 bytes on 10x20
+    //   piece   uint8, the falling piece's id (1-7)
+    //   turns   uint8, how many times it was turned (0-3)
+    //   x       int8, the b_x it was moved to (it can be a little below 0)
+    //   reward  uint16, the points the placement scored
+    //   done    one bit per row (the lowest bit first), 1 if the game was over after it
+    //
+    // which is a bit over 30 bytes a sample on 10x20. All numbers are little endian, like the machine
+    // that wrote them
+    enum ColumnType : std::uint32_t
+    {
+        column_bytes = 1, // row_bytes opaque bytes per row
+        column_u8 = 2,
+        column_i8 = 3,
+        column_u16 = 4,
+        column_bits = 5   // one bit per row, packed 8 to a byte
+    };
+
+    struct DatasetColumn
+    {
+        char name[16];          // zero padded
+        std::uint32_t type;     // a ColumnType
+        std::uint32_t row_bytes; // 0 for column_bits
+        std::uint64_t unused;
+    };
+
+    struct DatasetHeader
+    {
+        static constexpr std::uint32_t magic_value = 0x53445354; // "TSDS"
+        static constexpr std::uint32_t current_version = 1;
+        static constexpr int max_columns = 8;
+
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint16_t width;
+        std::uint16_t height;
+        std::uint32_t column_count;
+        std::uint32_t chunk_rows;   // the most rows a chunk has, only the last one has fewer
+        std::uint32_t chunk_count;
+        std::uint64_t rows;         // in the whole file
+        std::uint64_t table_offset; // where the DatasetChunk table starts, chunk_count of them
+        std::uint32_t complete;     // 0 until the file is finished, then the counts above are right
+        std::uint32_t unused;
+        DatasetColumn columns[max_columns];
+    };
+
+    struct DatasetChunk
+    {
+        std::uint64_t first_row; // the file's row number of its first row
+        std::uint32_t rows;
+        std::uint32_t unused;
+        std::uint64_t column_offsets[DatasetHeader::max_columns]; // from the start of the file
+    };
+
+    // the columns in the order they are in the file
+    enum DatasetColumnIndex
+    {
+        dataset_board = 0,
+        dataset_piece,
+        dataset_turns,
+        dataset_x,
+        dataset_reward,
+        dataset_done,
+        dataset_column_count
+    };
+
+    // Writes samples into prefix-00000.tds, prefix-00001.tds, ... starting a new file every
+    // chunks_per_file chunks. Samples go into one of two chunk buffers while a thread of its own
+    // writes the other one out, so the game only ever waits for the disk when the disk is slower
+    // than the game (stalled_ns() says how long that was). Throws std::runtime_error when it can't
+    // write, from add() or close() since the writing happens on the other thread
+    class DatasetWriter
+    {
+    public:
+        DatasetWriter(const std::string &prefix, int height, int width, int chunk_rows = 1 << 16,
+                      int chunks_per_file = 256);
+        ~DatasetWriter(); // closes, and says nothing if that goes wrong
+
+        DatasetWriter(const DatasetWriter &) = delete;
+        DatasetWriter &operator=(const DatasetWriter &) = delete;
+
+        // a sample of the board as it is now, before placement is played on it. finish() fills in
+        // how it went once it has been played
+        void add(GameBoard &board, Placement placement);
+        void finish(int reward, bool done);
+
+        // writes what's left and finishes the last file, nothing can be added after it
+        void close();
+
+        std::uint64_t rows() const { return total_rows; }
+        std::uint64_t bytes() const { return total_bytes; } // on disk so far, only right after close()
+        std::uint64_t stalled_ns() const { return stalled; }
+        int files() const { return file_number; }
+
+    private:
+        struct Chunk
+        {
+            std::vector<std::uint8_t> board;
+            std::vector<std::uint8_t> piece;
+            std::vector<std::uint8_t> turns;
+            std::vector<std::int8_t> x;
+            std::vector<std::uint16_t> reward;
+            std::vector<std::uint8_t> done;
+            std::size_t rows = 0;
+        };
+
+        void hand_off(); // gives the full chunk to the writer thread and takes the other one
+        void run();
+        void write_chunk(const Chunk &chunk);
+        void finish_file();
+
+        std::string prefix;
+        int height;
+        int width;
+        std::size_t board_bytes;
+        std::size_t chunk_rows;
+        int chunks_per_file;
+
+        Chunk chunks[2];
+        Chunk *filling;
+        std::uint64_t total_rows = 0;
+        std::uint64_t stalled = 0;
+        bool closed = false;
+
+        // shared with the writer thread
+        std::mutex mutex;
+        std::condition_variable changed;
+        Chunk *pending = nullptr; // the chunk being written, the other one is ours
+        bool stopping = false;
+        std::exception_ptr failure;
+        std::thread writer;
+
+        // the writer thread's own
+        int fd = -1;
+        int file_number = 0;
+        std::uint64_t file_offset = 0;
+        std::uint64_t file_rows = 0;
+        std::vector<DatasetChunk> table;
+        std::uint64_t total_bytes = 0;
+    };
+
+    // A finished .tds file mapped read only, the columns are pointers straight into the mapping.
+    // Throws std::runtime_error if the file isn't one (or wasn't finished)
+    class DatasetReader
+    {
+    public:
+        explicit DatasetReader(const std::string &path);
+        ~DatasetReader();
+
+        DatasetReader(const DatasetReader &) = delete;
+        DatasetReader &operator=(const DatasetReader &) = delete;
+
+        const DatasetHeader &header() const { return *head; }
+        std::uint32_t chunk_count() const { return head->chunk_count; }
+        const DatasetChunk &chunk(std::uint32_t number) const { return table[number]; }
+
+        // the start of a column's array in a chunk
+        const std::uint8_t *column(std::uint32_t chunk_number, int column_index) const
+        {
+            return base + table[chunk_number].column_offsets[column_index];
+        }
+
+        // one cell of the board column, row is counted from the start of the chunk
+        bool cell(const std::uint8_t *boards, std::size_t row, int y, int x) const
+        {
+            std::size_t bit = static_cast<std::size_t>(y) * head->width + x;
+            return (boards[row * board_bytes + bit / 8] >> (bit % 8)) & 1;
+        }
+
+        // one bit of a column_bits column
+        static bool bit(const std::uint8_t *bits, std::size_t row) { return (bits[row / 8] >> (row % 8)) & 1; }
+
+    private:
+        const std::uint8_t *base = nullptr;
+        std::size_t size = 0;
+        const DatasetHeader *head = nullptr;
+        const DatasetChunk *table = nullptr;
+        std::size_t board_bytes = 0;
+    };
+
+}
+#endif // DATASET_HPP
@@ -0,0 +1,137 @@
+#ifndef EVENT_BUS_HPP
+#define EVENT_BUS_HPP
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "pieces.hpp"
+
+namespace tetris
+{
+
+    // what happened on the board, see Event for which fields go with which type
+    enum class EventType : std::uint8_t
+    {
+        PieceSpawned, // block, x, y of the new piece
+        PieceMoved,   // x, y after the move (sideways or falling)
+        PieceRotated, // x, y of the piece that was rotated
+        PieceLocked,  // block, x, y where it landed
+        LinesCleared, // count, and the first (up to max_piece_size) row indices in rows
+        GameOver      // score and lines at the end
+    };
+
+    // A small plain struct so publishing is just a copy into the ring. It's 28 bytes (a slot is 40 with
+    // its stamp), rows has room for as many as a piece set's 5 tall piece can clear at once (a
+    // cascade can clear more, count has all of them)
+    struct Event
+    {
+        EventType type = EventType::PieceSpawned;
+        std::uint8_t block = 0;
+        std::int16_t x = 0;
+        std::int16_t y = 0;
+        std::int16_t count = 0;
+        std::array<std::int16_t, max_piece_size> rows{};
+        std::int32_t score = 0;
+        std::int32_t lines = 0;
+    };
+
+    // A bounded ring that one producer (the board) publishes events into and any number of readers
+    // consume from on their own, each with its own cursor, so audio, stats, replays and networking
+    // don't take events away from each other. The producer never waits: if a reader falls more
+    // than a ring behind, the old events are overwritten and that reader is told how many it lost.
+    // Each slot has a sequence stamp (odd while it's being written) so a reader can tell if the
+    // slot it just copied was overwritten under it, the same trick a seqlock uses
+    class EventBus
+    {
+    public:
+        static constexpr std::uint64_t capacity = 1024;
+
+        // producer side, a couple of stores and no waiting
+        void publish(const Event &event)
+        {
+            std::uint64_t n = head.load(std::memory_order_relaxed);
+            Slot &slot = slots[n & (capacity - 1)];
+            slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.event = event;
+            slot.seq.store(2 * n + 2, std::memory_order_release);
+            head.store(n + 1, std::memory_order_release);
+        }
+
+        // how many events have been published so far
+        std::uint64_t published() const
+        {
+            return head.load(std::memory_order_acquire);
+        }
+
+        // One consumer's view of the bus, only ever used from one thread
+        class Reader
+        {
+        public:
+            // takes the next event, returns false if the reader has caught up
+            bool poll(Event &event)
+            {
+                for (;;)
+                {
+                    std::uint64_t newest = bus->head.load(std::memory_order_acquire);
+                    if (cursor == newest)
+                        return false;
+
+                    // fell too far behind, skip to the oldest event that is still in the ring
+                    if (newest - cursor > capacity)
+                    {
+                        lost_events += newest - capacity - cursor;
+                        cursor = newest - capacity;
+                    }
+
+                    const Slot &slot = bus->slots[cursor & (capacity - 1)];
+                    std::uint64_t expected = 2 * cursor + 2;
+                    if (slot.seq.load(std::memory_order_acquire) == expected)
+                    {
+                        event = slot.event;
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if (slot.seq.load(std::memory_order_relaxed) == expected)
+                        {
+                            ++cursor;
+                            return true;
+                        }
+                    }
+                    // it got overwritten while we looked, go around and skip ahead
+                    ++lost_events;
+                    ++cursor;
+                }
+            }
+
+            // how many events this reader missed because it was too slow
+            std::uint64_t lost() const
+            {
+                return lost_events;
+            }
+
+        private:
+            friend class EventBus;
+            Reader(const EventBus *bus, std::uint64_t cursor) : bus(bus), cursor(cursor) {}
+
+            const EventBus *bus;
+            std::uint64_t cursor;
+            std::uint64_t lost_events = 0;
+        };
+
+        // a new reader starts with the next event published, not the old ones
+        Reader subscribe() const
+        {
+            return Reader(this, published());
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<std::uint64_t> seq{0};
+            Event event;
+        };
+
+        std::array<Slot, capacity> slots;
+        alignas(64) std::atomic<std::uint64_t> head{0}; // sequence number of the next event
+    };
+
+}
+#endif // EVENT_BUS_HPP
@@ -0,0 +1,431 @@
+#ifndef FIXED_BOARD_HPP
+#define FIXED_BOARD_HPP
+#include <array>
+#include <cstdint>
+#include <random>
+#include "grid.hpp"
+#include "event_bus.hpp"
+
+namespace tetris
+{
+
+    // every row of the board is kept as a bitmask as well as the colors, bit x is column x
+    // so a line is full when its mask equals full_row, which is a single compare instead of a loop
+    typedef std::uint64_t RowMask;
+
+    // the shapes from grid.hpp written as one 4 bit mask per row (bit x is column x),
+    // index 0 is unused so the block number can index it directly just like the shapes map
+    constexpr std::array<std::array<std::uint8_t, 4>, 8> shape_masks = {{
+        {{0, 0, 0, 0}},
+        {{0b0000, 0b0110, 0b0110, 0b0000}}, // O
+        {{0b0000, 0b1111, 0b0000, 0b0000}}, // I
+        {{0b0000, 0b0110, 0b0011, 0b0000}}, // S
+        {{0b0000, 0b0011, 0b0110, 0b0000}}, // Z
+        {{0b0000, 0b0111, 0b0010, 0b0000}}, // T
+        {{0b0000, 0b0111, 0b0001, 0b0000}}, // L
+        {{0b0000, 0b0111, 0b0100, 0b0000}}, // J
+    }};
+
+    // This is the GameBoard for the sizes we know at compile time (the difficulty modes).
+    // It has the same interface as GameBoard so the same code can drive either one, but the
+    // storage is a std::array and all of the bounds are constants, so the compiler can unroll
+    // the loops and the collision checks become a few ANDs on the row masks. The game runs the
+    // difficulty modes on it (BasicSimulation, with the bot planning on a GameBoard copy once a
+    // piece) unless the game needs a piece set, cascade gravity or undo, which it doesn't have
+    template <int Width, int Height>
+    class FixedGameBoard
+    {
+        static_assert(Width >= 5 && Width <= 50 && Height >= 5 && Height <= 50,
+                      "FixedGameBoard has the same size limits as GameBoard");
+
+    public:
+        static constexpr RowMask full_row = (RowMask(1) << Width) - 1;
+
+        FixedGameBoard() : b_x(0), b_y(0), rows{}, cells{}, block(1), piece(shape_masks[1]), score(0), lines_cleared(0) {}
+
+        int b_x; // variable for falling piece's x pos
+        int b_y; // variable for falling piece's y pos
+
+        void generate_new_piece()
+        {
+            block = rng() % 7 + 1;
+            b_x = rng() % (Width - 4);
+            b_y = 0;
+            rotation = 0;
+
+            piece = shape_masks[block];
+
+            if (event_bus)
+            {
+                publish(EventType::PieceSpawned);
+                if (is_game_over())
+                    publish(EventType::GameOver);
+            }
+        }
+
+        void seed(unsigned value)
+        {
+            rng.seed(value);
+        }
+
+        void reset()
+        {
+            rows = {};
+            cells = {};
+            score = 0;
+            lines_cleared = 0;
+            pieces = 0;
+            rotation = 0;
+        }
+
+        // a piece that doesn't collide is in bounds, this is the same check as has_hit_pile
+        bool in_bounds() const
+        {
+            return !has_hit_pile();
+        }
+
+        bool has_hit_pile() const
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                if (piece[y] == 0)
+                    continue;
+
+                int gridY = y + b_y;
+                RowMask placed;
+                if (gridY < 0 || gridY >= Height || !place(piece[y], placed) || (rows[gridY] & placed))
+                    return true;
+            }
+            return false;
+        }
+
+        // clears the full lines, the rows above get copied down and the rows left at the top are emptied
+        void shift_down()
+        {
+            int deleted_line = Height - 1;
+            int linesCleared = 0;
+            cleared_rows.clear();
+
+            for (int undeleted_line = Height - 1; undeleted_line >= 0; undeleted_line--)
+            {
+                if (rows[undeleted_line] == full_row)
+                {
+                    ++linesCleared;
+                    cleared_rows.push_back(undeleted_line);
+                    continue;
+                }
+                if (deleted_line != undeleted_line)
+                {
+                    rows[deleted_line] = rows[undeleted_line];
+                    cells[deleted_line] = cells[undeleted_line];
+                }
+                --deleted_line;
+            }
+            for (; deleted_line >= 0; --deleted_line)
+            {
+                rows[deleted_line] = 0;
+                cells[deleted_line] = {};
+            }
+
+            lines_cleared += linesCleared;
+            score += (linesCleared * linesCleared) * 100;
+
+            if (linesCleared > 0 && rows_cleared_listener)
+                rows_cleared_listener(cleared_rows);
+
+            if (linesCleared > 0 && event_bus)
+            {
+                Event event;
+                event.type = EventType::LinesCleared;
+                event.count = static_cast<std::int16_t>(linesCleared);
+                for (int i = 0; i < linesCleared && i < static_cast<int>(event.rows.size()); ++i)
+                    event.rows[i] = static_cast<std::int16_t>(cleared_rows[i]);
+                event.score = score;
+                event.lines = lines_cleared;
+                event_bus->publish(event);
+            }
+        }
+
+        // same events as GameBoard::set_event_bus
+        void set_event_bus(EventBus *bus)
+        {
+            event_bus = bus;
+        }
+
+        void set_rows_cleared_listener(RowsClearedListener listener)
+        {
+            rows_cleared_listener = std::move(listener);
+        }
+
+        bool move_down()
+        {
+            ++b_y;
+
+            if (has_hit_pile())
+            {
+                --b_y;
+                for (int y = 0; y < 4; ++y)
+                {
+                    int grid_row = b_y + y;
+                    if (piece[y] == 0 || grid_row < 0 || grid_row >= Height)
+                        continue;
+
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        int grid_col = b_x + x;
+                        if ((piece[y] >> x & 1) && grid_col >= 0 && grid_col < Width)
+                        {
+                            cells[grid_row][grid_col] = static_cast<std::uint8_t>(block);
+                            rows[grid_row] |= RowMask(1) << grid_col;
+                        }
+                    }
+                }
+
+                ++pieces;
+                if (event_bus)
+                    publish(EventType::PieceLocked);
+
+                shift_down();
+                generate_new_piece();
+                return false;
+            }
+
+            if (event_bus)
+                publish(EventType::PieceMoved);
+            return true;
+        }
+
+        // same rotation as GameBoard::rotate, (y, x) goes to (3 - x, y)
+        void rotate()
+        {
+            std::array<std::uint8_t, 4> rotated_block{};
+            for (int y = 0; y < 4; ++y)
+            {
+                for (int x = 0; x < 4; ++x)
+                {
+                    if (piece[y] >> x & 1)
+                        rotated_block[3 - x] |= 1 << y;
+                }
+            }
+            piece = rotated_block;
+            rotation = (rotation + 1) % 4;
+        }
+
+        // same moves as GameBoard::handle_input
+        void handle_input(Input input)
+        {
+            switch (input)
+            {
+            case Input::Left:
+                --b_x;
+                if (!in_bounds())
+                    ++b_x;
+                else if (event_bus)
+                    publish(EventType::PieceMoved);
+                break;
+            case Input::Right:
+                ++b_x;
+                if (!in_bounds())
+                    --b_x;
+                else if (event_bus)
+                    publish(EventType::PieceMoved);
+                break;
+            case Input::Down:
+                move_down();
+                break;
+            case Input::Drop:
+                while (move_down())
+                    ;
+                break;
+            case Input::Rotate:
+                rotate();
+                if (!in_bounds())
+                {
+                    rotate();
+                    rotate();
+                    rotate();
+                }
+                else if (event_bus)
+                    publish(EventType::PieceRotated);
+                break;
+            }
+        }
+
+        bool is_game_over() const
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                if (piece[y] == 0)
+                    continue;
+
+                int world_y = b_y + y;
+                if (world_y < 0)
+                    return true;
+
+                RowMask placed;
+                place(piece[y], placed);
+                if (world_y < Height && (rows[world_y] & placed))
+                    return true;
+            }
+            return false;
+        }
+
+        int getHeight() const { return Height; }
+        int getWidth() const { return Width; }
+        int getBlock() const { return block; }
+        int getRotation() const { return rotation; }
+        int get_score() const { return score; }
+        int lines_cleared_count() const { return lines_cleared; }
+        int pieces_placed() const { return pieces; }
+
+        // the color number of a single cell, 0 is empty
+        int cell(int y, int x) const { return cells[y][x]; }
+        void set_cell(int y, int x, int value)
+        {
+            cells[y][x] = static_cast<std::uint8_t>(value);
+            if (value)
+                rows[y] |= RowMask(1) << x;
+            else
+                rows[y] &= ~(RowMask(1) << x);
+        }
+
+        // the occupied mask of a row, bit x is column x, and its color numbers
+        RowMask row_mask(int y) const { return rows[y]; }
+        const std::array<std::uint8_t, Width> &cell_row(int y) const { return cells[y]; }
+
+        // the current piece as row masks, and the 4x4 vector version to match GameBoard
+        const std::array<std::uint8_t, 4> &piece_rows() const { return piece; }
+        std::vector<std::vector<int>> get_current_shape() const
+        {
+            std::vector<std::vector<int>> shape(4, std::vector<int>(4, 0));
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x)
+                    shape[y][x] = piece[y] >> x & 1;
+            return shape;
+        }
+
+        // the falling piece as the seven are compiled in PieceSet::standard(), the same turns as
+        // piece, for code that draws it the way it draws a GameBoard's
+        const PieceShape &falling_shape() const
+        {
+            return PieceSet::standard().shape(block, rotation);
+        }
+
+        // the same BoardState as GameBoard's, so a save from one loads into the other
+        void save_state(BoardState &state) const
+        {
+            state.cells.resize(static_cast<std::size_t>(Height) * Width);
+            for (int y = 0; y < Height; ++y)
+                for (int x = 0; x < Width; ++x)
+                    state.cells[y * Width + x] = cells[y][x];
+            state.b_x = b_x;
+            state.b_y = b_y;
+            state.block = block;
+            state.rotation = rotation;
+            state.score = score;
+            state.lines_cleared = lines_cleared;
+            state.pieces = pieces;
+            state.rng = rng;
+        }
+
+        void load_state(const BoardState &state)
+        {
+            for (int y = 0; y < Height; ++y)
+                for (int x = 0; x < Width; ++x)
+                    set_cell(y, x, state.cells[y * Width + x]);
+            b_x = state.b_x;
+            b_y = state.b_y;
+            block = state.block;
+            rotation = state.rotation;
+            const PieceShape &shape = falling_shape();
+            for (int y = 0; y < 4; ++y)
+                piece[y] = static_cast<std::uint8_t>(shape.rows[y]);
+            score = state.score;
+            lines_cleared = state.lines_cleared;
+            pieces = state.pieces;
+            rng = state.rng;
+        }
+
+        // copies the board out into the same Grid that GameBoard uses
+        Grid getGameState() const
+        {
+            Grid grid(Height, std::vector<int>(Width, 0));
+            for (int y = 0; y < Height; ++y)
+                for (int x = 0; x < Width; ++x)
+                    grid[y][x] = cells[y][x];
+            return grid;
+        }
+
+    private:
+        void publish(EventType type)
+        {
+            Event event;
+            event.type = type;
+            event.block = static_cast<std::uint8_t>(block);
+            event.x = static_cast<std::int16_t>(b_x);
+            event.y = static_cast<std::int16_t>(b_y);
+            event.score = score;
+            event.lines = lines_cleared;
+            event_bus->publish(event);
+        }
+
+        // shifts a 4 bit piece row over to b_x, returns false if any of it lands outside the board
+        bool place(std::uint8_t piece_row, RowMask &placed) const
+        {
+            if (b_x >= 0)
+            {
+                placed = RowMask(piece_row) << b_x;
+                return (placed & ~full_row) == 0;
+            }
+            if (b_x <= -4)
+            {
+                placed = 0;
+                return piece_row == 0;
+            }
+            placed = RowMask(piece_row) >> -b_x;
+            return (piece_row & ((1 << -b_x) - 1)) == 0;
+        }
+
+        std::array<RowMask, Height> rows;                            // occupied bits of each row
+        std::array<std::array<std::uint8_t, Width>, Height> cells;   // color number of each cell
+        int block;                                                   // k_value for piece for shape_gen and color_gen
+        int rotation = 0;                                            // quarter turns of the current piece
+        std::minstd_rand rng{unseeded_board_seed()};                 // the pieces, same generator as GameBoard
+        std::array<std::uint8_t, 4> piece;                           // the current_shape as row masks
+        int score;                                                   // the score
+        int lines_cleared;                                           // the lines
+        int pieces = 0;                                              // pieces locked so far
+        std::vector<int> cleared_rows;                               // the rows the last shift_down cleared
+        RowsClearedListener rows_cleared_listener;                   // who wants to know about cleared rows
+        EventBus *event_bus = nullptr;                               // where events get published, if anywhere
+    };
+
+    // This is the one place that decides which board gets used for a size. The difficulty modes
+    // get a FixedGameBoard and anything else falls back to the runtime sized GameBoard. The visitor
+    // is called with the board, so it has to be generic (a template or a lambda taking auto &).
+    // main plays its games through here, except the ones with a piece set, cascade gravity or
+    // practice undos, which only a GameBoard has
+    template <typename Visitor>
+    auto with_game_board(int height, int width, Visitor &&visit)
+    {
+        if (width == 15 && height == 25)
+        {
+            FixedGameBoard<15, 25> board;
+            return visit(board);
+        }
+        if (width == 10 && height == 20)
+        {
+            FixedGameBoard<10, 20> board;
+            return visit(board);
+        }
+        if (width == 7 && height == 15)
+        {
+            FixedGameBoard<7, 15> board;
+            return visit(board);
+        }
+        GameBoard board(height, width);
+        return visit(board);
+    }
+
+}
+#endif // FIXED_BOARD_HPP
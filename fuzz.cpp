@@ -0,0 +1,41 @@
+#include "fuzz.hpp"
+
+namespace tetris
+{
+
+  void random_fuzz_case(std::minstd_rand &rng, std::size_t max_steps, FuzzCase &out)
+  {
+    // out of 100: left, right, down, drop, rotate and then gravity takes the rest
+    static const int weights[] = {22, 22, 8, 3, 20};
+
+    out.seed = rng();
+    out.steps.resize(1 + rng() % max_steps);
+    for (FuzzStep &step : out.steps)
+    {
+      int roll = static_cast<int>(rng() % 100);
+      step = fuzz_gravity;
+      for (int input = 0; input < 5; ++input)
+      {
+        if (roll < weights[input])
+        {
+          step = static_cast<FuzzStep>(input);
+          break;
+        }
+        roll -= weights[input];
+      }
+    }
+  }
+
+  std::string format_fuzz_case(const FuzzCase &fuzz_case)
+  {
+    static const char *names[] = {"L", "R", "D", "drop", "rot", "g"};
+    std::string text = "seed " + std::to_string(fuzz_case.seed) + ":";
+    for (FuzzStep step : fuzz_case.steps)
+    {
+      text += " ";
+      text += step <= fuzz_gravity ? names[step] : "?";
+    }
+    return text;
+  }
+
+}
@@ -0,0 +1,173 @@
+#ifndef FUZZ_HPP
+#define FUZZ_HPP
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // one tick of a fuzz case: an Input (0 to 4) or gravity, which is a move_down of its own
+    typedef std::uint8_t FuzzStep;
+    constexpr FuzzStep fuzz_gravity = 5;
+
+    // A seed and the steps played from it. Both boards are reset, seeded and given their first
+    // piece, then the steps go to both of them one at a time
+    struct FuzzCase
+    {
+        unsigned seed = 0;
+        std::vector<FuzzStep> steps;
+    };
+
+    // where the boards first disagreed, step is how many steps had been played by then
+    struct FuzzMismatch
+    {
+        bool found = false;
+        std::size_t step = 0;
+        std::string what;
+    };
+
+    // a case of up to max_steps steps, mostly moves with gravity in between, drops are rare so the
+    // games last a while
+    void random_fuzz_case(std::minstd_rand &rng, std::size_t max_steps, FuzzCase &out);
+
+    // "seed 12: L R R g D", the way a failing case gets printed
+    std::string format_fuzz_case(const FuzzCase &fuzz_case);
+
+    // Compares two boards that should be in the same state. The grids only change when a piece
+    // locks, so they're only compared cell by cell when the piece count moved (or check_cells is
+    // set), the rest is a few ints every step. That's what lets it do millions of steps a second
+    template <typename Reference, typename Candidate>
+    bool same_board(Reference &reference, Candidate &candidate, bool check_cells, std::string &what)
+    {
+        if (reference.b_x != candidate.b_x || reference.b_y != candidate.b_y)
+            what = "piece position";
+        else if (reference.getBlock() != candidate.getBlock() || reference.getRotation() != candidate.getRotation())
+            what = "piece";
+        else if (reference.get_score() != candidate.get_score())
+            what = "score";
+        else if (reference.lines_cleared_count() != candidate.lines_cleared_count())
+            what = "lines";
+        else if (reference.pieces_placed() != candidate.pieces_placed())
+            what = "pieces";
+        else if (reference.is_game_over() != candidate.is_game_over())
+            what = "game over";
+        else if (check_cells)
+        {
+            for (int y = 0; y < reference.getHeight(); ++y)
+            {
+                for (int x = 0; x < reference.getWidth(); ++x)
+                {
+                    if (reference.cell(y, x) != candidate.cell(y, x))
+                    {
+                        what = "cell " + std::to_string(x) + "," + std::to_string(y);
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+        else
+            return true;
+        return false;
+    }
+
+    template <typename Board>
+    void play_fuzz_step(Board &board, FuzzStep step)
+    {
+        if (step == fuzz_gravity)
+            board.move_down();
+        else
+            board.handle_input(static_cast<Input>(step));
+    }
+
+    // Plays the case on both boards (the same size) in lockstep and compares them after every step.
+    // The case stops early when the reference's game is over, steps (if not null) counts the steps played
+    template <typename Reference, typename Candidate>
+    FuzzMismatch run_fuzz_case(Reference &reference, Candidate &candidate, const FuzzCase &fuzz_case,
+                               long long *steps = nullptr)
+    {
+        FuzzMismatch mismatch;
+        reference.reset();
+        candidate.reset();
+        reference.seed(fuzz_case.seed);
+        candidate.seed(fuzz_case.seed);
+        reference.generate_new_piece();
+        candidate.generate_new_piece();
+        if (!same_board(reference, candidate, true, mismatch.what))
+        {
+            mismatch.found = true;
+            return mismatch;
+        }
+
+        std::size_t played = 0;
+        for (; played < fuzz_case.steps.size() && !reference.is_game_over(); ++played)
+        {
+            int pieces = reference.pieces_placed();
+            play_fuzz_step(reference, fuzz_case.steps[played]);
+            play_fuzz_step(candidate, fuzz_case.steps[played]);
+            bool locked = reference.pieces_placed() != pieces || candidate.pieces_placed() != pieces;
+            if (!same_board(reference, candidate, locked, mismatch.what))
+            {
+                mismatch.found = true;
+                mismatch.step = played + 1;
+                break;
+            }
+        }
+        if (!mismatch.found && !same_board(reference, candidate, true, mismatch.what))
+        {
+            mismatch.found = true;
+            mismatch.step = played;
+        }
+        if (steps)
+            *steps += played;
+        return mismatch;
+    }
+
+    // Makes a failing case as short as it can while it still fails: everything after the step that
+    // failed goes first, then runs of steps are taken out, halves first and down to single steps,
+    // for as long as taking any of them out keeps it failing. Each try is a whole case, but the
+    // cases are short by then
+    template <typename Reference, typename Candidate>
+    FuzzCase shrink_fuzz_case(Reference &reference, Candidate &candidate, FuzzCase failing)
+    {
+        FuzzMismatch mismatch = run_fuzz_case(reference, candidate, failing);
+        if (!mismatch.found)
+            return failing;
+        failing.steps.resize(mismatch.step);
+
+        FuzzCase attempt;
+        attempt.seed = failing.seed;
+        for (std::size_t run = std::max<std::size_t>(1, failing.steps.size() / 2); run >= 1; run /= 2)
+        {
+            bool removed = true;
+            while (removed)
+            {
+                removed = false;
+                for (std::size_t start = 0; start < failing.steps.size(); start += run)
+                {
+                    attempt.steps.assign(failing.steps.begin(), failing.steps.begin() + start);
+                    attempt.steps.insert(attempt.steps.end(),
+                                         failing.steps.begin() + std::min(failing.steps.size(), start + run),
+                                         failing.steps.end());
+                    mismatch = run_fuzz_case(reference, candidate, attempt);
+                    if (mismatch.found)
+                    {
+                        attempt.steps.resize(mismatch.step);
+                        failing.steps.swap(attempt.steps);
+                        removed = true;
+                        break;
+                    }
+                }
+            }
+            if (run == 1)
+                break;
+        }
+        return failing;
+    }
+
+}
+#endif // FUZZ_HPP
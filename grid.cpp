@@ -1,15 +1,37 @@
 
 #include <SFML/Graphics.hpp>
+#include <cmath>
 #include <numeric>
+#include <algorithm>
 #include "grid.hpp"
+#include "event_bus.hpp"
 #include <iostream>
 #include <stdexcept>
 
 namespace tetris
 {
 
+  namespace
+  {
+    std::function<unsigned()> &board_seeds()
+    {
+      static std::function<unsigned()> source; // empty is std::random_device
+      return source;
+    }
+  }
+
+  unsigned unseeded_board_seed()
+  {
+    return board_seeds() ? board_seeds()() : std::random_device{}();
+  }
+
+  void set_unseeded_board_seeds(std::function<unsigned()> source)
+  {
+    board_seeds() = std::move(source);
+  }
+
   // Constructors
-  GameBoard::GameBoard() {}
+  GameBoard::GameBoard() : m_height(0), m_width(0), score(0), lines_cleared(0) {}
   GameBoard::GameBoard(int &height, int &width) : grid(height, std::vector<int>(width, 0)),
                                                   m_height(height), m_width(width), score(0), lines_cleared(0)
   {
@@ -28,53 +50,148 @@ namespace tetris
 
   void GameBoard::generate_new_piece()
   {
-    std::srand(std::time(nullptr));
-    block = std::rand() % 7 + 1;
-    b_x = std::rand() % (m_width - 4);
+    // the seven pieces in their 4 wide boxes come out just like they always did for a seed
+    block = rng() % piece_set->count() + 1;
+    b_x = rng() % std::max(1, m_width - piece_set->box_size());
     b_y = 0;
+    rotation = 0;
 
-    current_piece = shapes.at(block);
+    if (event_bus)
+    {
+      publish(EventType::PieceSpawned);
+      // a piece that spawns on top of the pile is the end of the game
+      if (is_game_over())
+        publish(EventType::GameOver);
+    }
   }
-  bool GameBoard::in_bounds()
+  void GameBoard::seed(unsigned value)
   {
-    for (int y = 0; y < 4; ++y)
+    rng.seed(value);
+  }
+
+  void GameBoard::reset()
+  {
+    for (std::vector<int> &row : grid)
+    {
+      std::fill(row.begin(), row.end(), 0);
+    }
+    score = 0;
+    lines_cleared = 0;
+    pieces = 0;
+    rotation = 0;
+  }
+
+  void GameBoard::save_state(BoardState &state) const
+  {
+    state.cells.resize(static_cast<std::size_t>(m_height) * m_width);
+    for (int y = 0; y < m_height; ++y)
     {
-      for (int x = 0; x < 4; ++x)
+      for (int x = 0; x < m_width; ++x)
       {
-        if (current_piece[y][x] == 0)
-          continue;
+        state.cells[y * m_width + x] = static_cast<std::uint8_t>(grid[y][x]);
+      }
+    }
 
-        int grid_x = x + b_x;
-        int grid_y = y + b_y;
+    state.b_x = b_x;
+    state.b_y = b_y;
+    state.block = block;
+    state.rotation = rotation;
+    state.score = score;
+    state.lines_cleared = lines_cleared;
+    state.pieces = pieces;
+    state.rng = rng;
+  }
 
-        if (grid_x < 0 || grid_x >= m_width || grid_y < 0 || grid_y >= m_height)
-          return false;
+  void GameBoard::load_state(const BoardState &state)
+  {
+    for (int y = 0; y < m_height; ++y)
+    {
+      for (int x = 0; x < m_width; ++x)
+      {
+        grid[y][x] = state.cells[y * m_width + x];
+      }
+    }
 
-        if (grid_y >= 0 && grid[grid_y][grid_x])
-          return false;
+    b_x = state.b_x;
+    b_y = state.b_y;
+    block = state.block;
+    rotation = state.rotation;
+    score = state.score;
+    lines_cleared = state.lines_cleared;
+    pieces = state.pieces;
+    rng = state.rng;
+  }
+
+  std::uint32_t GameBoard::checksum() const
+  {
+    // FNV-1a, it's not for security, it only has to change when the board does
+    std::uint32_t hash = 2166136261u;
+    auto mix = [&hash](std::uint32_t value)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        hash ^= (value >> (8 * i)) & 0xff;
+        hash *= 16777619u;
+      }
+    };
 
-        if (grid_x < 0)
-          return false; // Check if the piece is too far to the left
+    for (const std::vector<int> &row : grid)
+    {
+      for (int cell : row)
+      {
+        mix(cell);
       }
     }
+    const PieceShape &shape = falling_shape();
+    for (int y = 0; y < shape.size; ++y)
+    {
+      for (int x = 0; x < shape.size; ++x)
+      {
+        mix(shape.rows[y] >> x & 1);
+      }
+    }
+    mix(b_x);
+    mix(b_y);
+    mix(block);
+    mix(rotation);
+    mix(score);
+    mix(lines_cleared);
+    mix(pieces);
+
+    // the next number out of the generator stands in for its state
+    std::minstd_rand next = rng;
+    mix(next());
+    return hash;
+  }
+
+  bool GameBoard::in_bounds()
+  {
+    // only the piece's own cells, the set listed them so the empty corners of the box are never looked at
+    const PieceShape &shape = falling_shape();
+    for (int i = 0; i < shape.cell_count; ++i)
+    {
+      int grid_x = shape.cells_x[i] + b_x;
+      int grid_y = shape.cells_y[i] + b_y;
+
+      if (grid_x < 0 || grid_x >= m_width || grid_y < 0 || grid_y >= m_height)
+        return false;
+
+      if (grid[grid_y][grid_x])
+        return false;
+    }
     return true;
   }
 
   bool GameBoard::has_hit_pile()
   {
-    for (int y = 0; y < 4; ++y)
+    const PieceShape &shape = falling_shape();
+    for (int i = 0; i < shape.cell_count; ++i)
     {
-      for (int x = 0; x < 4; ++x)
-      {
-        if (current_piece[y][x] == 0)
-          continue;
-
-        int gridY = y + b_y;
-        int gridX = x + b_x;
+      int gridY = shape.cells_y[i] + b_y;
+      int gridX = shape.cells_x[i] + b_x;
 
-        if (gridY < 0 || gridY >= m_height || gridX < 0 || gridX >= m_width || grid[gridY][gridX])
-          return true;
-      }
+      if (gridY < 0 || gridY >= m_height || gridX < 0 || gridX >= m_width || grid[gridY][gridX])
+        return true;
     }
     return false;
   }
@@ -84,6 +201,7 @@ namespace tetris
   {
     int deleted_line = m_height - 1;
     int linesCleared = 0; // Initialize linesCleared to count cleared lines
+    cleared_rows.clear();
 
     for (int undeleted_line = m_height - 1; undeleted_line >= 0; undeleted_line--)
     {
@@ -105,15 +223,93 @@ namespace tetris
       else
       {
         ++linesCleared;
-        sf::sleep(sf::milliseconds(20)); // Increment linesCleared for each cleared line
+        cleared_rows.push_back(undeleted_line);
       }
     }
 
+    // the rows left over at the top are empty now, otherwise they would keep their old blocks
+    for (; deleted_line >= 0; --deleted_line)
+    {
+      std::fill(grid[deleted_line].begin(), grid[deleted_line].end(), 0);
+    }
+
     lines_cleared += linesCleared;
     score += (linesCleared * linesCleared) * 100;
 
-    // Update your score here with the number of lines cleared
-    // For example: score += linesCleared;
+    // the clear is already done here, the listener (the renderer) can animate it afterwards
+    // instead of the board sleeping for every line like it used to
+    if (linesCleared > 0 && rows_cleared_listener)
+    {
+      rows_cleared_listener(cleared_rows);
+    }
+
+    if (linesCleared > 0 && event_bus)
+    {
+      Event event;
+      event.type = EventType::LinesCleared;
+      event.count = static_cast<std::int16_t>(linesCleared);
+      for (int i = 0; i < linesCleared && i < static_cast<int>(event.rows.size()); ++i)
+      {
+        event.rows[i] = static_cast<std::int16_t>(cleared_rows[i]);
+      }
+      event.score = score;
+      event.lines = lines_cleared;
+      event_bus->publish(event);
+    }
+  }
+
+  bool GameBoard::settle()
+  {
+    int words = (m_width + 63) / 64;
+    cascade_bits.assign(static_cast<std::size_t>(m_height) * words, 0);
+    cascade_rows.resize(m_height);
+    for (int y = 0; y < m_height; ++y)
+    {
+      std::uint64_t *row = &cascade_bits[static_cast<std::size_t>(y) * words];
+      for (int x = 0; x < m_width; ++x)
+      {
+        if (grid[y][x])
+          row[x >> 6] |= std::uint64_t(1) << (x & 63);
+      }
+      cascade_rows[y] = row;
+    }
+    if (!cascade_planner.plan(cascade_rows.data(), m_height, m_width, 0, m_height - 1, cascade_moves))
+      return false;
+
+    // every run is lifted out before any is put down, one can land where another one was
+    lifted.clear();
+    for (const CascadeMove &move : cascade_moves)
+    {
+      for (int x = move.x; x < move.x + move.length; ++x)
+      {
+        lifted.push_back(grid[move.y][x]);
+        grid[move.y][x] = 0;
+      }
+    }
+    std::size_t next = 0;
+    for (const CascadeMove &move : cascade_moves)
+    {
+      for (int x = move.x; x < move.x + move.length; ++x)
+        grid[move.y + move.drop][x] = lifted[next++];
+    }
+    return true;
+  }
+
+  void GameBoard::publish(EventType type)
+  {
+    Event event;
+    event.type = type;
+    event.block = static_cast<std::uint8_t>(block);
+    event.x = static_cast<std::int16_t>(b_x);
+    event.y = static_cast<std::int16_t>(b_y);
+    event.score = score;
+    event.lines = lines_cleared;
+    event_bus->publish(event);
+  }
+
+  void GameBoard::set_rows_cleared_listener(RowsClearedListener listener)
+  {
+    rows_cleared_listener = std::move(listener);
   }
 
   bool GameBoard::move_down()
@@ -125,51 +321,96 @@ namespace tetris
     {
       // moves it back up
       --b_y;
-      for (int y = 0; y < 4; ++y)
+      const PieceShape &shape = falling_shape();
+      for (int i = 0; i < shape.cell_count; ++i)
       {
-        for (int x = 0; x < 4; ++x)
+        int grid_row = b_y + shape.cells_y[i];
+        int grid_col = b_x + shape.cells_x[i];
+
+        // Check boundary conditions before accessing grid elements
+        if (grid_row >= 0 && grid_row < m_height && grid_col >= 0 && grid_col < m_width)
         {
-          if (current_piece[y][x])
-          {
-            int grid_row = b_y + y;
-            int grid_col = b_x + x;
-
-            // Check boundary conditions before accessing grid elements
-            if (grid_row >= 0 && grid_row < m_height && grid_col >= 0 && grid_col < m_width)
-            {
-              // this aids for color generate of the pile
-              grid[grid_row][grid_col] = block;
-            }
-          }
+          // this aids for color generate of the pile
+          grid[grid_row][grid_col] = block;
         }
       }
 
+      ++pieces;
+      lock.x = b_x;
+      lock.y = b_y;
+      lock.rotation = rotation;
+      if (event_bus)
+        publish(EventType::PieceLocked);
+
       shift_down();
+      // in cascade mode what the clear cut loose falls, and every line that fills clears too
+      while (cascade && !cleared_rows.empty() && settle())
+        shift_down();
       generate_new_piece();
       return false;
     }
+
+    if (event_bus)
+      publish(EventType::PieceMoved);
     return true;
   }
 
   void GameBoard::rotate()
   {
+    // the set turned every piece all 4 ways when it was made, so a turn is just the next one of them
+    rotation = (rotation + 1) % 4;
+  }
 
-    // create a temp 2d vector for the rotated_piece
-    std::vector<std::vector<int>> rotated_block(4, std::vector<int>(4, 0));
+  std::vector<std::vector<int>> GameBoard::get_current_shape() const
+  {
+    const PieceShape &shape = falling_shape();
+    std::vector<std::vector<int>> box(shape.size, std::vector<int>(shape.size, 0));
+    for (int i = 0; i < shape.cell_count; ++i)
+    {
+      box[shape.cells_y[i]][shape.cells_x[i]] = 1;
+    }
+    return box;
+  }
 
-    for (int y = 0; y < 4; ++y)
+  void GameBoard::handle_input(Input input)
+  {
+    switch (input)
     {
-      for (int x = 0; x < 4; ++x)
+    case Input::Left:
+      --b_x;
+      if (!in_bounds())
+        ++b_x;
+      else if (event_bus)
+        publish(EventType::PieceMoved);
+      break;
+    case Input::Right:
+      ++b_x;
+      if (!in_bounds())
+        --b_x;
+      else if (event_bus)
+        publish(EventType::PieceMoved);
+      break;
+    case Input::Down:
+      move_down();
+      break;
+    case Input::Drop:
+      // fall down until reaches the bottom
+      while (move_down())
+        ;
+      break;
+    case Input::Rotate:
+      rotate();
+      // if rotation hits boundary, do not allow to rotate
+      if (!in_bounds())
       {
-        if (current_piece[y][x])
-        {
-          rotated_block[3 - x][y] = 1;
-        }
+        rotate();
+        rotate();
+        rotate();
       }
+      else if (event_bus)
+        publish(EventType::PieceRotated);
+      break;
     }
-
-    // this makes the current_piece rotated
-    current_piece = std::move(rotated_block);
   }
 
   Grid &GameBoard::getGameState()
@@ -184,31 +425,45 @@ namespace tetris
 
   bool GameBoard::is_game_over()
   {
-    for (int y = 0; y < 4; y++)
+    const PieceShape &shape = falling_shape();
+    for (int i = 0; i < shape.cell_count; i++)
     {
-      for (int x = 0; x < 4; x++)
+      int world_x = b_x + shape.cells_x[i];
+      int world_y = b_y + shape.cells_y[i];
+
+      // Check if the block is out of the top boundary
+      if (world_y < 0)
       {
-        if (current_piece[y][x] == 1)
-        {
-          int world_x = b_x + x;
-          int world_y = b_y + y;
-
-          // Check if the block is out of the top boundary
-          if (world_y < 0)
-          {
-            return true;
-          }
-
-          // Check if the block collides with existing blocks in the world
-          if (world_y >= 0 && grid[world_y][world_x] != 0)
-          {
-            return true;
-          }
-        }
+        return true;
+      }
+
+      // Check if the block collides with existing blocks in the world
+      if (grid[world_y][world_x] != 0)
+      {
+        return true;
       }
     }
 
     return false;
   }
 
+  sf::Color palette(int color)
+  {
+    static const sf::Color seven[8] = {sf::Color::Black, sf::Color::Yellow, sf::Color::Cyan, sf::Color::Green,
+                                       sf::Color::Red, sf::Color::Magenta, sf::Color(228, 138, 64), sf::Color::Blue};
+    if (color >= 0 && color < 8)
+      return seven[color];
+
+    // a golden angle on from the last one each time, bright and not too washed out
+    double hue = std::fmod(40 + (color - 8) * 137.508, 360.0) / 60;
+    double fraction = hue - std::floor(hue);
+    double high = 235, low = 70;
+    double rising = low + (high - low) * fraction;
+    double falling = high - (high - low) * fraction;
+    double rgb[6][3] = {{high, rising, low}, {falling, high, low}, {low, high, rising},
+                        {low, falling, high}, {rising, low, high}, {high, low, falling}};
+    const double *c = rgb[static_cast<int>(hue) % 6];
+    return sf::Color(static_cast<sf::Uint8>(c[0]), static_cast<sf::Uint8>(c[1]), static_cast<sf::Uint8>(c[2]));
+  }
+
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #ifndef GRID_HPP
 #define GRID_HPP
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <random>
 #include <SFML/Graphics.hpp>
+#include "pieces.hpp"
+#include "cascade.hpp"
 
 namespace tetris
 {
@@ -12,17 +17,10 @@ namespace tetris
     // private variables within the GameBoard class. Storing them inside a function when required might
     // have also been interesting, but perhaps computationally unnecessary
 
-    // this is a map of all the colors, the board keeps of track of the corresponding number
-    // for color purposes, I think this was an interesting choice, perhaps I could have represented
-    // it in the pieces, but that would require a rewrite of a few other functions (line_clearing, etc)
-    const std::unordered_map<int, sf::Color> colors = {
-        {1, sf::Color::Yellow},
-        {2, sf::Color::Cyan},
-        {3, sf::Color::Green},
-        {4, sf::Color::Red},
-        {5, sf::Color::Magenta},
-        {6, sf::Color(228, 138, 64)},
-        {7, sf::Color::Blue}};
+    // the color a cell is drawn in, by its color number (0 is empty, and never drawn). 1 to 7 are the
+    // colors the seven pieces always had, the numbers after them (pieces from a file, see pieces.hpp)
+    // go round the color wheel so no two neighbours look alike
+    sf::Color palette(int color);
 
     // O
     const std::vector<std::vector<int>> O_SHAPE = {
@@ -88,6 +86,52 @@ namespace tetris
     // I thought typedef was cool, and convenient
     typedef std::vector<std::vector<int>> Grid;
 
+    // called by shift_down with the row indices (from the bottom up, as they were before the shift)
+    // that it just cleared, so a renderer can play the clear effect without the board waiting on it
+    typedef std::function<void(const std::vector<int> &rows)> RowsClearedListener;
+
+    // the things a player (or anything else driving the board) can do to the falling piece
+    enum class Input
+    {
+        Left,
+        Right,
+        Down,
+        Drop,
+        Rotate
+    };
+
+    // Everything that makes a board what it is, flattened so saving and loading is a few copies
+    // into memory that's already there. Rollback saves one of these every tick
+    struct BoardState
+    {
+        std::vector<std::uint8_t> cells;  // height * width color numbers, row by row
+        int b_x = 0;
+        int b_y = 0;
+        int block = 1;                   // the falling piece is this one of the board's set, turned rotation times
+        int rotation = 0;
+        int score = 0;
+        int lines_cleared = 0;
+        int pieces = 0;
+        std::minstd_rand rng;            // so the next pieces come out the same after a load
+    };
+
+    // where a piece locked into the pile, locking the same piece there again does the same thing
+    struct PieceLock
+    {
+        int x = 0;
+        int y = 0;
+        int rotation = 0;
+    };
+
+    // where a board nobody calls seed() on starts its pieces from: std::random_device, unless a
+    // program has set a source of its own (the tests do, so a run comes out the same from its
+    // seed). it's called on whatever thread makes the board, set it before there are any
+    unsigned unseeded_board_seed();
+    void set_unseeded_board_seeds(std::function<unsigned()> source);
+
+    class EventBus;         // event_bus.hpp, boards publish what happens into one of these
+    enum class EventType : std::uint8_t;
+
     // This is the gameboard class
     class GameBoard
     {
@@ -95,13 +139,25 @@ namespace tetris
         GameBoard();                        // default constructor
         GameBoard(int &height, int &width); // this is the usual constructor
         void generate_new_piece();          // a new piece is generate randomly
+        void seed(unsigned value);          // restarts the random pieces from a seed, same seed same pieces
+        void reset();                       // empties the board and the score, keeps the size
+        void save_state(BoardState &state) const; // copies the board into state, reusing its memory
+        void load_state(const BoardState &state); // puts a saved board back (it has to be the same size)
+        std::uint32_t checksum() const;      // a hash of the whole state, for spotting boards that differ
         bool in_bounds();                   // this checks if a piece is within the bounds of the game_board
-        void shift_down();                  // this
+        void shift_down();                  // this clears the full lines and moves the rest down
         bool move_down();
         void rotate();        // this rotates a piece
+        void handle_input(Input input); // applies a move, moves that don't fit are undone
         Grid &getGameState(); // this gets the actual game_state,
         // I should have kept it const, but it would be hard to simulate game_over working
 
+        // how many quarter turns the falling piece has made since it spawned (0 to 3)
+        int getRotation() const
+        {
+            return rotation;
+        }
+
         const int &getBlock(); // this is a const method that tracks the current piece/block falling, it is useful in keeping state
         int b_x;               // variable for falling piece's x pos
         int b_y;               // variable for falling piece's y pos
@@ -136,20 +192,95 @@ namespace tetris
             return lines_cleared;
         }
 
-        // gets the shape of the current_piece (a std::vector<std::vector<int>>)
-        std::vector<std::vector<int>> get_current_shape()
+        // how many pieces have locked into the pile this game
+        int pieces_placed() const
+        {
+            return pieces;
+        }
+
+        // where the latest piece to lock went, undo.hpp keeps these instead of whole boards
+        const PieceLock &last_lock() const
         {
-            return current_piece;
+            return lock;
         }
 
+        // sets who gets told about cleared rows, headless runs just never set one
+        void set_rows_cleared_listener(RowsClearedListener listener);
+
+        // events go to this bus from now on, nullptr turns them off (and they cost nothing then)
+        void set_event_bus(EventBus *bus)
+        {
+            event_bus = bus;
+        }
+
+        // the color number of a single cell, 0 is empty (FixedGameBoard has the same one)
+        int cell(int y, int x) const
+        {
+            return grid[y][x];
+        }
+
+        // gets the shape of the current_piece (a std::vector<std::vector<int>>, as big as its box)
+        std::vector<std::vector<int>> get_current_shape() const;
+
+        // the falling piece as its set compiled it, its cells are what collisions and locking go through
+        const PieceShape &falling_shape() const
+        {
+            return piece_set->shape(block, rotation);
+        }
+
+        // the pieces this board deals out, PieceSet::standard() unless it's given another set (which
+        // has to outlive the board). the falling piece has to be one of the new set, so a new one is
+        // dealt or a state for the new set loaded right after
+        void set_piece_set(const PieceSet &set)
+        {
+            piece_set = &set;
+            block = 1;
+            rotation = 0;
+        }
+        const PieceSet &get_piece_set() const
+        {
+            return *piece_set;
+        }
+
+        // cascade gravity (cascade.hpp): after a clear every group of touching blocks falls on its
+        // own until it lands, and the lines that fills clear too, again and again until nothing
+        // moves. set it before the first piece, a pile from the usual gravity can have loose groups
+        void set_cascade(bool on)
+        {
+            cascade = on;
+        }
+        bool get_cascade() const
+        {
+            return cascade;
+        }
+
+        // lets every group that isn't held up fall until it is, true if any did. move_down does
+        // this after every clear in cascade mode
+        bool settle();
+
     private:
         Grid grid;                                   // the game_board
         int m_height;                                // the game height
         int m_width;                                 // the game_width
-        int block;                                   // k_value for piece for shape_gen and color_gen
-        std::vector<std::vector<int>> current_piece; // the current_shape
+        int block = 1;                               // k_value for piece for shape_gen and color_gen
+        int rotation = 0;                            // quarter turns of the current piece
+        std::minstd_rand rng{unseeded_board_seed()}; // every board has its own pieces, so boards on different threads don't share rand()
+        const PieceSet *piece_set = &PieceSet::standard(); // where the pieces come from, block picks one
         int score;                                   // the score
         int lines_cleared;                           // the lines
+        int pieces = 0;                              // pieces locked so far
+        PieceLock lock;                              // where the last of them locked
+        std::vector<int> cleared_rows;               // the rows the last shift_down cleared
+        RowsClearedListener rows_cleared_listener;   // who wants to know about cleared rows
+        EventBus *event_bus = nullptr;               // where events get published, if anywhere
+        bool cascade = false;                        // groups fall on their own after a clear
+        CascadePlanner cascade_planner;              // works out how far they fall
+        std::vector<std::uint64_t> cascade_bits;     // the grid as bit rows for it, and what moves
+        std::vector<const std::uint64_t *> cascade_rows;
+        std::vector<CascadeMove> cascade_moves;
+        std::vector<int> lifted;                     // the colors of the cells that are falling
+
+        void publish(EventType type); // publishes an event about the falling piece
     };
 
 }
@@ -0,0 +1,198 @@
+#include "hint.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // a placement with what it's worth at the depth that was last finished
+    struct Scored
+    {
+      double value;
+      Placement placement;
+    };
+  }
+
+  HintEngine::HintEngine(int height, int width)
+  {
+    levels.reserve(max_depth);
+    for (int level = 0; level < max_depth; ++level)
+      levels.emplace_back(height, width);
+    thread = std::thread(&HintEngine::run, this);
+  }
+
+  HintEngine::~HintEngine()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping.store(true);
+    }
+    wake.notify_one();
+    thread.join();
+  }
+
+  void HintEngine::start_search()
+  {
+    jobs.publish();
+    // the count goes up after the board is in, so whoever sees the new count gets that board (or a newer one)
+    requested.fetch_add(1, std::memory_order_release);
+    // no lock, a wakeup that slips past is caught when the worker looks again
+    wake.notify_one();
+  }
+
+  void HintEngine::run()
+  {
+    unsigned searched = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping.load())
+    {
+      wake.wait_for(lock, std::chrono::milliseconds(100), [&]
+                    { return stopping.load() || requested.load(std::memory_order_acquire) != searched; });
+      unsigned generation = requested.load(std::memory_order_acquire);
+      if (stopping.load() || generation == searched)
+        continue;
+
+      searched = generation;
+      lock.unlock();
+      jobs.update();
+      run_search(generation);
+      lock.lock();
+    }
+  }
+
+  void HintEngine::run_search(unsigned generation)
+  {
+    Level &top = levels[0];
+    top.board.load_state(jobs.read_buffer());
+    root_lines = top.board.lines_cleared_count();
+    int pieces = top.board.pieces_placed();
+
+    legal_placements(top.board, top.scratch, top.start, top.placements);
+    if (top.placements.empty())
+    {
+      Hint &none = hints.write_buffer();
+      none = Hint();
+      none.pieces = pieces;
+      hints.publish();
+      return;
+    }
+
+    // depth 1 is the falling piece on its own, what the bot would play, it's there almost at once
+    std::vector<Scored> scored;
+    for (Placement placement : top.placements)
+    {
+      top.scratch.load_state(top.start);
+      move_to(top.scratch, placement);
+      top.scratch.handle_input(Input::Drop);
+      scored.push_back({placement_value(top.scratch, root_lines), placement});
+    }
+
+    // best first, so the deeper looks start with the likely ones and the last one only takes the
+    // best few. every depth sorts them again by what it found
+    auto better = [](const Scored &a, const Scored &b)
+    { return a.value > b.value; };
+    std::stable_sort(scored.begin(), scored.end(), better);
+    publish(scored[0].placement, 1, pieces);
+
+    for (int depth = 2; depth <= max_depth; ++depth)
+    {
+      std::size_t count = depth == max_depth ? std::min<std::size_t>(deep_beam, scored.size()) : scored.size();
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        top.scratch.load_state(top.start);
+        move_to(top.scratch, scored[i].placement);
+        top.scratch.handle_input(Input::Drop);
+        top.scratch.save_state(top.after);
+        double value = top.scratch.is_game_over() ? -1e9 : expected_value(top.after, 1, depth - 1, generation);
+        if (cancelled(generation))
+          return;
+        scored[i].value = value;
+      }
+      std::stable_sort(scored.begin(), scored.begin() + count, better);
+      publish(scored[0].placement, depth, pieces);
+    }
+  }
+
+  double HintEngine::expected_value(const BoardState &state, int level, int depth, unsigned generation)
+  {
+    // which piece comes next is down to the board's generator, the hint doesn't peek at it, it
+    // takes each of them in turn where the real one spawned and averages how well they go
+    Level &here = levels[level];
+    double total = 0;
+    int count = here.board.get_piece_set().count();
+    for (int block = 1; block <= count; ++block)
+    {
+      here.start = state;
+      here.start.block = block;
+      here.start.rotation = 0;
+      here.start.b_y = 0;
+      here.board.load_state(here.start);
+
+      total += best_value(level, depth, generation);
+      if (cancelled(generation))
+        return 0;
+    }
+    return total / count;
+  }
+
+  double HintEngine::best_value(int level, int depth, unsigned generation)
+  {
+    Level &here = levels[level];
+    legal_placements(here.board, here.scratch, here.start, here.placements);
+    if (here.placements.empty())
+      return -1e9;
+
+    double best = -std::numeric_limits<double>::infinity();
+    for (Placement placement : here.placements)
+    {
+      here.scratch.load_state(here.start);
+      move_to(here.scratch, placement);
+      here.scratch.handle_input(Input::Drop);
+
+      double value;
+      if (depth == 1 || here.scratch.is_game_over())
+        value = placement_value(here.scratch, root_lines);
+      else
+      {
+        here.scratch.save_state(here.after);
+        value = expected_value(here.after, level + 1, depth - 1, generation);
+      }
+      if (cancelled(generation))
+        return best;
+      best = std::max(best, value);
+    }
+    return best;
+  }
+
+  void HintEngine::publish(const Placement &placement, int depth, int pieces)
+  {
+    // where the piece comes to rest, it's moved there and let down a row at a time until it can't go further
+    Level &top = levels[0];
+    top.scratch.load_state(top.start);
+    move_to(top.scratch, placement);
+    do
+    {
+      ++top.scratch.b_y;
+    } while (!top.scratch.has_hit_pile());
+    --top.scratch.b_y;
+
+    Hint &hint = hints.write_buffer();
+    hint.found = true;
+    hint.pieces = pieces;
+    hint.depth = depth;
+    hint.placement = placement;
+    hint.cell_count = 0;
+    const PieceShape &shape = top.scratch.falling_shape();
+    for (int i = 0; i < shape.cell_count; ++i)
+    {
+      hint.cells_x[i] = top.scratch.b_x + shape.cells_x[i];
+      hint.cells_y[i] = top.scratch.b_y + shape.cells_y[i];
+      ++hint.cell_count;
+    }
+    hints.publish();
+  }
+
+}
@@ -0,0 +1,96 @@
+#ifndef HINT_HPP
+#define HINT_HPP
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bot.hpp"
+#include "grid.hpp"
+#include "triple_buffer.hpp"
+
+namespace tetris
+{
+
+    // where the hint engine thinks the falling piece should go, and the cells it ends up on
+    struct Hint
+    {
+        bool found = false;
+        int pieces = -1;       // pieces_placed() of the board it's for, a hint for another one is stale
+        int depth = 0;         // how many pieces it looked at, the falling one is 1
+        Placement placement{0, 0};
+        int cell_count = 0;
+        int cells_x[max_piece_size * max_piece_size] = {};
+        int cells_y[max_piece_size * max_piece_size] = {};
+    };
+
+    // Works out hints on a thread of its own, so the game never waits for it. search() hands it
+    // the board whenever a new piece spawns (or the board is put back by an undo), through a
+    // triple buffer, and whatever it was still working on is dropped the moment it sees that. It
+    // deepens as long as it's left alone: first the falling piece alone (what the bot plays), then
+    // every placement followed by each of the pieces that could come next, averaged since
+    // nobody knows which one it will be, then one more piece for the best few of those. After
+    // every depth the best so far goes into another triple buffer for the render loop, so a piece
+    // that's in the air longer gets a hint that looked further ahead
+    class HintEngine
+    {
+    public:
+        static constexpr int max_depth = 3;
+        static constexpr int deep_beam = 4; // how many of the best placements the last depth looks at
+
+        HintEngine(int height, int width); // the size of the boards it will get
+        ~HintEngine();
+
+        HintEngine(const HintEngine &) = delete;
+        HintEngine &operator=(const HintEngine &) = delete;
+
+        // game side, one thread: starts over on this board, it's copied so it can go on changing.
+        // any board with save_state will do, a GameBoard or a FixedGameBoard
+        template <typename Board>
+        void search(const Board &board)
+        {
+            board.save_state(jobs.write_buffer());
+            start_search();
+        }
+
+        // render side, one thread: picks up the newest hint, false if nothing new came in
+        bool update() { return hints.update(); }
+        const Hint &hint() const { return hints.read_buffer(); }
+
+    private:
+        // the boards and buffers for looking one piece further on, reused every search
+        struct Level
+        {
+            Level(int height, int width) : board(height, width), scratch(height, width) {}
+
+            GameBoard board;
+            GameBoard scratch;
+            BoardState start;
+            BoardState after;
+            std::vector<Placement> placements;
+        };
+
+        void start_search(); // the board is in jobs' write buffer
+        void run();
+        void run_search(unsigned generation);
+        double expected_value(const BoardState &state, int level, int depth, unsigned generation);
+        double best_value(int level, int depth, unsigned generation);
+        void publish(const Placement &placement, int depth, int pieces);
+        bool cancelled(unsigned generation) const
+        {
+            return stopping.load(std::memory_order_relaxed) || requested.load(std::memory_order_relaxed) != generation;
+        }
+
+        TripleBuffer<BoardState> jobs;
+        TripleBuffer<Hint> hints;
+        std::vector<Level> levels;           // levels[0] is the falling piece
+        int root_lines = 0;                   // lines_cleared of the board being searched
+        std::atomic<unsigned> requested{0};   // goes up by one every search()
+        std::atomic<bool> stopping{false};
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread thread;
+    };
+
+}
+#endif // HINT_HPP
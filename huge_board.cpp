@@ -0,0 +1,349 @@
+#include "huge_board.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // the bits of word w that are columns x to x + length - 1
+    std::uint64_t span_mask(int w, int x, int length)
+    {
+      int lo = std::max(x, w * 64) - w * 64;
+      int hi = std::min(x + length - 1, w * 64 + 63) - w * 64;
+      return (~std::uint64_t(0) >> (63 - hi)) & (~std::uint64_t(0) << lo);
+    }
+  }
+
+  HugeGameBoard::HugeGameBoard(int height, int width) : height(height), width(width), top(height)
+  {
+    if (height < 5 || height > max_side || width < 5 || width > max_side)
+      throw std::invalid_argument("Cannot build a board of " + std::to_string(width) + " x " + std::to_string(height));
+
+    words = (width + 63) / 64;
+    last_word = width % 64 ? (std::uint64_t(1) << (width % 64)) - 1 : ~std::uint64_t(0);
+    storage.assign(static_cast<std::size_t>(height) * 4 * words, 0);
+    rows.resize(height);
+    for (int y = 0; y < height; ++y)
+      rows[y] = &storage[static_cast<std::size_t>(y) * 4 * words];
+  }
+
+  void HugeGameBoard::generate_new_piece()
+  {
+    block = rng() % 7 + 1;
+    b_x = rng() % (width - 4);
+    b_y = 0;
+    rotation = 0;
+    piece = shape_masks[block];
+
+    if (event_bus)
+    {
+      publish(EventType::PieceSpawned);
+      if (is_game_over())
+        publish(EventType::GameOver);
+    }
+  }
+
+  void HugeGameBoard::seed(unsigned value)
+  {
+    rng.seed(value);
+  }
+
+  void HugeGameBoard::reset()
+  {
+    std::fill(storage.begin(), storage.end(), 0);
+    top = height;
+    score = 0;
+    lines_cleared = 0;
+    pieces = 0;
+    rotation = 0;
+  }
+
+  bool HugeGameBoard::has_hit_pile() const
+  {
+    for (int y = 0; y < 4; ++y)
+    {
+      if (piece[y] == 0)
+        continue;
+
+      int grid_y = y + b_y;
+      for (int x = 0; x < 4; ++x)
+      {
+        if (!(piece[y] >> x & 1))
+          continue;
+        int grid_x = x + b_x;
+        if (grid_y < 0 || grid_y >= height || grid_x < 0 || grid_x >= width || occupied(grid_y, grid_x))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  void HugeGameBoard::set_cell(int y, int x, int value)
+  {
+    std::uint64_t *row = rows[y];
+    std::uint64_t bit = std::uint64_t(1) << (x & 63);
+    int word = x >> 6;
+    if (value)
+      top = std::min(top, y);
+    for (int plane = 0; plane < 4; ++plane)
+    {
+      // plane 0 is whether it's occupied at all, 1 to 3 are the bits of the color
+      bool on = plane == 0 ? value != 0 : (value >> (plane - 1) & 1);
+      if (on)
+        row[plane * words + word] |= bit;
+      else
+        row[plane * words + word] &= ~bit;
+    }
+  }
+
+  bool HugeGameBoard::row_full(int y) const
+  {
+    const std::uint64_t *row = rows[y];
+    for (int word = 0; word + 1 < words; ++word)
+    {
+      if (row[word] != ~std::uint64_t(0))
+        return false;
+    }
+    return row[words - 1] == last_word;
+  }
+
+  bool HugeGameBoard::row_empty(int y) const
+  {
+    const std::uint64_t *row = rows[y];
+    return std::all_of(row, row + words, [](std::uint64_t word)
+                       { return word == 0; });
+  }
+
+  void HugeGameBoard::shift_down()
+  {
+    clear_lines(0, height - 1);
+  }
+
+  void HugeGameBoard::clear_lines(int first, int last)
+  {
+    first = std::max(first, 0);
+    last = std::min(last, height - 1);
+
+    // bottom up, as they were before the shift, the same order as GameBoard::shift_down gives them
+    cleared_rows.clear();
+    for (int y = last; y >= first; --y)
+    {
+      if (row_full(y))
+        cleared_rows.push_back(y);
+    }
+
+    // the topmost first, so the ones below it are still where they were when it goes. its pointer
+    // goes to the top and everything above it moves down one, a few pointers instead of the cells
+    for (auto it = cleared_rows.rbegin(); it != cleared_rows.rend(); ++it)
+    {
+      std::rotate(rows.begin(), rows.begin() + *it, rows.begin() + *it + 1);
+      std::memset(rows[0], 0, sizeof(std::uint64_t) * 4 * words);
+    }
+
+    int linesCleared = static_cast<int>(cleared_rows.size());
+    // the full rows were all at the top or under it, so the top row came down at least that far
+    top = std::min(height, top + linesCleared);
+    lines_cleared += linesCleared;
+    score += (linesCleared * linesCleared) * 100;
+
+    if (linesCleared > 0 && rows_cleared_listener)
+      rows_cleared_listener(cleared_rows);
+
+    if (linesCleared > 0 && event_bus)
+    {
+      Event event;
+      event.type = EventType::LinesCleared;
+      event.count = static_cast<std::int16_t>(linesCleared);
+      for (int i = 0; i < linesCleared && i < static_cast<int>(event.rows.size()); ++i)
+        event.rows[i] = static_cast<std::int16_t>(cleared_rows[i]);
+      event.score = score;
+      event.lines = lines_cleared;
+      event_bus->publish(event);
+    }
+  }
+
+  bool HugeGameBoard::move_down()
+  {
+    ++b_y;
+
+    if (has_hit_pile())
+    {
+      --b_y;
+      for (int y = 0; y < 4; ++y)
+      {
+        int grid_row = b_y + y;
+        if (piece[y] == 0 || grid_row < 0 || grid_row >= height)
+          continue;
+
+        for (int x = 0; x < 4; ++x)
+        {
+          int grid_col = b_x + x;
+          if ((piece[y] >> x & 1) && grid_col >= 0 && grid_col < width)
+            set_cell(grid_row, grid_col, block);
+        }
+      }
+
+      ++pieces;
+      if (event_bus)
+        publish(EventType::PieceLocked);
+
+      // only the rows the piece went into can have filled up, and after that the rows the groups
+      // that fell landed in
+      clear_lines(b_y, b_y + 3);
+      while (cascade && !cleared_rows.empty() && settle())
+        clear_lines(landed_first, landed_last);
+      generate_new_piece();
+      return false;
+    }
+
+    if (event_bus)
+      publish(EventType::PieceMoved);
+    return true;
+  }
+
+  // same rotation as GameBoard::rotate, (y, x) goes to (3 - x, y)
+  void HugeGameBoard::rotate()
+  {
+    std::array<std::uint8_t, 4> rotated_block{};
+    for (int y = 0; y < 4; ++y)
+    {
+      for (int x = 0; x < 4; ++x)
+      {
+        if (piece[y] >> x & 1)
+          rotated_block[3 - x] |= 1 << y;
+      }
+    }
+    piece = rotated_block;
+    rotation = (rotation + 1) % 4;
+  }
+
+  // same moves as GameBoard::handle_input
+  void HugeGameBoard::handle_input(Input input)
+  {
+    switch (input)
+    {
+    case Input::Left:
+      --b_x;
+      if (!in_bounds())
+        ++b_x;
+      else if (event_bus)
+        publish(EventType::PieceMoved);
+      break;
+    case Input::Right:
+      ++b_x;
+      if (!in_bounds())
+        --b_x;
+      else if (event_bus)
+        publish(EventType::PieceMoved);
+      break;
+    case Input::Down:
+      move_down();
+      break;
+    case Input::Drop:
+      while (move_down())
+        ;
+      break;
+    case Input::Rotate:
+      rotate();
+      if (!in_bounds())
+      {
+        rotate();
+        rotate();
+        rotate();
+      }
+      else if (event_bus)
+        publish(EventType::PieceRotated);
+      break;
+    }
+  }
+
+  bool HugeGameBoard::is_game_over() const
+  {
+    for (int y = 0; y < 4; ++y)
+    {
+      for (int x = 0; x < 4; ++x)
+      {
+        if (!(piece[y] >> x & 1))
+          continue;
+        int world_y = b_y + y;
+        int world_x = b_x + x;
+        if (world_y < 0)
+          return true;
+        if (world_y < height && world_x >= 0 && world_x < width && occupied(world_y, world_x))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<std::vector<int>> HugeGameBoard::get_current_shape() const
+  {
+    std::vector<std::vector<int>> shape(4, std::vector<int>(4, 0));
+    for (int y = 0; y < 4; ++y)
+    {
+      for (int x = 0; x < 4; ++x)
+        shape[y][x] = piece[y] >> x & 1;
+    }
+    return shape;
+  }
+
+  bool HugeGameBoard::settle()
+  {
+    // the planner only reads the occupied plane, which is the first of a row's planes
+    if (!cascade_planner.plan(rows.data(), height, width, top, height - 1, cascade_moves))
+      return false;
+
+    // the runs go out of every plane before any goes back in, one can land where another one was
+    lifted.clear();
+    for (const CascadeMove &move : cascade_moves)
+    {
+      std::uint64_t *row = rows[move.y];
+      for (int plane = 0; plane < 4; ++plane)
+      {
+        for (int w = move.x >> 6; w <= (move.x + move.length - 1) >> 6; ++w)
+        {
+          std::uint64_t mask = span_mask(w, move.x, move.length);
+          lifted.push_back(row[plane * words + w] & mask);
+          row[plane * words + w] &= ~mask;
+        }
+      }
+    }
+    std::size_t next = 0;
+    landed_first = height;
+    landed_last = -1;
+    for (const CascadeMove &move : cascade_moves)
+    {
+      std::uint64_t *row = rows[move.y + move.drop];
+      for (int plane = 0; plane < 4; ++plane)
+      {
+        for (int w = move.x >> 6; w <= (move.x + move.length - 1) >> 6; ++w)
+          row[plane * words + w] |= lifted[next++];
+      }
+      landed_first = std::min(landed_first, move.y + move.drop);
+      landed_last = std::max(landed_last, move.y + move.drop);
+    }
+    return true;
+  }
+
+  std::size_t HugeGameBoard::bytes() const
+  {
+    return storage.size() * sizeof(std::uint64_t) + rows.size() * sizeof(std::uint64_t *);
+  }
+
+  void HugeGameBoard::publish(EventType type)
+  {
+    Event event;
+    event.type = type;
+    event.block = static_cast<std::uint8_t>(block);
+    event.x = static_cast<std::int16_t>(b_x);
+    event.y = static_cast<std::int16_t>(b_y);
+    event.score = score;
+    event.lines = lines_cleared;
+    event_bus->publish(event);
+  }
+
+}
@@ -0,0 +1,115 @@
+#ifndef HUGE_BOARD_HPP
+#define HUGE_BOARD_HPP
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "grid.hpp"
+#include "fixed_board.hpp"
+#include "cascade.hpp"
+
+namespace tetris
+{
+
+    // This is the board for the massive mode, sizes far past GameBoard's 50x50 (10,000 x 10,000
+    // is 100 million cells). It has the same interface as GameBoard and FixedGameBoard, but every
+    // row is a bitset: a plane of occupied bits and three planes for the color number, 64 columns
+    // a word, so 10,000 x 10,000 is 50 MB instead of the 400 MB of ints a Grid would be.
+    //  - a line is full when its occupied words are all ones, 64 columns checked an AND at a time,
+    //    and only the rows the locked piece touched can have become full, so only those are checked
+    //  - the board is a vector of row pointers, clearing a line rotates its pointer up to the top
+    //    (and empties that row) instead of copying every cell above it down a row
+    //  - in cascade mode the groups are found in the occupied plane as it is, from the top of the
+    //    pile down, so the empty rows above the pile cost nothing
+    class HugeGameBoard
+    {
+    public:
+        static constexpr int max_side = 20000; // events carry x and y in 16 bits
+
+        HugeGameBoard(int height, int width); // throws std::invalid_argument for sizes outside 5 to max_side
+        HugeGameBoard(HugeGameBoard &&) = default; // the rows point into storage, which a move keeps
+        HugeGameBoard(const HugeGameBoard &) = delete;
+        HugeGameBoard &operator=(const HugeGameBoard &) = delete;
+
+        int b_x = 0; // variable for falling piece's x pos
+        int b_y = 0; // variable for falling piece's y pos
+
+        void generate_new_piece();
+        void seed(unsigned value);
+        void reset();
+        bool in_bounds() const { return !has_hit_pile(); }
+        bool has_hit_pile() const;
+        void shift_down(); // clears every full line on the board, a lock only needs clear_lines
+        bool move_down();
+        void rotate();
+        void handle_input(Input input);
+        bool is_game_over() const;
+
+        int getHeight() const { return height; }
+        int getWidth() const { return width; }
+        int getBlock() const { return block; }
+        int getRotation() const { return rotation; }
+        int get_score() const { return score; }
+        int lines_cleared_count() const { return lines_cleared; }
+        int pieces_placed() const { return pieces; }
+
+        // the color number of a single cell, 0 is empty
+        int cell(int y, int x) const
+        {
+            const std::uint64_t *row = rows[y];
+            int word = x >> 6;
+            int bit = x & 63;
+            return static_cast<int>((row[words + word] >> bit & 1) | (row[2 * words + word] >> bit & 1) << 1 |
+                                    (row[3 * words + word] >> bit & 1) << 2);
+        }
+        void set_cell(int y, int x, int value);
+
+        bool row_full(int y) const;
+        bool row_empty(int y) const;
+
+        // the current piece as row masks, and the 4x4 vector version to match GameBoard
+        const std::array<std::uint8_t, 4> &piece_rows() const { return piece; }
+        std::vector<std::vector<int>> get_current_shape() const;
+
+        void set_event_bus(EventBus *bus) { event_bus = bus; }
+        void set_rows_cleared_listener(RowsClearedListener listener) { rows_cleared_listener = std::move(listener); }
+
+        std::size_t bytes() const; // what the rows take up
+
+        // the same cascade gravity as GameBoard::set_cascade, set it before the first piece
+        void set_cascade(bool on) { cascade = on; }
+        bool get_cascade() const { return cascade; }
+        bool settle(); // same as GameBoard::settle
+
+    private:
+        bool occupied(int y, int x) const { return rows[y][x >> 6] >> (x & 63) & 1; }
+        void clear_lines(int first, int last); // the full rows between first and last, inclusive
+        void publish(EventType type);
+
+        int height;
+        int width;
+        int words;                            // 64 bit words a plane of a row
+        std::uint64_t last_word;              // the bits of the last word that are on the board
+        std::vector<std::uint64_t> storage;   // every row, 4 planes of words each
+        std::vector<std::uint64_t *> rows;    // rows[y] is row y's planes somewhere in storage
+        int block = 1;                        // k_value for piece for shape_gen and color_gen
+        int rotation = 0;                     // quarter turns of the current piece
+        std::minstd_rand rng{unseeded_board_seed()}; // the pieces, same generator as GameBoard
+        std::array<std::uint8_t, 4> piece = shape_masks[1]; // the current_shape as row masks
+        int score = 0;
+        int lines_cleared = 0;
+        int pieces = 0;
+        std::vector<int> cleared_rows;        // the rows the last clear cleared
+        RowsClearedListener rows_cleared_listener;
+        EventBus *event_bus = nullptr;
+        int top;                              // no row above this one has anything in it
+        bool cascade = false;
+        CascadePlanner cascade_planner;
+        std::vector<CascadeMove> cascade_moves;
+        std::vector<std::uint64_t> lifted;    // the words of the falling runs, every plane
+        int landed_first = 0;                 // the rows the last settle put cells into
+        int landed_last = -1;
+    };
+
+}
+#endif // HUGE_BOARD_HPP
@@ -0,0 +1,388 @@
+#include "leaderboard.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tetris
+{
+
+  static_assert(sizeof(ScoreRecord) == 32, "ScoreRecord is written to disk as it is, it has to stay 32 bytes");
+
+  // the start of the log file, the same size as a record so the records after it stay aligned
+  struct Leaderboard::LogHeader
+  {
+    static constexpr std::uint32_t magic_value = 0x54534c47; // "TSLG"
+    static constexpr std::uint32_t current_version = 1;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint32_t unused;
+    std::uint64_t count; // records that have been added, the ones past it are garbage or not there
+    std::uint64_t unused2;
+  };
+
+  // the whole index file, it never changes size
+  struct Leaderboard::TopIndex
+  {
+    static constexpr std::uint32_t magic_value = 0x54535458; // "TSTX"
+    static constexpr std::uint32_t current_version = 2;
+
+    struct Board
+    {
+      std::uint16_t width;
+      std::uint16_t height;
+      std::uint32_t count;
+      std::uint32_t scores[top_k];  // best first, kept here so inserting never reads the log
+      std::uint64_t records[top_k]; // where each one is in the log
+    };
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t dirty;       // 1 while an add is changing it, still 1 on open means it has to be rebuilt
+    std::uint32_t board_count;
+    std::uint64_t covered;     // the log records before this one are in the index
+    std::uint32_t check;       // index_check of all of it, the pages can reach the disk in any order
+    std::uint32_t unused;
+    Board boards[max_boards];
+  };
+
+  namespace
+  {
+    // the log grows by this many records at a time, 2MB
+    const std::size_t grow_by = 1 << 16;
+
+    // the header is a record's size too
+    std::size_t log_bytes(std::size_t records)
+    {
+      return (records + 1) * sizeof(ScoreRecord);
+    }
+
+    // holds flock on the log while it's around, every process that uses the files goes through it
+    class FileLock
+    {
+    public:
+      explicit FileLock(int fd) : fd(fd) { flock(fd, LOCK_EX); }
+      ~FileLock() { flock(fd, LOCK_UN); }
+
+    private:
+      int fd;
+    };
+  }
+
+  namespace
+  {
+    // FNV-1a, it only has to notice when the pages of the index on disk aren't from the same moment
+    void mix(std::uint32_t &hash, const void *data, std::size_t size)
+    {
+      const unsigned char *bytes = static_cast<const unsigned char *>(data);
+      for (std::size_t i = 0; i < size; ++i)
+      {
+        hash = (hash ^ bytes[i]) * 16777619u;
+      }
+    }
+  }
+
+  std::uint32_t Leaderboard::index_check() const
+  {
+    // only what's in use, a board's unused places can be anything
+    std::uint32_t hash = 2166136261u;
+    mix(hash, &index->board_count, sizeof(index->board_count));
+    mix(hash, &index->covered, sizeof(index->covered));
+    for (std::uint32_t i = 0; i < index->board_count && i < max_boards; ++i)
+    {
+      const TopIndex::Board &board = index->boards[i];
+      std::uint32_t count = std::min<std::uint32_t>(board.count, top_k);
+      mix(hash, &board, offsetof(TopIndex::Board, scores));
+      mix(hash, board.scores, count * sizeof(board.scores[0]));
+      mix(hash, board.records, count * sizeof(board.records[0]));
+    }
+    return hash;
+  }
+
+  std::uint32_t record_check(const ScoreRecord &record)
+  {
+    // FNV-1a over everything before check
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&record);
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < offsetof(ScoreRecord, check); ++i)
+    {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+  }
+
+  Leaderboard::Leaderboard(const std::string &path) : path(path)
+  {
+    static_assert(sizeof(LogHeader) == sizeof(ScoreRecord), "the records after the header have to line up");
+
+    log_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (log_fd < 0)
+      throw std::runtime_error("Cannot open the score log " + path);
+
+    std::string index_path = path + ".top";
+    index_fd = open(index_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (index_fd < 0)
+    {
+      close(log_fd);
+      throw std::runtime_error("Cannot open the score index " + index_path);
+    }
+
+    try
+    {
+      FileLock lock(log_fd);
+
+      map_log(0);
+      if (log->magic == 0)
+      {
+        // a new file, ftruncate filled it with zeroes
+        log->magic = LogHeader::magic_value;
+        log->version = LogHeader::current_version;
+        log->record_size = sizeof(ScoreRecord);
+        log->count = 0;
+      }
+      else if (log->magic != LogHeader::magic_value || log->version != LogHeader::current_version ||
+               log->record_size != sizeof(ScoreRecord))
+      {
+        throw std::runtime_error(path + " is not a score log this version understands");
+      }
+
+      if (ftruncate(index_fd, sizeof(TopIndex)) != 0)
+        throw std::runtime_error("Cannot size the score index " + index_path);
+      void *memory = mmap(nullptr, sizeof(TopIndex), PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+      if (memory == MAP_FAILED)
+        throw std::runtime_error("Cannot map the score index " + index_path);
+      index = static_cast<TopIndex *>(memory);
+      if (index->magic != TopIndex::magic_value || index->version != TopIndex::current_version)
+      {
+        // new, or from another version, either way it can be made again from the log
+        index->magic = TopIndex::magic_value;
+        index->version = TopIndex::current_version;
+        index->dirty = 1;
+      }
+
+      // the log's count can be on disk when the records it counts aren't (a power cut at the wrong
+      // moment), those come off the end here. the index's pages can be from different moments too,
+      // which only its check can tell, and then it's made again from the log
+      while (log->count > 0 && records[log->count - 1].check != record_check(records[log->count - 1]))
+      {
+        --log->count;
+      }
+      if (index->check != index_check())
+        index->dirty = 1;
+      catch_up();
+    }
+    catch (...)
+    {
+      if (index)
+        munmap(index, sizeof(TopIndex));
+      if (log)
+        munmap(log, log_bytes(capacity));
+      close(index_fd);
+      close(log_fd);
+      throw;
+    }
+  }
+
+  Leaderboard::~Leaderboard()
+  {
+    munmap(index, sizeof(TopIndex));
+    munmap(log, log_bytes(capacity));
+    close(index_fd);
+    close(log_fd);
+  }
+
+  void Leaderboard::map_log(std::size_t wanted)
+  {
+    struct stat info;
+    if (fstat(log_fd, &info) != 0)
+      throw std::runtime_error("Cannot stat the score log " + path);
+
+    std::size_t on_disk = 0;
+    if (static_cast<std::size_t>(info.st_size) > sizeof(LogHeader))
+      on_disk = (info.st_size - sizeof(LogHeader)) / sizeof(ScoreRecord);
+    if (on_disk < wanted || info.st_size == 0)
+    {
+      // grows in big steps so this (and the remap) hardly ever happens, the new part is sparse
+      on_disk = std::max(wanted, on_disk) + grow_by;
+      if (ftruncate(log_fd, log_bytes(on_disk)) != 0)
+        throw std::runtime_error("Cannot grow the score log " + path);
+    }
+
+    // another process may have grown it too, then we only need to map more of it
+    if (log && on_disk == capacity)
+      return;
+    if (log)
+      munmap(log, log_bytes(capacity));
+    log = nullptr;
+    records = nullptr;
+    capacity = 0;
+
+    void *memory = mmap(nullptr, log_bytes(on_disk), PROT_READ | PROT_WRITE, MAP_SHARED, log_fd, 0);
+    if (memory == MAP_FAILED)
+      throw std::runtime_error("Cannot map the score log " + path);
+    log = static_cast<LogHeader *>(memory);
+    records = reinterpret_cast<ScoreRecord *>(log + 1);
+    capacity = on_disk;
+  }
+
+  void Leaderboard::catch_up()
+  {
+    map_log(0);
+
+    // a game that crashed after writing its record but before counting it, the record is fine
+    while (log->count < capacity && records[log->count].check == record_check(records[log->count]))
+    {
+      ++log->count;
+    }
+
+    // a crash in the middle of moving the index along, or an index that's ahead of the log
+    if (index->dirty || index->covered > log->count)
+    {
+      rebuild_index();
+      return;
+    }
+    if (index->covered == log->count)
+      return;
+    index->dirty = 1;
+    while (index->covered < log->count)
+    {
+      index_record(index->covered);
+      ++index->covered;
+    }
+    index->check = index_check();
+    index->dirty = 0;
+  }
+
+  void Leaderboard::rebuild_index()
+  {
+    index->dirty = 1;
+    index->board_count = 0;
+    std::memset(index->boards, 0, sizeof(index->boards));
+    for (std::uint64_t number = 0; number < log->count; ++number)
+    {
+      index_record(number);
+    }
+    index->covered = log->count;
+    index->check = index_check();
+    index->dirty = 0;
+  }
+
+  void Leaderboard::index_record(std::uint64_t number)
+  {
+    const ScoreRecord &record = records[number];
+
+    TopIndex::Board *board = nullptr;
+    for (std::uint32_t i = 0; i < index->board_count && !board; ++i)
+    {
+      if (index->boards[i].width == record.width && index->boards[i].height == record.height)
+        board = &index->boards[i];
+    }
+    if (!board)
+    {
+      // no room for another size, top() scans the log for these
+      if (index->board_count == max_boards)
+        return;
+      board = &index->boards[index->board_count++];
+      board->width = record.width;
+      board->height = record.height;
+      board->count = 0;
+    }
+
+    if (board->count == top_k && record.score <= board->scores[top_k - 1])
+      return;
+
+    // insertion from the bottom, a full list loses its last one. equal scores stay behind the
+    // older ones, which got there first
+    int at = std::min<int>(board->count, top_k - 1);
+    while (at > 0 && board->scores[at - 1] < record.score)
+    {
+      board->scores[at] = board->scores[at - 1];
+      board->records[at] = board->records[at - 1];
+      --at;
+    }
+    board->scores[at] = record.score;
+    board->records[at] = number;
+    if (board->count < top_k)
+      ++board->count;
+  }
+
+  void Leaderboard::add(ScoreRecord record)
+  {
+    record.check = record_check(record);
+
+    FileLock lock(log_fd);
+    catch_up();
+    if (log->count == capacity)
+      map_log(capacity + 1);
+
+    records[log->count] = record;
+    ++log->count;
+
+    index->dirty = 1;
+    index_record(log->count - 1);
+    index->covered = log->count;
+    index->check = index_check();
+    index->dirty = 0;
+  }
+
+  std::vector<ScoreRecord> Leaderboard::top(int width, int height, int n)
+  {
+    FileLock lock(log_fd);
+    catch_up();
+
+    std::vector<ScoreRecord> best;
+    if (n <= 0)
+      return best;
+
+    if (n <= top_k)
+    {
+      for (std::uint32_t i = 0; i < index->board_count; ++i)
+      {
+        const TopIndex::Board &board = index->boards[i];
+        if (board.width != width || board.height != height)
+          continue;
+        for (std::uint32_t k = 0; k < board.count && static_cast<int>(k) < n; ++k)
+        {
+          best.push_back(records[board.records[k]]);
+        }
+        return best;
+      }
+      if (index->board_count < max_boards)
+        return best; // the index has room, so nobody has played this size
+    }
+
+    // more than the index keeps, or a size it had no room for
+    for (std::uint64_t number = 0; number < log->count; ++number)
+    {
+      if (records[number].width == width && records[number].height == height)
+        best.push_back(records[number]);
+    }
+    std::stable_sort(best.begin(), best.end(), [](const ScoreRecord &a, const ScoreRecord &b)
+                     { return a.score > b.score; });
+    if (static_cast<int>(best.size()) > n)
+      best.resize(n);
+    return best;
+  }
+
+  std::uint64_t Leaderboard::size()
+  {
+    FileLock lock(log_fd);
+    catch_up();
+    return log->count;
+  }
+
+  void Leaderboard::flush()
+  {
+    FileLock lock(log_fd);
+    msync(log, log_bytes(capacity), MS_SYNC);
+    msync(index, sizeof(TopIndex), MS_SYNC);
+  }
+
+}
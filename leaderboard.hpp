@@ -0,0 +1,89 @@
+#ifndef LEADERBOARD_HPP
+#define LEADERBOARD_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris
+{
+
+    // One finished game, fixed size so the log is just an array of these
+    struct ScoreRecord
+    {
+        std::uint64_t timestamp = 0;   // unix seconds when the game ended
+        std::uint32_t score = 0;
+        std::uint32_t lines = 0;
+        std::uint32_t seed = 0;        // the seed the pieces came from
+        std::uint32_t duration_ms = 0;
+        std::uint16_t width = 0;
+        std::uint16_t height = 0;
+        std::uint32_t check = 0;       // a hash of the fields above, a record that doesn't match was never finished
+    };
+
+    // The high scores, kept in two files that are both memory mapped:
+    //
+    //   path        the log, a header and then every ScoreRecord ever added, only ever appended to
+    //   path.top    the index, the best top_k records of each board size (sorted, as record numbers)
+    //
+    // Adding a score copies it into the mapping and moves the index along, so the best scores of a
+    // board size are always there to read straight out of the index however long the log gets.
+    //
+    // Nothing gets fsync'd per game. Writes into a shared mapping are in the page cache the moment
+    // they're made, so a crashed game loses nothing that was already added, and the kernel writes the
+    // pages out on its own, in whatever order it likes. For a power cut the records carry a hash, so
+    // a half written one at the end gets dropped when the log is opened again, and the index carries a
+    // hash over everything in it, so an index whose pages on disk are from different moments is
+    // rebuilt from the log when it's opened (one that's only behind catches up). flush() is there for
+    // whoever wants it on disk now, tetris.exe calls it once after its games.
+    //
+    // Several processes can add to the same files, each add takes a lock on the log for a moment
+    class Leaderboard
+    {
+    public:
+        static constexpr int top_k = 100;     // how many scores the index keeps per board size
+        static constexpr int max_boards = 32; // board sizes the index has room for, others are found by a scan
+
+        // opens the files or creates them, throws std::runtime_error if it can't
+        explicit Leaderboard(const std::string &path);
+        ~Leaderboard();
+
+        Leaderboard(const Leaderboard &) = delete;
+        Leaderboard &operator=(const Leaderboard &) = delete;
+
+        // appends the game to the log and puts it in the index if it is good enough (fills in check)
+        void add(ScoreRecord record);
+
+        // the best n scores on a width x height board, best first (ties go to whoever got there first)
+        std::vector<ScoreRecord> top(int width, int height, int n);
+
+        // how many games the log has
+        std::uint64_t size();
+
+        // writes both files out to disk and waits for it
+        void flush();
+
+    private:
+        struct LogHeader;
+        struct TopIndex;
+
+        void map_log(std::size_t wanted); // maps the whole log, growing the file to wanted records first
+        void catch_up(); // sees what other processes (or a crash) did to the files since we last looked
+        void rebuild_index();
+        void index_record(std::uint64_t number);
+        std::uint32_t index_check() const;
+
+        std::string path;
+        int log_fd = -1;
+        int index_fd = -1;
+        LogHeader *log = nullptr;
+        ScoreRecord *records = nullptr;
+        std::size_t capacity = 0; // records the log mapping has room for
+        TopIndex *index = nullptr;
+    };
+
+    // the hash that goes in ScoreRecord::check
+    std::uint32_t record_check(const ScoreRecord &record);
+
+}
+#endif // LEADERBOARD_HPP
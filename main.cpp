@@ -1,7 +1,30 @@
 // Simple and Fast Multimedia Library
 #include <SFML/Graphics.hpp>
 #include "grid.hpp"
+#include "fixed_board.hpp"
+#include "simulation.hpp"
+#include "shared_state.hpp"
+#include "leaderboard.hpp"
+#include "bot.hpp"
+#include "replay.hpp"
+#include "undo.hpp"
+#include "huge_board.hpp"
+#include "autosave.hpp"
+#include "hint.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <memory>
 #include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 // Define world parameters
 const int CellSize = 20;
@@ -11,10 +34,9 @@ const int borderSize = 2;
 namespace
 {
 
-    void createWindowAndGame(sf::RenderWindow &window, tetris::GameBoard &game)
+    // asks for the difficulty on the terminal, false if stdin ran out before we got one
+    bool askDifficulty(int &height, int &width)
     {
-        sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
-
         // Define the ASCII art for each letter as vector of strings
         std::vector<std::string> tetrisArt = {
             " _______ ______ _______ _____  _____  _____  ",
@@ -32,59 +54,57 @@ namespace
         std::cout << "Welcome to tetris_cpp!" << std::endl;
         std::cout << "Please select your difficulty" << std::endl;
 
-        bool valid_conditions = false;
-
         std::string game_type;
 
-        int height;
-        int width;
-
-        do
+        for (;;)
         {
             std::cout << "Enter game type (E for easy, M for medium, H for hard): ";
-            std::cin >> game_type;
+            if (!(std::cin >> game_type))
+                return false;
 
-            if (game_type.size() >= 1)
+            switch (tolower(game_type[0]))
             {
-                char game_choice = tolower(game_type[0]);
+            case 'e':
+                width = 15;
+                height = 25;
+                return true;
+            case 'm':
+                width = 10;
+                height = 20;
+                return true;
+            case 'h':
+                width = 7;
+                height = 15;
+                return true;
+            default:
+                std::cout << "Invalid game type. Please enter E, M, or H.\n";
+            }
+        }
+    }
 
-                switch (game_choice)
-                {
-                case 'e':
-                    window.create(sf::VideoMode(15 * CellSize, 25 * CellSize), "Tetris");
+    // TETRIS_AUTOSAVE picks the file, like TETRIS_SCORES does for the scores
+    std::string autosavePath()
+    {
+        const char *path = std::getenv("TETRIS_AUTOSAVE");
+        return path ? path : "tetris_autosave.dat";
+    }
 
-                    width = 15;
-                    height = 25;
-                    valid_conditions = true;
-                    break;
-                case 'm':
-                    width = 10;
-                    height = 20;
-                    valid_conditions = true;
-                    break;
-                case 'h':
-                    window.create(sf::VideoMode(7 * CellSize, 15 * CellSize), "Tetris");
-                    width = 7;
-                    height = 15;
-                    valid_conditions = true;
-                    break;
-                default:
-                    std::cout << "Invalid game type. Please enter E, M, or H.\n";
-                    // Introduce a delay to avoid continuous looping and reduce lag
-                }
-            }
-            else
-            {
-                std::cout << "Invalid input. Please enter a valid game type.\n";
-                // Introduce a delay to avoid continuous looping and reduce lag
-            }
-        } while (!valid_conditions);
+    // when it's run bare and the last game never finished, false starts a new one (which saves over it)
+    bool askResume()
+    {
+        std::string answer;
+        std::cout << "Your last game wasn't finished, carry on with it? (y/n): ";
+        return std::cin >> answer && tolower(answer[0]) == 'y';
+    }
 
-        window.create(sf::VideoMode(width * CellSize, height * CellSize), "Tetris");
-        game = tetris::GameBoard(height, width);
+    // the window is only made once, after the board size is known
+    void createWindow(sf::RenderWindow &window, int pixelWidth, int pixelHeight)
+    {
+        sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
+        window.create(sf::VideoMode(pixelWidth, pixelHeight), "Tetris");
 
-        int windowPosX = (desktop.width - width * CellSize) / 2;
-        int windowPosY = (desktop.height - height * CellSize) / 2;
+        int windowPosX = (static_cast<int>(desktop.width) - pixelWidth) / 2;
+        int windowPosY = (static_cast<int>(desktop.height) - pixelHeight) / 2;
         window.setPosition(sf::Vector2i(windowPosX, windowPosY));
     }
 
@@ -113,121 +133,1006 @@ namespace
         window.draw(borderRect);
     }
 
-}
+    // The board clears lines instantly now, this plays the flash over the next few frames instead.
+    // It is just two states, Idle and Flashing, and the frame loop asks it to draw itself every
+    // frame, so input and gravity keep going while it plays
+    class LineClearAnimation
+    {
+    public:
+        // how long the flash lasts, the old sleep was 20ms a line so this is about a tetris
+        static constexpr float duration = 0.08f;
 
-int main()
-{
+        void start(const std::vector<int> &rows, float now)
+        {
+            flashing_rows = rows;
+            started = now;
+            state = State::Flashing;
+        }
+
+        void draw(sf::RenderWindow &window, int width, float now)
+        {
+            if (state == State::Idle)
+                return;
 
-    // a window that can render 2D drawings
-    sf::RenderWindow window;
+            float progress = (now - started) / duration;
+            if (progress >= 1.0f)
+            {
+                state = State::Idle;
+                return;
+            }
+
+            // white band over each cleared row that fades out
+            sf::RectangleShape band(sf::Vector2f(width * CellSize, CellSize));
+            band.setFillColor(sf::Color(255, 255, 255, static_cast<sf::Uint8>(255 * (1.0f - progress))));
+            for (int row : flashing_rows)
+            {
+                band.setPosition(0, row * CellSize);
+                window.draw(band);
+            }
+        }
+
+    private:
+        enum class State
+        {
+            Idle,
+            Flashing
+        };
 
-    // draw a cell in the world
-    sf::RectangleShape cell(sf::Vector2f(CellSize, CellSize));
+        State state = State::Idle;
+        std::vector<int> flashing_rows;
+        float started = 0.0f;
+    };
 
-    tetris::GameBoard game;
-    // populate a block
+    // taken while the program is being loaded, before main, it's what the startup time is measured from
+    const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
 
-    createWindowAndGame(window, game);
+    // the bot plays a move every 6 ticks (10 a second), at max speed too, so a seed plays the same
+    // game however fast it runs
+    const int botMoveTicks = 6;
 
-    game.generate_new_piece();
+    // every spectated game is a simulation thread of its own
+    const int maxSpectated = 1024;
 
-    bool gameOver = false;
-    sf::Clock clock;
+    // the game in the window is saved every 2 seconds, a kill loses that much at most
+    const int autosaveTicks = 2 * tetris::Simulation::ticks_per_second;
 
-    while (window.isOpen() && !gameOver)
+    struct Options
     {
+        int width = 0; // 0 until a size is picked, then we don't ask
+        int height = 0;
+        bool seedGiven = false;
+        unsigned seed = 0;
+        bool bot = false;
+        int games = 1;
+        bool headless = false;
+        bool maxSpeed = false;
+        bool json = false;
+        bool saveScores = true;
+        int spectate = 0; // how many bot games to tile in the window, 0 is a normal game
+        std::string record; // where the replays go, empty for none
+        bool practice = false; // placements can be taken back, and the scores aren't kept
+        bool huge = false;     // massive mode, a HugeGameBoard of up to 20000x20000 seen through a viewport
+        int maxPieces = 0;     // huge games end after this many pieces too, 0 is no limit
+        bool resume = false;   // the first game carries on from the autosave
+        bool autosave = true;  // games in the window are saved as they go, to pick up after a crash
+        bool hints = false;    // shows where the hint engine would put the piece (H hides it)
+        std::string pieces;    // a piece set file (pieces.hpp), empty for the seven
+        bool cascade = false;  // groups of blocks fall on their own after a clear (cascade.hpp)
+    };
 
-        // start clock
-        static float prev = clock.getElapsedTime().asSeconds();
-        if (clock.getElapsedTime().asSeconds() - prev >= 0.5)
+    struct GameResult
+    {
+        unsigned seed = 0;
+        int score = 0;
+        int lines = 0;
+        int pieces = 0;
+        long long ticks = 0;
+        double durationMs = 0;
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "usage: " << program << " [--board WxH | --difficulty e|m|h] [--seed N] [--policy human|bot]\n"
+                  << "       [--games N] [--headless] [--max-speed] [--json] [--no-scores] [--spectate N] [--record file]\n"
+                  << "       [--practice] [--huge [--max-pieces N]] [--resume] [--no-autosave] [--hints] [--pieces file]\n"
+                  << "       [--cascade]\n"
+                  << "with no options it asks for the difficulty and you play one game in a window.\n"
+                  << "--headless never opens a window (it needs --policy bot) and prints JSON, --max-speed runs\n"
+                  << "the ticks back to back instead of 60 a second, --no-scores keeps the games out of the high scores.\n"
+                  << "--spectate N tiles N bot games in one window, each one starts over when it ends, until it's closed.\n"
+                  << "--record saves a replay of the game for tetris_video.exe (file.2, file.3, ... for the games after the first)\n"
+                  << "--practice lets Z or Backspace take back pieces, as many as you like (the scores aren't kept)\n"
+                  << "--huge allows boards up to 20000x20000 for stress runs, the window shows the part around the piece\n"
+                  << "and the bot drops every piece where it spawns. --max-pieces ends those games early\n"
+                  << "games in the window are saved every 2 seconds (to tetris_autosave.dat or TETRIS_AUTOSAVE) until they end,\n"
+                  << "--resume carries on with the saved one and --no-autosave turns it off\n"
+                  << "--hints shows where the piece should go, it looks further ahead the longer the piece is in the air (H hides it)\n"
+                  << "--pieces deals the pieces drawn in the file instead of the seven (see pieces.hpp for how they're drawn),\n"
+                  << "those games aren't saved or kept in the high scores\n"
+                  << "--cascade lets every group of blocks a clear cuts loose fall on its own, and what it fills clears too\n"
+                  << "(also with --huge), those games aren't saved or kept in the high scores either"
+                  << std::endl;
+    }
+
+    bool parseOptions(int argc, char **argv, Options &options)
+    {
+        try
+        {
+            for (int i = 1; i < argc; ++i)
+            {
+                std::string option = argv[i];
+                bool hasValue = i + 1 < argc;
+                if (option == "--headless")
+                    options.headless = true;
+                else if (option == "--max-speed")
+                    options.maxSpeed = true;
+                else if (option == "--json")
+                    options.json = true;
+                else if (option == "--no-scores")
+                    options.saveScores = false;
+                else if (option == "--board" && hasValue)
+                {
+                    if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2)
+                        return false;
+                }
+                else if (option == "--difficulty" && hasValue)
+                {
+                    char difficulty = tolower(argv[++i][0]);
+                    if (difficulty == 'e')
+                        options.width = 15, options.height = 25;
+                    else if (difficulty == 'm')
+                        options.width = 10, options.height = 20;
+                    else if (difficulty == 'h')
+                        options.width = 7, options.height = 15;
+                    else
+                        return false;
+                }
+                else if (option == "--seed" && hasValue)
+                {
+                    options.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+                    options.seedGiven = true;
+                }
+                else if (option == "--policy" && hasValue)
+                {
+                    std::string policy = argv[++i];
+                    if (policy != "human" && policy != "bot")
+                        return false;
+                    options.bot = policy == "bot";
+                }
+                else if (option == "--games" && hasValue)
+                    options.games = std::stoi(argv[++i]);
+                else if (option == "--spectate" && hasValue)
+                    options.spectate = std::stoi(argv[++i]);
+                else if (option == "--record" && hasValue)
+                    options.record = argv[++i];
+                else if (option == "--practice")
+                    options.practice = true;
+                else if (option == "--huge")
+                    options.huge = true;
+                else if (option == "--max-pieces" && hasValue)
+                    options.maxPieces = std::stoi(argv[++i]);
+                else if (option == "--resume")
+                    options.resume = true;
+                else if (option == "--no-autosave")
+                    options.autosave = false;
+                else if (option == "--hints")
+                    options.hints = true;
+                else if (option == "--pieces" && hasValue)
+                    options.pieces = argv[++i];
+                else if (option == "--cascade")
+                    options.cascade = true;
+                else
+                    return false;
+            }
+        }
+        catch (const std::logic_error &)
         {
-            prev = clock.getElapsedTime().asSeconds();
-            game.move_down();
+            return false;
         }
 
-        // Define system event
-        sf::Event e;
+        const int maxSide = options.huge ? tetris::HugeGameBoard::max_side : 50;
+        if (options.width && (options.width < 5 || options.width > maxSide || options.height < 5 || options.height > maxSide))
+        {
+            std::cerr << "Boards go from 5x5 to " << maxSide << "x" << maxSide << (options.huge ? "" : " (or 20000x20000 with --huge)")
+                      << std::endl;
+            return false;
+        }
+        if (options.huge && (options.practice || options.spectate || !options.record.empty()))
+        {
+            std::cerr << "--huge doesn't go with --practice, --spectate or --record" << std::endl;
+            return false;
+        }
+        if (options.maxPieces < 0 || (options.maxPieces && !options.huge))
+        {
+            std::cerr << "--max-pieces is for --huge games" << std::endl;
+            return false;
+        }
+        if (options.headless && !options.bot)
+        {
+            std::cerr << "Nobody can play a headless game but the bot, add --policy bot" << std::endl;
+            return false;
+        }
+        if (options.spectate < 0 || options.spectate > maxSpectated || (options.spectate && options.headless))
+        {
+            std::cerr << "--spectate takes 1 to " << maxSpectated << " games, and needs the window" << std::endl;
+            return false;
+        }
+        if (options.practice && (options.spectate || !options.record.empty()))
+        {
+            std::cerr << "--practice is for one board in the window, and a replay can't have undos in it" << std::endl;
+            return false;
+        }
+        if (options.resume && (options.huge || options.spectate || !options.record.empty()))
+        {
+            std::cerr << "--resume is for a normal game, and a replay has to start from the beginning" << std::endl;
+            return false;
+        }
+        if (options.hints && (options.headless || options.spectate || options.huge))
+        {
+            std::cerr << "--hints is for a normal game in the window" << std::endl;
+            return false;
+        }
+        if (!options.pieces.empty() && (options.huge || options.spectate || !options.record.empty() || options.resume || options.hints))
+        {
+            std::cerr << "--pieces doesn't go with --huge, --spectate, --record, --resume or --hints" << std::endl;
+            return false;
+        }
+        if (options.cascade && (options.spectate || !options.record.empty() || options.resume || options.hints))
+        {
+            std::cerr << "--cascade doesn't go with --spectate, --record, --resume or --hints" << std::endl;
+            return false;
+        }
+        if (options.spectate)
+            options.bot = true;
+        if (options.headless || options.spectate || options.huge || !options.pieces.empty() || options.cascade)
+            options.autosave = false;
+        if (options.practice || options.huge || !options.pieces.empty() || options.cascade)
+            options.saveScores = false;
+        if (options.headless)
+            options.json = true;
+        return options.games >= 1;
+    }
+
+    // adds the finished games to the high scores (TETRIS_SCORES picks the file) and can show the
+    // best ones for this board size
+    void recordScores(const std::vector<GameResult> &results, int height, int width, bool showBest)
+    {
+        const char *path = std::getenv("TETRIS_SCORES");
+        try
+        {
+            tetris::Leaderboard leaderboard(path ? path : "tetris_scores.dat");
+
+            for (const GameResult &result : results)
+            {
+                tetris::ScoreRecord record;
+                record.timestamp = static_cast<std::uint64_t>(std::time(nullptr));
+                record.score = result.score;
+                record.lines = result.lines;
+                record.seed = result.seed;
+                record.duration_ms = static_cast<std::uint32_t>(result.durationMs);
+                record.width = width;
+                record.height = height;
+                leaderboard.add(record);
+            }
+            leaderboard.flush();
+
+            if (!showBest)
+                return;
+            std::cout << "High scores on " << width << "x" << height << ":" << std::endl;
+            int place = 1;
+            for (const tetris::ScoreRecord &best : leaderboard.top(width, height, 5))
+            {
+                std::cout << "  " << place++ << ". " << best.score << " (" << best.lines << " lines)" << std::endl;
+            }
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << ", the score wasn't saved" << std::endl;
+        }
+    }
+
+    void printJson(const Options &options, const std::vector<GameResult> &results, double startupMs, double totalMs)
+    {
+        std::printf("{\"board\": {\"width\": %d, \"height\": %d}, \"policy\": \"%s\", \"headless\": %s, \"max_speed\": %s,\n",
+                    options.width, options.height, options.bot ? "bot" : "human", options.headless ? "true" : "false",
+                    options.maxSpeed ? "true" : "false");
+        std::printf(" \"startup_ms\": %.3f, \"total_ms\": %.3f, \"games\": [", startupMs, totalMs);
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const GameResult &r = results[i];
+            std::printf("%s\n  {\"seed\": %u, \"score\": %d, \"lines\": %d, \"pieces\": %d, \"ticks\": %lld, \"duration_ms\": %.3f}",
+                        i ? "," : "", r.seed, r.score, r.lines, r.pieces, r.ticks, r.durationMs);
+        }
+        std::printf("]}\n");
+    }
+
+    // after a game in the window: one that ended has nothing to carry on with, one that was closed
+    // is saved as it is now (the autosave can be up to 2 seconds behind)
+    // the piece set and cascade gravity are a GameBoard's, the games that have them never get another board
+    void setUpRules(tetris::GameBoard &board, const tetris::PieceSet *pieceSet, bool cascade)
+    {
+        if (pieceSet)
+            board.set_piece_set(*pieceSet);
+        board.set_cascade(cascade);
+    }
+
+    template <typename Board>
+    void setUpRules(Board &, const tetris::PieceSet *, bool)
+    {
+    }
+
+    template <typename Board>
+    void finishAutosave(Board &board, unsigned seed, long long tick)
+    {
+        std::string path = autosavePath();
+        if (board.is_game_over())
+        {
+            std::remove(path.c_str());
+            return;
+        }
+
+        tetris::SaveGame save;
+        save.width = board.getWidth();
+        save.height = board.getHeight();
+        save.seed = seed;
+        save.tick = tick;
+        board.save_state(save.board);
+        try
+        {
+            tetris::write_save_file(path, save);
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    // draws frames from the simulation's snapshots until the game ends, key presses go to it as inputs.
+    // hints (if there's an engine) is only ever read here, the newest one it has each frame
+    template <typename Board>
+    void playInWindow(sf::RenderWindow &window, tetris::BasicSimulation<Board> &simulation, int width, tetris::HintEngine *hints)
+    {
+        bool gameOver = false;
+        bool showHints = true;
+        sf::Clock clock;
 
-        // polling event (eg. key pressed)
-        while (window.pollEvent(e))
+        // the simulation counts its clears in the snapshot, and the animation plays over the next frames
+        LineClearAnimation lineClear;
+        int seenClears = 0;
+
+        while (window.isOpen() && !gameOver)
         {
-            // close window
-            if (e.type == sf::Event::Closed)
-                window.close();
+            // Define system event
+            sf::Event e;
+
+            // polling event (eg. key pressed)
+            while (window.pollEvent(e))
+            {
+                // close window
+                if (e.type == sf::Event::Closed)
+                    window.close();
+
+                // keyboard interrupt
+                if (e.type == sf::Event::KeyReleased)
+                {
+                    if (e.key.code == sf::Keyboard::Left or e.key.code == sf::Keyboard::A)
+                    {
+                        simulation.push_input(tetris::Input::Left);
+                    }
+                    else if (e.key.code == sf::Keyboard::Right or e.key.code == sf::Keyboard::D)
+                    {
+                        simulation.push_input(tetris::Input::Right);
+                    }
+                    else if (e.key.code == sf::Keyboard::Down or e.key.code == sf::Keyboard::S)
+                    {
+                        simulation.push_input(tetris::Input::Down);
+                    }
+                    else if (e.key.code == sf::Keyboard::Space)
+                    {
+                        // fall down until reaches the bottom
+                        simulation.push_input(tetris::Input::Drop);
+                    }
+                    else if (e.key.code == sf::Keyboard::Up or e.key.code == sf::Keyboard::W)
+                    {
+                        simulation.push_input(tetris::Input::Rotate);
+                    }
+                    else if (e.key.code == sf::Keyboard::Z or e.key.code == sf::Keyboard::BackSpace)
+                    {
+                        // only does something in practice mode, when the simulation has an undo history
+                        simulation.request_undo();
+                    }
+                    else if (e.key.code == sf::Keyboard::H)
+                    {
+                        showHints = !showHints;
+                    }
+                }
+            }
+
+            // take the newest finished tick, if there isn't one the last one gets drawn again
+            simulation.update_snapshot();
+            const tetris::BoardSnapshot &snap = simulation.snapshot();
+
+            if (snap.clear_count != seenClears)
+            {
+                seenClears = snap.clear_count;
+                lineClear.start(snap.cleared_rows, clock.getElapsedTime().asSeconds());
+            }
 
-            // keyboard interrupt
-            if (e.type == sf::Event::KeyReleased)
+            // clear window every frame
+            window.clear();
+            for (int y = 0; y < static_cast<int>(snap.grid.size()); ++y)
             {
-                if (e.key.code == sf::Keyboard::Left or e.key.code == sf::Keyboard::A)
+                for (int x = 0; x < static_cast<int>(snap.grid[y].size()); ++x)
                 {
-                    --game.b_x;
-                    if (!game.in_bounds())
-                        ++game.b_x;
+                    int cellValue = snap.grid[y][x];
+                    if (cellValue)
+                    {
+                        drawCellWithBorder(window, x, y, tetris::palette(cellValue));
+                    }
                 }
-                else if (e.key.code == sf::Keyboard::Right or e.key.code == sf::Keyboard::D)
+            }
+
+            // the hint is a faded copy of the piece where it should land, under the piece itself. one
+            // for an earlier piece is left alone until the engine catches up
+            if (hints)
+                hints->update();
+            if (hints && showHints && hints->hint().found && hints->hint().pieces == snap.pieces)
+            {
+                const tetris::Hint &hint = hints->hint();
+                sf::Color faded = tetris::palette(snap.block);
+                faded.a = 80;
+                sf::RectangleShape ghost(sf::Vector2f(CellSize - 2 * borderSize, CellSize - 2 * borderSize));
+                ghost.setFillColor(faded);
+                for (int i = 0; i < hint.cell_count; ++i)
                 {
-                    ++game.b_x;
-                    if (game.in_bounds() == false)
-                        --game.b_x;
+                    ghost.setPosition(hint.cells_x[i] * CellSize + borderSize, hint.cells_y[i] * CellSize + borderSize);
+                    window.draw(ghost);
                 }
-                else if (e.key.code == sf::Keyboard::Down or e.key.code == sf::Keyboard::S)
+            }
+
+            int box = snap.shape.size;
+            for (int y = 0; y < box; ++y)
+            {
+                for (int x = 0; x < box; ++x)
                 {
-                    game.move_down();
+                    if (snap.shape.has(y, x))
+                    {
+                        int drawX = snap.b_x + x;
+                        int drawY = snap.b_y + y;
+                        drawCellWithBorder(window, drawX, drawY, tetris::palette(snap.block));
+                    }
                 }
-                else if (e.key.code == sf::Keyboard::Space)
+            }
+            lineClear.draw(window, width, clock.getElapsedTime().asSeconds());
+
+            // display rendered object on screen
+            window.display();
+
+            gameOver = snap.game_over;
+        }
+    }
+
+    // how the spectated boards are laid out, a grid of tiles with a cell's gap between them
+    struct TileLayout
+    {
+        int columns = 1;
+        int rows = 1;
+        int cell = CellSize; // pixels, CellSize unless that doesn't fit on the screen
+        int inset = borderSize; // the black border around each block, scaled down with the cell
+    };
+
+    // tries every number of columns and keeps the one with the biggest cells that fit in most of the screen
+    TileLayout layoutTiles(int count, int height, int width)
+    {
+        sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
+        int maxWidth = desktop.width * 9 / 10;
+        int maxHeight = desktop.height * 9 / 10;
+
+        TileLayout best;
+        best.cell = 0;
+        for (int columns = 1; columns <= count; ++columns)
+        {
+            int rows = (count + columns - 1) / columns;
+            int cell = std::min({CellSize, maxWidth / (columns * (width + 1)), maxHeight / (rows * (height + 1))});
+            if (cell > best.cell)
+            {
+                best.columns = columns;
+                best.rows = rows;
+                best.cell = cell;
+            }
+        }
+        best.cell = std::max(1, best.cell);
+        best.inset = best.cell >= 5 ? std::max(1, borderSize * best.cell / CellSize) : 0;
+        return best;
+    }
+
+    void addQuad(sf::VertexArray &quads, float x, float y, float size_x, float size_y, const sf::Color &color)
+    {
+        quads.append(sf::Vertex(sf::Vector2f(x, y), color));
+        quads.append(sf::Vertex(sf::Vector2f(x + size_x, y), color));
+        quads.append(sf::Vertex(sf::Vector2f(x + size_x, y + size_y), color));
+        quads.append(sf::Vertex(sf::Vector2f(x, y + size_y), color));
+    }
+
+    // one board of the spectator window, it starts over with a new seed whenever it ends
+    struct SpectatedGame
+    {
+        SpectatedGame(int height, int width) : board(height, width), bot(height, width) {}
+
+        tetris::GameBoard board;
+        tetris::Bot bot;
+        std::unique_ptr<tetris::Simulation> simulation;
+        unsigned seed = 0;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    void startSpectated(SpectatedGame &game, unsigned seed, bool maxSpeed)
+    {
+        // the old simulation has to be stopped before the board can be touched
+        game.simulation.reset();
+        game.board.reset();
+        game.board.seed(seed);
+        game.board.generate_new_piece();
+        game.bot.reset();
+        game.seed = seed;
+        game.started = std::chrono::steady_clock::now();
+
+        game.simulation.reset(new tetris::Simulation(game.board));
+        game.simulation->set_max_speed(maxSpeed);
+        game.simulation->set_bot(&game.bot, botMoveTicks);
+        game.simulation->start();
+    }
+
+    // Tiles options.spectate bot games in the window until it's closed, and returns every game that
+    // finished. Each game runs on its own simulation thread and the frames are drawn from their
+    // snapshots, which the triple buffers hand over without a lock. Drawing a block the way
+    // drawCellWithBorder does is five draw calls, hundreds of boards of them would be millions a
+    // frame, so here every board goes into one vertex array of quads (a block is a quad inset from
+    // the black background, which makes the same border) and the frame is a single draw call
+    std::vector<GameResult> spectateInWindow(sf::RenderWindow &window, const Options &options, const TileLayout &layout)
+    {
+        int count = options.spectate;
+        std::vector<std::unique_ptr<SpectatedGame>> games;
+        for (int i = 0; i < count; ++i)
+        {
+            games.emplace_back(new SpectatedGame(options.height, options.width));
+            startSpectated(*games.back(), options.seed + i, options.maxSpeed);
+        }
+        unsigned nextSeed = options.seed + count;
+
+        // the frames are all about the same, after the first one appending doesn't allocate
+        sf::VertexArray quads(sf::Quads);
+        const sf::Color boardColor(24, 24, 24);
+        const int cell = layout.cell;
+        const int inset = layout.inset;
+        std::vector<GameResult> results;
+        window.setFramerateLimit(60);
+
+        while (window.isOpen())
+        {
+            sf::Event e;
+            while (window.pollEvent(e))
+            {
+                if (e.type == sf::Event::Closed ||
+                    (e.type == sf::Event::KeyReleased && e.key.code == sf::Keyboard::Escape))
+                    window.close();
+            }
+
+            quads.clear();
+            for (int i = 0; i < count; ++i)
+            {
+                tetris::Simulation &simulation = *games[i]->simulation;
+                simulation.update_snapshot();
+                const tetris::BoardSnapshot &snap = simulation.snapshot();
+
+                float left = static_cast<float>((i % layout.columns) * (options.width + 1) * cell + cell / 2);
+                float top = static_cast<float>((i / layout.columns) * (options.height + 1) * cell + cell / 2);
+                addQuad(quads, left, top, options.width * cell, options.height * cell, boardColor);
+
+                for (int y = 0; y < options.height; ++y)
                 {
-                    // fall down until reaches the bottom
-                    while (game.move_down() == true);
+                    const std::vector<int> &row = snap.grid[y];
+                    for (int x = 0; x < options.width; ++x)
+                    {
+                        if (row[x])
+                            addQuad(quads, left + x * cell + inset, top + y * cell + inset, cell - 2 * inset,
+                                    cell - 2 * inset, tetris::palette(row[x]));
+                    }
                 }
-                else if (e.key.code == sf::Keyboard::Up or e.key.code == sf::Keyboard::W)
+                int box = snap.shape.size;
+                for (int y = 0; y < box; ++y)
                 {
-                    game.rotate();
-
-                    // if rotation hits boundary, do not allow to rotate
-                    if (!game.in_bounds())
+                    for (int x = 0; x < box; ++x)
                     {
-                        game.rotate();
-                        game.rotate();
-                        game.rotate();
+                        int drawX = snap.b_x + x;
+                        int drawY = snap.b_y + y;
+                        if (snap.shape.has(y, x) && drawX >= 0 && drawX < options.width && drawY >= 0 && drawY < options.height)
+                            addQuad(quads, left + drawX * cell + inset, top + drawY * cell + inset, cell - 2 * inset,
+                                    cell - 2 * inset, tetris::palette(snap.block));
                     }
                 }
             }
+
+            window.clear();
+            window.draw(quads);
+            window.display();
+
+            // a game that has ended is taken down and the next seed takes its tile
+            for (std::unique_ptr<SpectatedGame> &game : games)
+            {
+                if (game->simulation->is_running())
+                    continue;
+                game->simulation->stop();
+
+                GameResult result;
+                result.seed = game->seed;
+                result.score = game->board.get_score();
+                result.lines = game->board.lines_cleared_count();
+                result.pieces = game->board.pieces_placed();
+                result.ticks = game->simulation->ticks_run();
+                result.durationMs =
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - game->started).count();
+                results.push_back(result);
+                startSpectated(*game, nextSeed++, options.maxSpeed);
+            }
         }
+        return results;
+    }
 
-        // clear window every frame
-        window.clear();
-        for (int y = 0; y < game.getHeight(); ++y)
+    // Plays one massive mode game on this thread, a tick at a time like the simulation does. The
+    // board can be far bigger than any screen (and copying it into a snapshot every tick is out of
+    // the question), so the window is a viewport: it follows the falling piece and only the cells
+    // inside it are read and drawn, all in one vertex array, whatever the size of the board
+    GameResult playHuge(const Options &options, unsigned seed, sf::RenderWindow *window, int viewWidth, int viewHeight)
+    {
+        GameResult result;
+        result.seed = seed;
+        tetris::HugeGameBoard board(options.height, options.width);
+        board.set_cascade(options.cascade);
+        board.seed(seed);
+        board.generate_new_piece();
+        std::minstd_rand botTurns(seed);
+
+        using clock = std::chrono::steady_clock;
+        const auto period = std::chrono::nanoseconds(1000000000LL / tetris::Simulation::ticks_per_second);
+        auto started = clock::now();
+        auto nextTick = started + period;
+        sf::VertexArray quads(sf::Quads);
+        const int inset = borderSize;
+        long long tick = 0;
+
+        while (!board.is_game_over() && (!options.maxPieces || board.pieces_placed() < options.maxPieces))
         {
-            for (int x = 0; x < game.getWidth(); ++x)
+            if (window)
+            {
+                sf::Event e;
+                while (window->pollEvent(e))
+                {
+                    if (e.type == sf::Event::Closed)
+                        window->close();
+                    if (e.type != sf::Event::KeyReleased || options.bot)
+                        continue;
+                    if (e.key.code == sf::Keyboard::Left or e.key.code == sf::Keyboard::A)
+                        board.handle_input(tetris::Input::Left);
+                    else if (e.key.code == sf::Keyboard::Right or e.key.code == sf::Keyboard::D)
+                        board.handle_input(tetris::Input::Right);
+                    else if (e.key.code == sf::Keyboard::Down or e.key.code == sf::Keyboard::S)
+                        board.handle_input(tetris::Input::Down);
+                    else if (e.key.code == sf::Keyboard::Space)
+                        board.handle_input(tetris::Input::Drop);
+                    else if (e.key.code == sf::Keyboard::Up or e.key.code == sf::Keyboard::W)
+                        board.handle_input(tetris::Input::Rotate);
+                }
+                if (!window->isOpen())
+                    break;
+            }
+
+            // the bot can't look ahead on a board this size, it turns the piece a random way and drops it
+            if (options.bot && tick % botMoveTicks == 0)
             {
-                int cellValue = game.getGameState()[y][x];
-                if (cellValue)
+                for (int turns = botTurns() % 4; turns > 0; --turns)
+                    board.handle_input(tetris::Input::Rotate);
+                board.handle_input(tetris::Input::Drop);
+            }
+            ++tick;
+            if (tetris::Simulation::gravity_due(tick, tetris::Simulation::ticks_per_second))
+                board.move_down();
+
+            if (window)
+            {
+                // the piece in the middle of the view, unless that would show past the edge of the board
+                int left = std::max(0, std::min(board.b_x + 2 - viewWidth / 2, options.width - viewWidth));
+                int top = std::max(0, std::min(board.b_y + 2 - viewHeight / 2, options.height - viewHeight));
+
+                quads.clear();
+                for (int y = 0; y < viewHeight; ++y)
+                {
+                    for (int x = 0; x < viewWidth; ++x)
+                    {
+                        int value = board.cell(top + y, left + x);
+                        if (value)
+                            addQuad(quads, x * CellSize + inset, y * CellSize + inset, CellSize - 2 * inset,
+                                    CellSize - 2 * inset, tetris::palette(value));
+                    }
+                }
+                const std::array<std::uint8_t, 4> &piece = board.piece_rows();
+                for (int y = 0; y < 4; ++y)
                 {
-                    drawCellWithBorder(window, x, y, tetris::colors.at(cellValue));
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        int drawX = board.b_x + x - left;
+                        int drawY = board.b_y + y - top;
+                        if ((piece[y] >> x & 1) && drawX >= 0 && drawX < viewWidth && drawY >= 0 && drawY < viewHeight)
+                            addQuad(quads, drawX * CellSize + inset, drawY * CellSize + inset, CellSize - 2 * inset,
+                                    CellSize - 2 * inset, tetris::palette(board.getBlock()));
+                    }
                 }
+                window->clear();
+                window->draw(quads);
+                window->display();
+            }
+
+            if (!options.maxSpeed)
+            {
+                std::this_thread::sleep_until(nextTick);
+                nextTick += period;
             }
         }
 
-        for (int y = 0; y < 4; ++y)
+        result.score = board.get_score();
+        result.lines = board.lines_cleared_count();
+        result.pieces = board.pieces_placed();
+        result.ticks = tick;
+        result.durationMs = std::chrono::duration<double, std::milli>(clock::now() - started).count();
+        if (!options.json)
+            std::cout << "The board took " << board.bytes() / (1024 * 1024) << " MB" << std::endl;
+        return result;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // the saves, replays and everything else written down only know the seven, so other pieces are
+    // only for playing
+    std::unique_ptr<tetris::PieceSet> pieceSet;
+    if (!options.pieces.empty())
+    {
+        try
+        {
+            pieceSet.reset(new tetris::PieceSet(tetris::PieceSet::load(options.pieces)));
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    // a game that was closed or killed before it ended can be picked up again, the save has the size
+    // and the seed in it
+    tetris::SaveGame saved;
+    bool resuming = options.resume || (argc == 1 && std::ifstream(autosavePath()) && askResume());
+    auto resumeStart = std::chrono::steady_clock::now();
+    if (resuming)
+    {
+        try
+        {
+            saved = tetris::read_save_file(autosavePath());
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        options.width = saved.width;
+        options.height = saved.height;
+        options.seed = saved.seed;
+        options.seedGiven = true;
+    }
+
+    // only asks when it's run bare, with options (a script) the board is medium unless it says otherwise
+    if (!options.width && argc > 1)
+        options.width = 10, options.height = 20;
+    if (!options.width && !askDifficulty(options.height, options.width))
+        return 1;
+    if (!options.seedGiven)
+        options.seed = std::random_device{}();
+
+    // a window that can render 2D drawings, headless runs never make one
+    std::unique_ptr<sf::RenderWindow> window;
+    TileLayout layout;
+    int viewWidth = options.width;
+    int viewHeight = options.height;
+    if (options.huge && !options.headless)
+    {
+        // as much of the board as fits on most of the screen
+        sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
+        viewWidth = std::max(5, std::min<int>(options.width, desktop.width * 9 / 10 / CellSize));
+        viewHeight = std::max(5, std::min<int>(options.height, desktop.height * 9 / 10 / CellSize));
+        window.reset(new sf::RenderWindow());
+        createWindow(*window, viewWidth * CellSize, viewHeight * CellSize);
+    }
+    else if (options.spectate)
+    {
+        layout = layoutTiles(options.spectate, options.height, options.width);
+        window.reset(new sf::RenderWindow());
+        createWindow(*window, layout.columns * (options.width + 1) * layout.cell,
+                     layout.rows * (options.height + 1) * layout.cell);
+    }
+    else if (!options.headless)
+    {
+        window.reset(new sf::RenderWindow());
+        createWindow(*window, options.width * CellSize, options.height * CellSize);
+    }
+
+    // TETRIS_SHM=/tetris makes the game publish its state for tetris_shm_reader.exe and the overlays
+    std::unique_ptr<tetris::SharedStatePublisher> sharedState;
+    if (const char *shmName = std::getenv("TETRIS_SHM"))
+    {
+        try
+        {
+            sharedState.reset(new tetris::SharedStatePublisher(shmName));
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << ", playing without it" << std::endl;
+        }
+    }
+
+    // the bot plays on a GameBoard of its own, the massive mode has its own player
+    std::unique_ptr<tetris::Bot> bot;
+    if (!options.huge)
+        bot.reset(new tetris::Bot(options.height, options.width));
+    std::vector<GameResult> results;
+    double startupMs = 0;
+    auto started = std::chrono::steady_clock::now();
+
+    if (options.spectate)
+    {
+        results = spectateInWindow(*window, options, layout);
+        if (!options.json)
+            std::cout << results.size() << " game(s) finished while you watched" << std::endl;
+    }
+
+    for (int game = 0; options.huge && game < options.games && (!window || window->isOpen()); ++game)
+    {
+        GameResult result = playHuge(options, options.seed + game, window.get(), viewWidth, viewHeight);
+        results.push_back(result);
+        if (!options.json)
+            std::cout << "Your Score was " << result.score << std::endl;
+    }
+
+    // the difficulty sizes play on a FixedGameBoard (with_game_board picks it), unless the game needs
+    // what only a GameBoard has: a piece set, cascade gravity or an undo history
+    bool fixedBoard = !pieceSet && !options.cascade && !options.practice;
+    for (int game = 0; !options.spectate && !options.huge && game < options.games && (!window || window->isOpen()); ++game)
+    {
+        // every game has its own seed, and it goes in the results so a good game can be played again
+        GameResult result;
+        result.seed = options.seed + game;
+
+        auto play = [&](auto &board)
         {
-            for (int x = 0; x < 4; ++x)
+            if (game == 0 && resuming)
+            {
+                board.load_state(saved.board);
+                if (!options.json)
+                    std::cout << "Picked up the saved game in "
+                              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - resumeStart).count()
+                              << " ms" << std::endl;
+            }
+            else
+            {
+                setUpRules(board, pieceSet.get(), options.cascade);
+                board.seed(result.seed);
+                board.generate_new_piece();
+            }
+            bot->reset();
+
+            // the board runs on its own thread from here on, this thread only handles the window:
+            // key presses go to the simulation as inputs and frames are drawn from its snapshots
+            tetris::BasicSimulation<std::decay_t<decltype(board)>> simulation(board);
+            simulation.set_shared_state(sharedState.get());
+            simulation.set_max_speed(options.maxSpeed);
+            if (options.bot)
+                simulation.set_bot(bot.get(), botMoveTicks);
+            tetris::Replay replay;
+            replay.width = options.width;
+            replay.height = options.height;
+            replay.seed = result.seed;
+            replay.tick_rate = tetris::Simulation::ticks_per_second;
+            if (!options.record.empty())
+                simulation.set_replay(&replay);
+            tetris::UndoHistory undoHistory(options.height, options.width);
+            if (options.practice)
+                simulation.set_undo_history(&undoHistory);
+            if (game == 0 && resuming)
+                simulation.set_first_tick(saved.tick);
+            std::unique_ptr<tetris::HintEngine> hints;
+            if (options.hints)
+            {
+                hints.reset(new tetris::HintEngine(options.height, options.width));
+                simulation.set_hint_engine(hints.get());
+            }
+            std::unique_ptr<tetris::AutosaveWriter> autosave;
+            if (options.autosave)
+            {
+                autosave.reset(new tetris::AutosaveWriter(autosavePath()));
+                simulation.set_autosave(autosave.get(), autosaveTicks, result.seed);
+            }
+
+            auto gameStart = std::chrono::steady_clock::now();
+            simulation.start();
+            if (window)
+                playInWindow(*window, simulation, options.width, hints.get());
+            else
+                simulation.wait();
+
+            // the board is ours again once the simulation thread has stopped, and the writer is done
+            // with the file once it's gone
+            simulation.stop();
+            if (autosave)
             {
-                if (game.get_current_shape()[y][x])
+                autosave.reset();
+                finishAutosave(board, result.seed, simulation.ticks_run());
+            }
+            if (game == 0)
+                startupMs = std::chrono::duration<double, std::milli>(simulation.first_tick_time() - processStart).count();
+
+            result.score = board.get_score();
+            result.lines = board.lines_cleared_count();
+            result.pieces = board.pieces_placed();
+            result.ticks = simulation.ticks_run();
+            result.durationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gameStart).count();
+            results.push_back(result);
+
+            if (!options.record.empty())
+            {
+                replay.ticks = result.ticks;
+                replay.score = result.score;
+                replay.lines = result.lines;
+                std::string path = game == 0 ? options.record : options.record + "." + std::to_string(game + 1);
+                try
+                {
+                    replay.save(path);
+                }
+                catch (const std::runtime_error &e)
                 {
-                    int drawX = game.b_x + x;
-                    int drawY = game.b_y + y;
-                    drawCellWithBorder(window, drawX, drawY, tetris::colors.at(game.getBlock()));
+                    std::cerr << e.what() << std::endl;
                 }
             }
-        }
-        // display rendered object on screen
-        window.display();
 
-        gameOver = game.is_game_over();
+            if (!options.json)
+            {
+                std::cout << "Your Score was " << result.score << std::endl;
+                std::cout << "You cleared " << result.lines << " line(s)" << std::endl;
+                if (options.practice)
+                    std::cout << "Undo kept " << undoHistory.steps() << " placement(s) in " << undoHistory.bytes() << " bytes" << std::endl;
+            }
+        };
+        if (fixedBoard)
+        {
+            tetris::with_game_board(options.height, options.width, play);
+        }
+        else
+        {
+            tetris::GameBoard board(options.height, options.width);
+            play(board);
+        }
     }
 
-    std::cout << "Your Score was " << game.get_score() << std::endl;
-    std::cout << "You cleared " << game.lines_cleared_count() << " line(s)" << std::endl;
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    if (options.saveScores)
+        recordScores(results, options.height, options.width, !options.json);
+    if (options.json)
+        printJson(options, results, startupMs, totalMs);
 
     return 0;
-}
\ No newline at end of file
+}
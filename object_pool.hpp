@@ -0,0 +1,65 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace tetris
+{
+
+    // Hands out objects from big chunks and takes them back onto a free list, so making and dropping
+    // lots of them (server sessions) doesn't go to the allocator every time, and an object that comes
+    // back keeps whatever memory it already had (a GameBoard keeps its grid). Not thread safe, every
+    // thread that needs one has its own. Objects are never destroyed until the pool is
+    template <typename T>
+    class ObjectPool
+    {
+    public:
+        explicit ObjectPool(std::size_t chunk_size = 256) : chunk_size(chunk_size) {}
+
+        ObjectPool(const ObjectPool &) = delete;
+        ObjectPool &operator=(const ObjectPool &) = delete;
+
+        // an object that may have been used before, it's up to the caller to set it up again
+        T *acquire()
+        {
+            if (free_list.empty())
+            {
+                chunks.emplace_back(new T[chunk_size]);
+                T *chunk = chunks.back().get();
+                for (std::size_t i = chunk_size; i > 0; --i)
+                {
+                    free_list.push_back(&chunk[i - 1]);
+                }
+            }
+            T *object = free_list.back();
+            free_list.pop_back();
+            ++used;
+            return object;
+        }
+
+        void release(T *object)
+        {
+            free_list.push_back(object);
+            --used;
+        }
+
+        std::size_t in_use() const
+        {
+            return used;
+        }
+
+        std::size_t capacity() const
+        {
+            return chunks.size() * chunk_size;
+        }
+
+    private:
+        std::size_t chunk_size;
+        std::size_t used = 0;
+        std::vector<std::unique_ptr<T[]>> chunks;
+        std::vector<T *> free_list;
+    };
+
+}
+#endif // OBJECT_POOL_HPP
@@ -0,0 +1,198 @@
+#include "pieces.hpp"
+#include "grid.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // true if the cells of the box all touch, a piece in two bits would fall apart as it locks
+    bool in_one_piece(const std::vector<std::vector<int>> &box)
+    {
+      int size = static_cast<int>(box.size());
+      std::vector<std::vector<int>> seen(size, std::vector<int>(size, 0));
+      std::vector<std::pair<int, int>> todo;
+      int cells = 0;
+      for (int y = 0; y < size; ++y)
+      {
+        for (int x = 0; x < size; ++x)
+        {
+          cells += box[y][x];
+          if (box[y][x] && todo.empty())
+          {
+            todo.push_back({y, x});
+            seen[y][x] = 1;
+          }
+        }
+      }
+
+      int reached = 0;
+      while (!todo.empty())
+      {
+        std::pair<int, int> cell = todo.back();
+        todo.pop_back();
+        ++reached;
+        const int steps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for (const int *step : steps)
+        {
+          int y = cell.first + step[0];
+          int x = cell.second + step[1];
+          if (y >= 0 && y < size && x >= 0 && x < size && box[y][x] && !seen[y][x])
+          {
+            seen[y][x] = 1;
+            todo.push_back({y, x});
+          }
+        }
+      }
+      return reached == cells;
+    }
+  }
+
+  PieceSet::PieceSet() : shapes(1), names(1) {}
+
+  const PieceSet &PieceSet::standard()
+  {
+    static const PieceSet set = []
+    {
+      PieceSet seven;
+      const char *names[] = {"", "O", "I", "S", "Z", "T", "L", "J"};
+      for (int piece = 1; piece <= 7; ++piece)
+        seven.add(names[piece], tetris::shapes.at(piece));
+      return seven;
+    }();
+    return set;
+  }
+
+  void PieceSet::add(const std::string &name, const std::vector<std::vector<int>> &box)
+  {
+    int size = static_cast<int>(box.size());
+    std::vector<std::vector<int>> turning = box;
+    std::array<PieceShape, 4> turns;
+    for (PieceShape &shape : turns)
+    {
+      shape.size = size;
+      for (int y = 0; y < size; ++y)
+      {
+        for (int x = 0; x < size; ++x)
+        {
+          if (!turning[y][x])
+            continue;
+          shape.rows[y] |= 1u << x;
+          shape.cells_x[shape.cell_count] = static_cast<std::int8_t>(x);
+          shape.cells_y[shape.cell_count] = static_cast<std::int8_t>(y);
+          ++shape.cell_count;
+        }
+      }
+
+      // the same quarter turn GameBoard::rotate always did
+      std::vector<std::vector<int>> turned(size, std::vector<int>(size, 0));
+      for (int y = 0; y < size; ++y)
+      {
+        for (int x = 0; x < size; ++x)
+          turned[size - 1 - x][y] = turning[y][x];
+      }
+      turning.swap(turned);
+    }
+    shapes.push_back(turns);
+    names.push_back(name);
+    largest = std::max(largest, size);
+  }
+
+  PieceSet PieceSet::parse(const std::string &text)
+  {
+    PieceSet set;
+    std::istringstream lines(text);
+    std::string line;
+    int number = 0;
+    std::string name;
+    int name_line = 0;
+    std::vector<std::vector<int>> box;
+
+    auto fail = [](int at, const std::string &what)
+    {
+      throw std::runtime_error("line " + std::to_string(at) + " " + what);
+    };
+
+    // the piece that was being drawn is done, it goes in if it makes sense
+    auto finish = [&]()
+    {
+      if (name.empty())
+        return;
+      int size = static_cast<int>(box.size());
+      if (size < 2 || size > max_piece_size)
+        fail(name_line, "starts a piece whose box isn't 2 to 5 rows");
+      for (const std::vector<int> &row : box)
+      {
+        if (static_cast<int>(row.size()) != size)
+          fail(name_line, "starts a piece whose box isn't square");
+      }
+      if (!in_one_piece(box))
+        fail(name_line, "starts a piece that isn't all in one piece");
+      bool any = false;
+      for (const std::vector<int> &row : box)
+      {
+        for (int cell : row)
+          any = any || cell;
+      }
+      if (!any)
+        fail(name_line, "starts a piece with no cells");
+      if (set.count() == max_pieces)
+        fail(name_line, "starts one piece too many, a set has up to " + std::to_string(max_pieces));
+      set.add(name, box);
+      name.clear();
+      box.clear();
+    };
+
+    while (std::getline(lines, line))
+    {
+      ++number;
+      while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+        line.pop_back();
+      if (line.empty() || line.compare(0, 2, "//") == 0)
+        continue;
+
+      if (line.compare(0, 6, "piece ") == 0)
+      {
+        finish();
+        name = line.substr(6);
+        name_line = number;
+        continue;
+      }
+      if (name.empty())
+        fail(number, "comes before the first piece line");
+      if (line.find_first_not_of("#.") != std::string::npos)
+        fail(number, "has something other than # and . in it");
+      std::vector<int> row;
+      for (char c : line)
+        row.push_back(c == '#');
+      box.push_back(row);
+    }
+    finish();
+
+    if (set.count() == 0)
+      throw std::runtime_error("has no pieces in it");
+    return set;
+  }
+
+  PieceSet PieceSet::load(const std::string &path)
+  {
+    std::ifstream in(path);
+    if (!in)
+      throw std::runtime_error("Cannot open the pieces " + path);
+    std::stringstream text;
+    text << in.rdbuf();
+    try
+    {
+      return parse(text.str());
+    }
+    catch (const std::runtime_error &e)
+    {
+      throw std::runtime_error(path + " " + e.what());
+    }
+  }
+
+}
@@ -0,0 +1,74 @@
+#ifndef PIECES_HPP
+#define PIECES_HPP
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris
+{
+
+    // the biggest box a piece can turn in
+    const int max_piece_size = 5;
+
+    // One way round of a piece, worked out once when its set is made so the board never turns a
+    // matrix or walks an empty corner of the box: the cells as a list, and the box as a bit mask
+    // per row for the backends that keep their rows as bits
+    struct PieceShape
+    {
+        int size = 0;                                 // the box is size x size, the piece turns inside it
+        std::uint32_t rows[max_piece_size] = {};      // row y of the box, bit x is column x
+        int cell_count = 0;
+        std::int8_t cells_x[max_piece_size * max_piece_size] = {}; // the cells in the box, row by row
+        std::int8_t cells_y[max_piece_size * max_piece_size] = {};
+
+        bool has(int y, int x) const { return y >= 0 && y < size && x >= 0 && x < size && (rows[y] >> x & 1); }
+    };
+
+    // The pieces a board deals out, piece n is color number n (n from 1), and all 4 turns of every
+    // one of them, each turn is the box turned a quarter (y, x) to (size - 1 - x, y) like it
+    // always was. standard() is the seven from grid.hpp, other sets come from a text file:
+    //
+    //   // pentominoes, a line starting with // is a comment
+    //   piece F
+    //   .##
+    //   ##.
+    //   .#.
+    //   piece I
+    //   .....
+    //   .....
+    //   #####
+    //   .....
+    //   .....
+    //
+    // every piece is its box drawn out, # for a cell and . for none, square and 2 to 5 wide, the
+    // box is what it turns in so the empty rows and columns count
+    class PieceSet
+    {
+    public:
+        static constexpr int max_pieces = 15; // the color numbers are kept in 4 bits in places (undo, autosave)
+
+        static const PieceSet &standard();
+
+        // throws std::runtime_error saying what's wrong and on which line
+        static PieceSet parse(const std::string &text);
+        static PieceSet load(const std::string &path);
+
+        int count() const { return static_cast<int>(names.size()) - 1; }
+        int box_size() const { return largest; } // the biggest box of them
+        const std::string &name(int piece) const { return names[piece]; }
+
+        // piece is 1 to count(), rotation 0 to 3
+        const PieceShape &shape(int piece, int rotation) const { return shapes[piece][rotation]; }
+
+    private:
+        PieceSet();
+        void add(const std::string &name, const std::vector<std::vector<int>> &box);
+
+        std::vector<std::array<PieceShape, 4>> shapes; // index 0 is unused, like the color numbers
+        std::vector<std::string> names;
+        int largest = 0;
+    };
+
+}
+#endif // PIECES_HPP
@@ -0,0 +1,181 @@
+#include "protocol.hpp"
+
+namespace tetris
+{
+  namespace protocol
+  {
+
+    namespace
+    {
+      void put_u16(Buffer &out, std::uint16_t value)
+      {
+        out.push_back(value & 0xff);
+        out.push_back(value >> 8);
+      }
+
+      void put_u32(Buffer &out, std::uint32_t value)
+      {
+        for (int i = 0; i < 4; ++i)
+        {
+          out.push_back((value >> (8 * i)) & 0xff);
+        }
+      }
+
+      std::uint16_t get_u16(const std::uint8_t *data)
+      {
+        return static_cast<std::uint16_t>(data[0] | data[1] << 8);
+      }
+
+      std::uint32_t get_u32(const std::uint8_t *data)
+      {
+        return static_cast<std::uint32_t>(data[0]) | static_cast<std::uint32_t>(data[1]) << 8 |
+               static_cast<std::uint32_t>(data[2]) << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+      }
+
+      // the payload length gets filled in once the payload is written
+      std::size_t begin_message(Buffer &out, MessageType type)
+      {
+        out.push_back(static_cast<std::uint8_t>(type));
+        put_u16(out, 0);
+        return out.size();
+      }
+
+      void end_message(Buffer &out, std::size_t payload_start)
+      {
+        std::size_t length = out.size() - payload_start;
+        out[payload_start - 2] = length & 0xff;
+        out[payload_start - 1] = (length >> 8) & 0xff;
+      }
+    }
+
+    void write_hello(Buffer &out, int width, int height)
+    {
+      std::size_t start = begin_message(out, MessageType::Hello);
+      out.push_back(static_cast<std::uint8_t>(width));
+      out.push_back(static_cast<std::uint8_t>(height));
+      end_message(out, start);
+    }
+
+    void write_input(Buffer &out, Input input, std::uint32_t seq)
+    {
+      std::size_t start = begin_message(out, MessageType::Input);
+      out.push_back(static_cast<std::uint8_t>(input));
+      put_u32(out, seq);
+      end_message(out, start);
+    }
+
+    void write_update(Buffer &out, UpdateHeader header, BoardView &prev, const BoardView &next, int width)
+    {
+      std::size_t start = begin_message(out, MessageType::Update);
+      put_u32(out, header.ack);
+      put_u32(out, header.score);
+      put_u32(out, header.lines);
+      out.push_back(header.game_over);
+      std::size_t count_at = out.size();
+      put_u16(out, 0);
+
+      // a new client has nothing yet, so it gets everything that isn't empty
+      if (prev.size() != next.size())
+      {
+        prev.assign(next.size(), 0);
+      }
+
+      std::uint16_t count = 0;
+      for (std::size_t i = 0; i < next.size(); ++i)
+      {
+        if (next[i] != prev[i])
+        {
+          out.push_back(static_cast<std::uint8_t>(i / width));
+          out.push_back(static_cast<std::uint8_t>(i % width));
+          out.push_back(next[i]);
+          prev[i] = next[i];
+          ++count;
+        }
+      }
+      out[count_at] = count & 0xff;
+      out[count_at + 1] = count >> 8;
+      end_message(out, start);
+    }
+
+    void render_view(GameBoard &board, BoardView &view)
+    {
+      int width = board.getWidth();
+      int height = board.getHeight();
+      view.resize(static_cast<std::size_t>(width) * height);
+      for (int y = 0; y < height; ++y)
+      {
+        for (int x = 0; x < width; ++x)
+        {
+          view[y * width + x] = static_cast<std::uint8_t>(board.cell(y, x));
+        }
+      }
+
+      const PieceShape &shape = board.falling_shape();
+      for (int i = 0; i < shape.cell_count; ++i)
+      {
+        int grid_y = board.b_y + shape.cells_y[i];
+        int grid_x = board.b_x + shape.cells_x[i];
+        if (grid_y >= 0 && grid_y < height && grid_x >= 0 && grid_x < width)
+        {
+          view[grid_y * width + grid_x] = static_cast<std::uint8_t>(board.getBlock());
+        }
+      }
+    }
+
+    bool next_message(const std::uint8_t *data, std::size_t size, MessageType &type,
+                      const std::uint8_t *&payload, std::size_t &payload_size)
+    {
+      if (size < header_size)
+        return false;
+      payload_size = get_u16(data + 1);
+      if (size < header_size + payload_size)
+        return false;
+      type = static_cast<MessageType>(data[0]);
+      payload = data + header_size;
+      return true;
+    }
+
+    bool read_hello(const std::uint8_t *payload, std::size_t size, int &width, int &height)
+    {
+      if (size != 2)
+        return false;
+      width = payload[0];
+      height = payload[1];
+      return width >= 5 && width <= 50 && height >= 5 && height <= 50;
+    }
+
+    bool read_input(const std::uint8_t *payload, std::size_t size, Input &input, std::uint32_t &seq)
+    {
+      if (size != 5 || payload[0] > static_cast<std::uint8_t>(Input::Rotate))
+        return false;
+      input = static_cast<Input>(payload[0]);
+      seq = get_u32(payload + 1);
+      return true;
+    }
+
+    bool read_update(const std::uint8_t *payload, std::size_t size, UpdateHeader &header,
+                     BoardView &view, int width)
+    {
+      if (size < update_fixed_size)
+        return false;
+      header.ack = get_u32(payload);
+      header.score = get_u32(payload + 4);
+      header.lines = get_u32(payload + 8);
+      header.game_over = payload[12] != 0;
+      header.count = get_u16(payload + 13);
+      if (size != update_fixed_size + 3u * header.count)
+        return false;
+
+      const std::uint8_t *cell = payload + update_fixed_size;
+      for (int i = 0; i < header.count; ++i, cell += 3)
+      {
+        std::size_t index = static_cast<std::size_t>(cell[0]) * width + cell[1];
+        if (index >= view.size())
+          return false;
+        view[index] = cell[2];
+      }
+      return true;
+    }
+
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "grid.hpp"
+
+namespace tetris
+{
+    // The binary protocol between tetris_server.exe and its clients. Every message is
+    // [type u8][payload length u16][payload], all numbers little endian.
+    //
+    //   Hello   client -> server  [width u8][height u8]             starts (or restarts) a game
+    //   Input   client -> server  [input u8][seq u32]               one move, seq comes back as the ack
+    //   Update  server -> client  [ack u32][score u32][lines u32][game_over u8][count u16]
+    //                             then count x [y u8][x u8][value u8]
+    //
+    // An Update only has the cells that changed since the last one the client got, the client keeps
+    // the board (a "view": the pile with the falling piece drawn in) and patches it. After a Hello
+    // the client starts over from an empty board
+    namespace protocol
+    {
+        enum class MessageType : std::uint8_t
+        {
+            Hello = 1,
+            Input = 2,
+            Update = 0x81
+        };
+
+        constexpr std::size_t header_size = 3;
+        constexpr std::size_t update_fixed_size = 15; // the part of an Update before the cells
+
+        typedef std::vector<std::uint8_t> Buffer;
+
+        // what the client sees, width * height color numbers with the falling piece drawn in
+        typedef std::vector<std::uint8_t> BoardView;
+
+        struct UpdateHeader
+        {
+            std::uint32_t ack = 0; // seq of the last input the server applied
+            std::uint32_t score = 0;
+            std::uint32_t lines = 0;
+            bool game_over = false;
+            std::uint16_t count = 0; // how many cells changed
+        };
+
+        // these append a whole message to out
+        void write_hello(Buffer &out, int width, int height);
+        void write_input(Buffer &out, Input input, std::uint32_t seq);
+
+        // writes the cells of next that differ from prev, and makes prev equal to next.
+        // prev can be empty (a new client), then every cell is sent
+        void write_update(Buffer &out, UpdateHeader header, BoardView &prev, const BoardView &next, int width);
+
+        // draws the board and its falling piece into view
+        void render_view(GameBoard &board, BoardView &view);
+
+        // finds the next whole message in data, returns false if it hasn't all arrived yet
+        bool next_message(const std::uint8_t *data, std::size_t size, MessageType &type,
+                          const std::uint8_t *&payload, std::size_t &payload_size);
+
+        // reads a payload, returns false if it is the wrong size or has bad values
+        bool read_hello(const std::uint8_t *payload, std::size_t size, int &width, int &height);
+        bool read_input(const std::uint8_t *payload, std::size_t size, Input &input, std::uint32_t &seq);
+        bool read_update(const std::uint8_t *payload, std::size_t size, UpdateHeader &header,
+                         BoardView &view, int width);
+    }
+
+}
+#endif // PROTOCOL_HPP
@@ -0,0 +1,223 @@
+#include "replay.hpp"
+#include "simulation.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // the words and numbers of a replay in memory, one after the other. anything that isn't what
+    // was asked for makes good false and the rest of the reads give nothing
+    struct ReplayText
+    {
+      const char *at;
+      const char *end;
+      bool good = true;
+
+      void skip_space()
+      {
+        while (at < end && std::isspace(static_cast<unsigned char>(*at)))
+          ++at;
+      }
+
+      void word(const char *expected)
+      {
+        skip_space();
+        std::size_t length = std::strlen(expected);
+        if (!good || static_cast<std::size_t>(end - at) < length || std::memcmp(at, expected, length) != 0 ||
+            (at + length < end && !std::isspace(static_cast<unsigned char>(at[length]))))
+        {
+          good = false;
+          return;
+        }
+        at += length;
+      }
+
+      long long number()
+      {
+        skip_space();
+        bool negative = at < end && *at == '-';
+        if (negative)
+          ++at;
+        if (!good || at == end || !std::isdigit(static_cast<unsigned char>(*at)))
+        {
+          good = false;
+          return 0;
+        }
+        long long value = 0;
+        for (; at < end && std::isdigit(static_cast<unsigned char>(*at)); ++at)
+        {
+          value = value * 10 + (*at - '0');
+          if (value > (1LL << 53))
+          {
+            // stops before the next digit can overflow it
+            good = false;
+            return 0;
+          }
+        }
+        return negative ? -value : value;
+      }
+    };
+  }
+
+  void Replay::save(const std::string &path) const
+  {
+    std::ofstream out(path);
+    out << "tetris-replay 2\n"
+        << "board " << width << " " << height << "\n"
+        << "seed " << seed << "\n"
+        << "tick_rate " << tick_rate << "\n"
+        << "ticks " << ticks << "\n"
+        << "score " << score << "\n"
+        << "lines " << lines << "\n"
+        << "moves " << moves.size() << "\n";
+    for (const ReplayMove &move : moves)
+    {
+      out << move.tick << " " << static_cast<int>(move.input) << "\n";
+    }
+    if (!out.flush())
+      throw std::runtime_error("Cannot write the replay " + path);
+  }
+
+  Replay Replay::load(const std::string &path)
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      throw std::runtime_error("Cannot open the replay " + path);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    try
+    {
+      return parse(text.data(), text.size());
+    }
+    catch (const std::runtime_error &e)
+    {
+      throw std::runtime_error(path + " " + e.what());
+    }
+  }
+
+  Replay Replay::parse(const char *data, std::size_t size)
+  {
+    ReplayText text{data, data + size};
+    Replay replay;
+    text.word("tetris-replay");
+    long long version = text.number();
+    text.word("board");
+    replay.width = static_cast<int>(text.number());
+    replay.height = static_cast<int>(text.number());
+    text.word("seed");
+    replay.seed = static_cast<unsigned>(text.number());
+    text.word("tick_rate");
+    replay.tick_rate = static_cast<int>(text.number());
+    text.word("ticks");
+    replay.ticks = text.number();
+    if (version == 2)
+    {
+      text.word("score");
+      replay.score = static_cast<int>(text.number());
+      text.word("lines");
+      replay.lines = static_cast<int>(text.number());
+    }
+    text.word("moves");
+    long long count = text.number();
+    if (!text.good || (version != 1 && version != 2) || replay.width < 5 || replay.width > 50 || replay.height < 5 ||
+        replay.height > 50 || replay.tick_rate < 2 || replay.ticks < 0 || count < 0 ||
+        count > static_cast<long long>(size))
+      throw std::runtime_error("is not a replay this version understands");
+
+    replay.moves.reserve(count);
+    for (long long i = 0; i < count; ++i)
+    {
+      long long tick = text.number();
+      long long input = text.number();
+      if (!text.good || input < 0 || input > static_cast<int>(Input::Rotate) ||
+          (!replay.moves.empty() && tick < replay.moves.back().tick))
+        throw std::runtime_error("has a bad move in it");
+      replay.moves.push_back({tick, static_cast<Input>(input)});
+    }
+    return replay;
+  }
+
+  ReplayPlayer::ReplayPlayer(const Replay &replay, GameBoard &board) : replay(replay), board(board)
+  {
+    board.reset();
+    board.seed(replay.seed);
+    board.generate_new_piece();
+  }
+
+  void ReplayPlayer::step()
+  {
+    while (next < replay.moves.size() && replay.moves[next].tick == current)
+    {
+      board.handle_input(replay.moves[next].input);
+      ++next;
+    }
+    ++current;
+    if (Simulation::gravity_due(current, replay.tick_rate))
+      board.move_down();
+  }
+
+  void ReplayPlayer::skip_idle()
+  {
+    // tick current does something if a move is on it or the count it brings up has gravity
+    long long every = Simulation::gravity_every(replay.tick_rate);
+    long long target = std::min((current / every + 1) * every - 1, replay.ticks);
+    if (next < replay.moves.size())
+      target = std::min(target, replay.moves[next].tick);
+    current = std::max(current, target);
+  }
+
+  void ReplayPlayer::jump(long long tick)
+  {
+    current = tick;
+    next = std::lower_bound(replay.moves.begin(), replay.moves.end(), tick, [](const ReplayMove &move, long long t)
+                            { return move.tick < t; }) -
+           replay.moves.begin();
+  }
+
+  ReplayCheck verify_replay(const Replay &replay, GameBoard &board)
+  {
+    ReplayCheck check;
+    if (!replay.moves.empty() && replay.moves.back().tick >= replay.ticks)
+    {
+      check.problem = "has moves after its last tick";
+      return check;
+    }
+
+    ReplayPlayer player(replay, board);
+    while (!player.finished())
+    {
+      player.skip_idle();
+      if (player.finished())
+        break;
+      player.step();
+      if (board.is_game_over() && !player.finished())
+      {
+        check.problem = "was over at tick " + std::to_string(player.tick()) + " but goes on to " +
+                        std::to_string(replay.ticks);
+        break;
+      }
+    }
+    check.ticks = player.tick();
+    check.score = board.get_score();
+    check.lines = board.lines_cleared_count();
+    if (!check.problem.empty())
+      return check;
+
+    if (replay.score < 0 || replay.lines < 0)
+      check.problem = "doesn't say what it scored";
+    else if (check.score != replay.score || check.lines != replay.lines)
+      check.problem = "says " + std::to_string(replay.score) + " points and " + std::to_string(replay.lines) +
+                      " lines, playing it gives " + std::to_string(check.score) + " and " +
+                      std::to_string(check.lines);
+    else
+      check.ok = true;
+    return check;
+  }
+
+}
@@ -0,0 +1,84 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+#include <string>
+#include <vector>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // an input and the tick it was played on (its number before the tick counted itself)
+    struct ReplayMove
+    {
+        long long tick;
+        Input input;
+    };
+
+    // A game as the Simulation played it: the board, the seed its pieces came from and every input
+    // in the order they went in, the player's and the bot's alike. Gravity isn't in it, that comes
+    // from the tick count, so playing the moves on the same ticks gets the same game back
+    struct Replay
+    {
+        int width = 10;
+        int height = 20;
+        unsigned seed = 0;
+        int tick_rate = 60;
+        long long ticks = 0; // how long the game went
+        int score = -1;      // what the game ended with, for checking it. -1 when it doesn't say
+        int lines = -1;      // (version 1 files didn't have them)
+        std::vector<ReplayMove> moves;
+
+        // a small text file, a header and then a "tick input" line per move. both throw
+        // std::runtime_error when the file can't be written or read
+        void save(const std::string &path) const;
+        static Replay load(const std::string &path);
+
+        // the same from a file that's already in memory (a mapping, say). what it throws says what's
+        // wrong with it without a name, "is not a replay ..." so the caller can put one in front
+        static Replay parse(const char *text, std::size_t size);
+    };
+
+    // Plays a replay back on a board one tick at a time, the same way Simulation::tick does it
+    class ReplayPlayer
+    {
+    public:
+        // resets the board (it has to be the replay's size) to how the game started
+        ReplayPlayer(const Replay &replay, GameBoard &board);
+
+        void step();
+
+        // goes over the ticks where nothing would happen (no move and no gravity) in one go, the next
+        // step() is one that does something. the board can't change on those, so this is the same
+        // as stepping through them
+        void skip_idle();
+        long long tick() const { return current; }
+        bool finished() const { return current >= replay.ticks; }
+
+        // goes on from a board someone else played up to tick, for picking up from a saved state
+        void jump(long long tick);
+
+    private:
+        const Replay &replay;
+        GameBoard &board;
+        long long current = 0;
+        std::size_t next = 0; // the first move that hasn't been played
+    };
+
+    // what playing a replay back came to, ok when it played out and ended with the score and lines
+    // it says it got. problem says what didn't match otherwise
+    struct ReplayCheck
+    {
+        bool ok = false;
+        std::string problem;
+        int score = 0;
+        int lines = 0;
+        long long ticks = 0;
+    };
+
+    // Plays the replay on board (it has to be the replay's size) as fast as it goes, gravity comes
+    // from the tick count and not the clock, and checks the game ends the way the replay says. A
+    // game that's over before its last tick is wrong too, the simulation would have stopped there
+    ReplayCheck verify_replay(const Replay &replay, GameBoard &board);
+
+}
+#endif // REPLAY_HPP
@@ -0,0 +1,109 @@
+#include "shared_state.hpp"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace tetris
+{
+
+  SharedStatePublisher::SharedStatePublisher(const std::string &name) : name(name), state(nullptr)
+  {
+    // O_EXCL so we never write over another game's segment, or one a game left behind when it died
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST)
+      throw std::runtime_error("Shared memory " + name + " is in use (if no game has it, remove /dev/shm" + name + ")");
+    if (fd < 0)
+      throw std::runtime_error("Cannot create shared memory " + name);
+
+    if (ftruncate(fd, sizeof(SharedGameState)) != 0)
+    {
+      close(fd);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("Cannot size shared memory " + name);
+    }
+
+    void *memory = mmap(nullptr, sizeof(SharedGameState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the segment alive, we don't need the fd anymore
+    if (memory == MAP_FAILED)
+    {
+      shm_unlink(name.c_str());
+      throw std::runtime_error("Cannot map shared memory " + name);
+    }
+
+    state = new (memory) SharedGameState();
+    state->magic = SharedGameState::magic_value;
+    state->version = SharedGameState::current_version;
+    state->seq.store(0, std::memory_order_release);
+  }
+
+  SharedStatePublisher::~SharedStatePublisher()
+  {
+    munmap(state, sizeof(SharedGameState));
+    shm_unlink(name.c_str());
+  }
+
+  SharedGameSnapshot &SharedStatePublisher::begin_write()
+  {
+    // odd means "being written", readers that see it (or see it change) try again
+    std::uint64_t seq = state->seq.load(std::memory_order_relaxed);
+    state->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return state->snapshot;
+  }
+
+  void SharedStatePublisher::end_write()
+  {
+    state->seq.store(state->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  SharedStateReader::SharedStateReader(const std::string &name) : state(nullptr)
+  {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw std::runtime_error("No game is publishing to " + name);
+
+    void *memory = mmap(nullptr, sizeof(SharedGameState), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+      throw std::runtime_error("Cannot map shared memory " + name);
+
+    state = static_cast<const SharedGameState *>(memory);
+    if (state->magic != SharedGameState::magic_value || state->version != SharedGameState::current_version)
+    {
+      munmap(const_cast<SharedGameState *>(state), sizeof(SharedGameState));
+      throw std::runtime_error(name + " is not a tetris game state this reader understands");
+    }
+  }
+
+  SharedStateReader::~SharedStateReader()
+  {
+    munmap(const_cast<SharedGameState *>(state), sizeof(SharedGameState));
+  }
+
+  bool SharedStateReader::read(SharedGameSnapshot &out) const
+  {
+    for (;;)
+    {
+      std::uint64_t before = state->seq.load(std::memory_order_acquire);
+      if (before == 0)
+        return false;
+
+      if (before % 2 == 0)
+      {
+        std::memcpy(&out, &state->snapshot, sizeof(SharedGameSnapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (state->seq.load(std::memory_order_relaxed) == before)
+          return true;
+      }
+
+      // the game was in the middle of writing, it only takes a moment
+      std::this_thread::yield();
+    }
+  }
+
+}
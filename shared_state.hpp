@@ -0,0 +1,120 @@
+#ifndef SHARED_STATE_HPP
+#define SHARED_STATE_HPP
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // What the game publishes, only plain fields so it can be copied out with a memcpy
+    struct SharedGameSnapshot
+    {
+        static constexpr int max_size = 50; // boards are at most 50 x 50
+
+        std::int32_t width;
+        std::int32_t height;
+        std::int32_t b_x;
+        std::int32_t b_y;
+        std::int32_t block;
+        std::int32_t rotation;
+        std::int32_t score;
+        std::int32_t lines_cleared;
+        std::int32_t piece_size;                // the falling piece's box is piece_size x piece_size
+        std::uint8_t game_over;
+        std::uint8_t piece[max_piece_size][max_piece_size]; // the falling piece, 1 where it has a block
+        std::uint8_t cells[max_size][max_size]; // color number of each cell, rows and columns past the size are unused
+    };
+
+    // The layout of the shared memory segment, fixed size so another process can map it without
+    // knowing anything else. seq is the seqlock: odd while the game is writing, and it goes up by
+    // two for every publish, so a reader that sees the same even number before and after its copy
+    // knows the copy is consistent
+    struct SharedGameState
+    {
+        static constexpr std::uint32_t magic_value = 0x54455453; // "TETS"
+        static constexpr std::uint32_t current_version = 2; // 2 made room for 5x5 pieces
+
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::atomic<std::uint64_t> seq;
+        SharedGameSnapshot snapshot;
+    };
+
+    // Game side: creates the POSIX shared memory segment and writes the board into it under a seqlock.
+    // Writing never waits on the readers and never makes a syscall, it is a few stores and a memcpy
+    class SharedStatePublisher
+    {
+    public:
+        // name is a shm name like "/tetris", throws std::runtime_error if it can't be created or
+        // already exists
+        explicit SharedStatePublisher(const std::string &name);
+        ~SharedStatePublisher(); // unmaps and removes the segment
+
+        SharedStatePublisher(const SharedStatePublisher &) = delete;
+        SharedStatePublisher &operator=(const SharedStatePublisher &) = delete;
+
+        // any board with GameBoard's getters will do, a GameBoard or a FixedGameBoard
+        template <typename Board>
+        void publish(Board &board)
+        {
+            SharedGameSnapshot &snap = begin_write();
+            snap.width = board.getWidth();
+            snap.height = board.getHeight();
+            snap.b_x = board.b_x;
+            snap.b_y = board.b_y;
+            snap.block = board.getBlock();
+            snap.rotation = board.getRotation();
+            snap.score = board.get_score();
+            snap.lines_cleared = board.lines_cleared_count();
+            snap.game_over = board.is_game_over();
+
+            const PieceShape &shape = board.falling_shape();
+            snap.piece_size = shape.size;
+            for (int y = 0; y < max_piece_size; ++y)
+            {
+                for (int x = 0; x < max_piece_size; ++x)
+                {
+                    snap.piece[y][x] = shape.has(y, x);
+                }
+            }
+
+            for (int y = 0; y < snap.height && y < SharedGameSnapshot::max_size; ++y)
+            {
+                for (int x = 0; x < snap.width && x < SharedGameSnapshot::max_size; ++x)
+                {
+                    snap.cells[y][x] = static_cast<std::uint8_t>(board.cell(y, x));
+                }
+            }
+            end_write();
+        }
+
+    private:
+        SharedGameSnapshot &begin_write(); // makes seq odd, the snapshot is the game's until end_write
+        void end_write();
+        std::string name;
+        SharedGameState *state;
+    };
+
+    // Reader side: maps an existing segment read only and takes consistent copies out of it
+    class SharedStateReader
+    {
+    public:
+        // throws std::runtime_error if there's no game publishing under that name
+        explicit SharedStateReader(const std::string &name);
+        ~SharedStateReader();
+
+        SharedStateReader(const SharedStateReader &) = delete;
+        SharedStateReader &operator=(const SharedStateReader &) = delete;
+
+        // copies the newest complete state into out, retrying if the game wrote in the middle of it.
+        // returns false if nothing has been published yet
+        bool read(SharedGameSnapshot &out) const;
+
+    private:
+        const SharedGameState *state;
+    };
+
+}
+#endif // SHARED_STATE_HPP
@@ -0,0 +1,246 @@
+#include "simulation.hpp"
+#include "fixed_board.hpp"
+#include "shared_state.hpp"
+#include "bot.hpp"
+#include "replay.hpp"
+#include "undo.hpp"
+#include "autosave.hpp"
+#include "hint.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // the pile into the snapshot's rows, they're already there after the first tick so it's a copy
+    void copy_pile(GameBoard &board, Grid &grid)
+    {
+      grid = board.getGameState();
+    }
+
+    template <int Width, int Height>
+    void copy_pile(const FixedGameBoard<Width, Height> &board, Grid &grid)
+    {
+      grid.resize(Height);
+      for (int y = 0; y < Height; ++y)
+      {
+        const std::array<std::uint8_t, Width> &row = board.cell_row(y);
+        grid[y].assign(row.begin(), row.end());
+      }
+    }
+  }
+
+  template <typename Board>
+  BasicSimulation<Board>::BasicSimulation(Board &board, int tick_rate) : board(board), tick_rate(tick_rate)
+  {
+    listen_for_clears();
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::listen_for_clears()
+  {
+    // the clear has to cross over to the render thread, so it goes into the snapshot
+    board.set_rows_cleared_listener([this](const std::vector<int> &rows)
+                                    {
+      last_cleared_rows = rows;
+      ++clear_count; });
+  }
+
+  template <typename Board>
+  BasicSimulation<Board>::~BasicSimulation()
+  {
+    stop();
+    board.set_rows_cleared_listener(nullptr);
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::start()
+  {
+    if (running.exchange(true))
+      return;
+
+    if constexpr (can_undo)
+    {
+      if (undo_history)
+      {
+        undo_history->start(board);
+        pieces_seen = board.pieces_placed();
+      }
+    }
+
+    // the renderer gets a frame to draw before the first tick
+    publish();
+    thread = std::thread(&BasicSimulation::run, this);
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::stop()
+  {
+    running.store(false, std::memory_order_release);
+    if (thread.joinable())
+      thread.join();
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::wait()
+  {
+    if (thread.joinable())
+      thread.join();
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::run()
+  {
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::nanoseconds(1000000000LL / tick_rate);
+    auto next_tick = clock::now() + period;
+    const long long resumed_at = tick_count;
+
+    while (running.load(std::memory_order_acquire))
+    {
+      tick();
+      if (tick_count == resumed_at + 1)
+        first_tick = clock::now();
+      publish();
+      if (autosave && tick_count % autosave_every == 0)
+        save_game();
+
+      if (board.is_game_over())
+      {
+        running.store(false, std::memory_order_release);
+        break;
+      }
+
+      // ticks are scheduled off the start time, not off when the last one finished, so they don't drift
+      if (!max_speed)
+      {
+        std::this_thread::sleep_until(next_tick);
+        next_tick += period;
+      }
+    }
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::tick()
+  {
+    if constexpr (can_undo)
+    {
+      if (undo_history)
+        play_undos();
+    }
+
+    Input input;
+    while (inputs.pop(input))
+    {
+      board.handle_input(input);
+      note_lock();
+      if (replay)
+        replay->moves.push_back({tick_count, input});
+    }
+
+    Input move;
+    if (bot && tick_count % bot_every == 0 && bot->next_move(board, move))
+    {
+      board.handle_input(move);
+      note_lock();
+      if (replay)
+        replay->moves.push_back({tick_count, move});
+    }
+
+    ++tick_count;
+    if (gravity_due(tick_count, tick_rate))
+    {
+      board.move_down();
+      note_lock();
+    }
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::note_lock()
+  {
+    // a move locks one piece at most, so looking after every one of them catches them all
+    if constexpr (can_undo)
+    {
+      if (undo_history && board.pieces_placed() != pieces_seen)
+      {
+        undo_history->record(board);
+        pieces_seen = board.pieces_placed();
+      }
+    }
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::play_undos()
+  {
+    // only a GameBoard's simulation gets here, the other boards don't have what the history needs
+    if constexpr (can_undo)
+    {
+      int wanted = undo_requests.exchange(0, std::memory_order_relaxed);
+      if (wanted == 0)
+        return;
+
+      // the pieces locked again on the way back aren't new clears, the renderer shouldn't animate them
+      board.set_rows_cleared_listener(nullptr);
+      for (int i = 0; i < wanted && undo_history->undo(board); ++i)
+        ;
+      listen_for_clears();
+      pieces_seen = board.pieces_placed();
+      hinted_pieces = -1; // the count could come back to where it was with a different pile by the end of the tick
+      if (bot)
+        bot->reset();
+    }
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::save_game()
+  {
+    // the writer's buffers are reused too, this is a copy into memory that's already there and a
+    // handover, the file gets written on the writer's thread
+    SaveGame &save = autosave->next();
+    save.width = board.getWidth();
+    save.height = board.getHeight();
+    save.seed = autosave_seed;
+    save.tick = tick_count;
+    board.save_state(save.board);
+    autosave->submit();
+  }
+
+  template <typename Board>
+  void BasicSimulation<Board>::publish()
+  {
+    // the buffers are reused, so after the first few ticks these copies don't allocate
+    BoardSnapshot &snap = snapshots.write_buffer();
+    copy_pile(board, snap.grid);
+    snap.shape = board.falling_shape();
+    snap.b_x = board.b_x;
+    snap.b_y = board.b_y;
+    snap.block = board.getBlock();
+    snap.score = board.get_score();
+    snap.lines_cleared = board.lines_cleared_count();
+    snap.pieces = board.pieces_placed();
+    snap.game_over = board.is_game_over();
+    snap.tick = tick_count;
+    snap.clear_count = clear_count;
+    snap.cleared_rows = last_cleared_rows;
+    snapshots.publish();
+
+    // the pile only changes when a piece locks (and a new one spawns) or an undo puts it back, and
+    // either way the count moves. moving the piece around doesn't change where it should end up
+    if (hint_engine && board.pieces_placed() != hinted_pieces)
+    {
+      hinted_pieces = board.pieces_placed();
+      hint_engine->search(board);
+    }
+
+    if (shared_state)
+      shared_state->publish(board);
+  }
+
+  template class BasicSimulation<GameBoard>;
+  template class BasicSimulation<FixedGameBoard<15, 25>>;
+  template class BasicSimulation<FixedGameBoard<10, 20>>;
+  template class BasicSimulation<FixedGameBoard<7, 15>>;
+
+}
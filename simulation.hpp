@@ -0,0 +1,161 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include "grid.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+
+namespace tetris
+{
+
+    class SharedStatePublisher; // shared_state.hpp
+    class Bot;                  // bot.hpp
+    struct Replay;              // replay.hpp
+    class UndoHistory;          // undo.hpp
+    class AutosaveWriter;       // autosave.hpp
+    class HintEngine;           // hint.hpp
+
+    // Everything the renderer needs to draw one frame, copied out of the board at the end of a tick.
+    // The simulation thread fills these in and the render thread only ever reads them
+    struct BoardSnapshot
+    {
+        Grid grid;                               // the pile
+        PieceShape shape;                        // the falling piece, a plain copy so it never allocates
+        int b_x = 0;                             // the falling piece's x pos
+        int b_y = 0;                             // the falling piece's y pos
+        int block = 1;                           // the falling piece's color number
+        int score = 0;
+        int lines_cleared = 0;
+        int pieces = 0;                          // pieces placed, a hint has to be for this many
+        bool game_over = false;
+        long long tick = 0;                      // which tick this was taken on
+        int clear_count = 0;                     // goes up by one every time rows are cleared
+        std::vector<int> cleared_rows;           // the rows of the latest clear
+    };
+
+    // Runs the board on its own thread at a fixed tick rate. Inputs come in through an SPSC queue
+    // and every tick publishes a snapshot into a triple buffer, so a slow frame on the render side
+    // never holds up gravity or input and the simulation never waits for the renderer either.
+    // Board is a GameBoard or one of the FixedGameBoards of the difficulty sizes (simulation.cpp
+    // has them all), the game runs those sizes on the fixed one unless it needs what only a
+    // GameBoard has
+    template <typename Board>
+    class BasicSimulation
+    {
+    public:
+        static constexpr int ticks_per_second = 60;
+
+        // the board has to outlive the simulation, and nobody else should touch it while it runs
+        explicit BasicSimulation(Board &board, int tick_rate = ticks_per_second);
+        ~BasicSimulation();
+
+        void start();
+        void stop(); // waits for the current tick to finish
+        void wait(); // waits for the game to end by itself
+
+        // render/input thread side
+        bool push_input(Input input) { return inputs.push(input); }
+        bool update_snapshot() { return snapshots.update(); }
+        const BoardSnapshot &snapshot() const { return snapshots.read_buffer(); }
+
+        // also publish every tick to other processes through shared memory, set it before start()
+        void set_shared_state(SharedStatePublisher *publisher) { shared_state = publisher; }
+
+        bool is_running() const { return running.load(std::memory_order_acquire); }
+
+        // a bot that plays a move every few ticks on the simulation thread, set it before start()
+        void set_bot(Bot *player, int every_ticks)
+        {
+            bot = player;
+            bot_every = every_ticks;
+        }
+
+        // runs the ticks back to back instead of on the clock, set it before start()
+        void set_max_speed(bool on) { max_speed = on; }
+
+        // every input that gets played goes into the replay's moves, set it before start(). the
+        // rest of the replay (the seed and so on) is the caller's to fill in
+        void set_replay(Replay *recording) { replay = recording; }
+
+        // keeps every placement so they can be taken back, set it before start() (the board is
+        // its step 0 then). the replay doesn't know about undos, so don't set both. the history
+        // locks pieces again on a GameBoard, any other board's simulation never looks at it
+        void set_undo_history(UndoHistory *history) { undo_history = history; }
+
+        // hands the game to the writer every every_ticks ticks to be saved, set it before start().
+        // seed is only passed along into the saves
+        void set_autosave(AutosaveWriter *writer, int every_ticks, unsigned seed)
+        {
+            autosave = writer;
+            autosave_every = every_ticks;
+            autosave_seed = seed;
+        }
+
+        // starts the engine on every new piece (and on the board an undo leaves), set it before start()
+        void set_hint_engine(HintEngine *engine) { hint_engine = engine; }
+
+        // carries on from a saved game's tick instead of 0, so gravity keeps the beat it had, set
+        // it before start()
+        void set_first_tick(long long tick) { tick_count = tick; }
+
+        // render/input thread side, the last placement is taken back on the next tick
+        void request_undo() { undo_requests.fetch_add(1, std::memory_order_relaxed); }
+
+        // the piece falls one row every half a second whatever the tick rate is, this many ticks
+        static int gravity_every(int tick_rate) { return std::max(1, tick_rate / 2); }
+
+        // whether gravity moves the piece on the tick that brings the count to tick
+        static bool gravity_due(long long tick, int tick_rate)
+        {
+            return tick % gravity_every(tick_rate) == 0;
+        }
+
+        // when the first tick was done and how many there were, good after stop() or wait()
+        std::chrono::steady_clock::time_point first_tick_time() const { return first_tick; }
+        long long ticks_run() const { return tick_count; }
+
+    private:
+        void run();
+        void tick();
+        void publish();
+        void listen_for_clears();
+        void note_lock();  // tells the undo history about a piece that just locked
+        void play_undos();
+        void save_game();
+
+        static constexpr bool can_undo = std::is_same<Board, GameBoard>::value;
+
+        Board &board;
+        int tick_rate;
+        long long tick_count = 0;
+        int clear_count = 0;
+        std::vector<int> last_cleared_rows;
+        SharedStatePublisher *shared_state = nullptr;
+        Bot *bot = nullptr;
+        int bot_every = 1;
+        Replay *replay = nullptr;
+        UndoHistory *undo_history = nullptr;
+        int pieces_seen = 0;                  // pieces_placed() the undo history knows about
+        std::atomic<int> undo_requests{0};
+        AutosaveWriter *autosave = nullptr;
+        int autosave_every = 1;
+        unsigned autosave_seed = 0;
+        HintEngine *hint_engine = nullptr;
+        int hinted_pieces = -1;               // pieces_placed() the engine was last started on
+        bool max_speed = false;
+        std::chrono::steady_clock::time_point first_tick;
+
+        SPSCQueue<Input, 64> inputs;
+        TripleBuffer<BoardSnapshot> snapshots;
+        std::atomic<bool> running{false};
+        std::thread thread;
+    };
+
+    using Simulation = BasicSimulation<GameBoard>;
+
+}
+#endif // SIMULATION_HPP
@@ -0,0 +1,55 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace tetris
+{
+
+    // A fixed size ring buffer for exactly one producer thread and one consumer thread.
+    // head is only written by the consumer and tail only by the producer, so there are no locks,
+    // each side just publishes its own index. Capacity has to be a power of two so the index
+    // wraps with a mask, and one slot is always left empty to tell full apart from empty
+    template <typename T, std::size_t Capacity>
+    class SPSCQueue
+    {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+    public:
+        // producer side, returns false (and drops the item) if the queue is full
+        bool push(const T &item)
+        {
+            std::size_t t = tail.load(std::memory_order_relaxed);
+            std::size_t next = (t + 1) & (Capacity - 1);
+            if (next == head.load(std::memory_order_acquire))
+                return false;
+            slots[t] = item;
+            tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, returns false if there was nothing to take
+        bool pop(T &item)
+        {
+            std::size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return false;
+            item = slots[h];
+            head.store((h + 1) & (Capacity - 1), std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::array<T, Capacity> slots;
+        alignas(64) std::atomic<std::size_t> head{0}; // next slot to pop
+        alignas(64) std::atomic<std::size_t> tail{0}; // next slot to push
+    };
+
+}
+#endif // SPSC_QUEUE_HPP
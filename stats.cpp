@@ -0,0 +1,166 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace tetris
+{
+
+  namespace
+  {
+    const std::size_t half_count = std::size_t(1) << (Histogram::sub_bucket_bits - 1);
+
+    // bucket 0 holds 0 to 255 one by one, after that every bucket adds another 128 counters
+    const std::size_t counter_count = (Histogram::max_bits - Histogram::sub_bucket_bits + 2) * half_count;
+  }
+
+  Histogram::Histogram() : counts(counter_count, 0) {}
+
+  std::size_t Histogram::index_of(std::uint64_t value)
+  {
+    if (value >> sub_bucket_bits == 0)
+      return static_cast<std::size_t>(value);
+
+    // the bucket is how far the value has to shift to fit in sub_bucket_bits, and what's left after
+    // the shift (always in the top half) picks the sub bucket
+    int bits = 64 - __builtin_clzll(value);
+    int bucket = bits - sub_bucket_bits;
+    return bucket * half_count + static_cast<std::size_t>(value >> bucket);
+  }
+
+  std::uint64_t Histogram::highest_in(std::size_t index)
+  {
+    if (index < 2 * half_count)
+      return index;
+    int bucket = static_cast<int>(index / half_count) - 1;
+    std::uint64_t sub = index - bucket * half_count;
+    return ((sub + 1) << bucket) - 1;
+  }
+
+  void Histogram::record(std::uint64_t value, std::uint64_t count)
+  {
+    const std::uint64_t biggest = (std::uint64_t(1) << max_bits) - 1;
+    if (value > biggest)
+      value = biggest;
+
+    counts[index_of(value)] += count;
+    total += count;
+    sum += value * count;
+    min_value = std::min(min_value, value);
+    max_value = std::max(max_value, value);
+  }
+
+  void Histogram::merge(const Histogram &other)
+  {
+    for (std::size_t i = 0; i < counts.size(); ++i)
+    {
+      counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+  }
+
+  void Histogram::clear()
+  {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sum = 0;
+    min_value = UINT64_MAX;
+    max_value = 0;
+  }
+
+  std::uint64_t Histogram::percentile(double p) const
+  {
+    if (total == 0)
+      return 0;
+    if (p <= 0)
+      return min_value;
+
+    std::uint64_t wanted = static_cast<std::uint64_t>(std::ceil(std::min(p, 100.0) / 100.0 * total));
+    wanted = std::max<std::uint64_t>(wanted, 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i)
+    {
+      seen += counts[i];
+      if (seen >= wanted)
+        return std::min(highest_in(i), max_value);
+    }
+    return max_value;
+  }
+
+  void Histogram::write_csv(std::ostream &out, const std::string &name) const
+  {
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i)
+    {
+      if (!counts[i])
+        continue;
+      seen += counts[i];
+      out << name << ',' << std::min(highest_in(i), max_value) << ',' << counts[i] << ','
+          << 100.0 * seen / total << '\n';
+    }
+  }
+
+  void GameStats::record_game(GameBoard &board, std::uint64_t game_ticks)
+  {
+    score.record(board.get_score());
+    lines.record(board.lines_cleared_count());
+    pieces.record(board.pieces_placed());
+    ticks.record(game_ticks);
+  }
+
+  void GameStats::record_events(EventBus::Reader &events)
+  {
+    Event event;
+    while (events.poll(event))
+    {
+      if (event.type == EventType::LinesCleared)
+        clears.record(event.count);
+    }
+  }
+
+  void GameStats::merge(const GameStats &other)
+  {
+    score.merge(other.score);
+    lines.merge(other.lines);
+    pieces.merge(other.pieces);
+    ticks.merge(other.ticks);
+    move_ns.merge(other.move_ns);
+    clears.merge(other.clears);
+  }
+
+  void GameStats::write_summary(std::ostream &out) const
+  {
+    const std::pair<const char *, const Histogram *> rows[] = {
+        {"score", &score}, {"lines", &lines}, {"pieces", &pieces}, {"ticks", &ticks}, {"move_ns", &move_ns}, {"clears", &clears}};
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-8s %12s %8s %8s %8s %8s %8s %8s %10s\n",
+                  "", "count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+    out << line;
+    for (const auto &row : rows)
+    {
+      const Histogram &h = *row.second;
+      std::snprintf(line, sizeof(line), "%-8s %12llu %8llu %8llu %8llu %8llu %8llu %8llu %10.1f\n", row.first,
+                    static_cast<unsigned long long>(h.count()), static_cast<unsigned long long>(h.min()),
+                    static_cast<unsigned long long>(h.percentile(50)), static_cast<unsigned long long>(h.percentile(90)),
+                    static_cast<unsigned long long>(h.percentile(99)), static_cast<unsigned long long>(h.percentile(99.9)),
+                    static_cast<unsigned long long>(h.max()), h.mean());
+      out << line;
+    }
+  }
+
+  void GameStats::write_csv(std::ostream &out) const
+  {
+    out << "metric,value,count,percentile\n";
+    score.write_csv(out, "score");
+    lines.write_csv(out, "lines");
+    pieces.write_csv(out, "pieces");
+    ticks.write_csv(out, "ticks");
+    move_ns.write_csv(out, "move_ns");
+    clears.write_csv(out, "clears");
+  }
+
+}
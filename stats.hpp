@@ -0,0 +1,77 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "event_bus.hpp"
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // A histogram in the style of HdrHistogram. Values go into buckets that double in size, and each
+    // of those is split into the same number of linear sub buckets, so every value is kept to within
+    // 1 part in 128 of what it really was, from 1 up to 2^42 (73 minutes in nanoseconds). That's a
+    // fixed 4608 counters however many values go in, and two histograms merge by adding counters
+    class Histogram
+    {
+    public:
+        static constexpr int sub_bucket_bits = 8;  // 256 sub buckets, half of them are new in each bucket
+        static constexpr int max_bits = 42;        // bigger values are counted as the biggest one
+
+        Histogram();
+
+        void record(std::uint64_t value, std::uint64_t count = 1);
+        void merge(const Histogram &other);
+        void clear();
+
+        std::uint64_t count() const { return total; }
+        std::uint64_t min() const { return total ? min_value : 0; }
+        std::uint64_t max() const { return max_value; }
+        double mean() const { return total ? static_cast<double>(sum) / total : 0.0; }
+
+        // the value that p percent of what was recorded is at or below (to within the precision)
+        std::uint64_t percentile(double p) const;
+
+        // one row per bucket that has anything in it: name,value,count,percentile
+        // (value is the top of the bucket and percentile is how much is at or below it)
+        void write_csv(std::ostream &out, const std::string &name) const;
+
+        // which counter a value goes in, and the biggest value that goes in the same one
+        static std::size_t index_of(std::uint64_t value);
+        static std::uint64_t highest_in(std::size_t index);
+
+    private:
+        std::vector<std::uint64_t> counts;
+        std::uint64_t total = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t min_value = UINT64_MAX;
+        std::uint64_t max_value = 0;
+    };
+
+    // What a batch of games looked like. Each thread fills its own and they're merged at the end,
+    // so recording is a few increments with nothing shared
+    struct GameStats
+    {
+        Histogram score;
+        Histogram lines;
+        Histogram pieces;  // pieces locked before the game ended
+        Histogram ticks;   // how long the game went, in moves
+        Histogram move_ns; // how long each move took to pick and play
+        Histogram clears;  // rows each clear took at once, from the board's LinesCleared events
+
+        // the totals of a finished game, the move times go straight into move_ns
+        void record_game(GameBoard &board, std::uint64_t game_ticks);
+        // takes everything the board has published since the last call off its bus
+        void record_events(EventBus::Reader &events);
+        void merge(const GameStats &other);
+
+        // a table of count, min, percentiles, max and mean for each histogram
+        void write_summary(std::ostream &out) const;
+        void write_csv(std::ostream &out) const;
+    };
+
+}
+#endif // STATS_HPP
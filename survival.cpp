@@ -0,0 +1,817 @@
+#include "survival.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tetris
+{
+
+  namespace
+  {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::uint32_t magic_value = 0x56525354; // "TSRV" in a little endian file
+    const std::uint16_t current_version = 1;
+    const std::size_t max_fan_in = 64;            // runs merged at once, each one is an open file
+
+    // what's at the start of a table, the piles come straight after it (it's a multiple of 8 so
+    // they're lined up), then a byte of flags for each of them, then a byte of chance
+    struct SurvivalHeader
+    {
+      std::uint32_t magic;
+      std::uint16_t version;
+      std::uint8_t width;
+      std::uint8_t rows;
+      std::uint32_t horizon;
+      std::uint32_t reserved;
+      std::uint64_t count;
+    };
+    static_assert(sizeof(SurvivalHeader) == 24, "the header is written as it is");
+
+    const std::uint8_t flag_survives = 1;
+
+    // the solver's files all go in a directory of their own, which goes when it's done (or gives
+    // up). it keeps count of how much they take up, the runs come and go a lot
+    class WorkDir
+    {
+    public:
+      explicit WorkDir(const std::string &parent) : path(parent + "/tetris_solve." + std::to_string(getpid()))
+      {
+        if (mkdir(path.c_str(), 0700) != 0)
+          throw std::runtime_error("Cannot make the work directory " + path);
+      }
+
+      ~WorkDir()
+      {
+        for (const std::string &file : files)
+          std::remove(file.c_str());
+        rmdir(path.c_str());
+      }
+
+      std::string file(const std::string &name)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        files.push_back(path + "/" + name);
+        return files.back();
+      }
+
+      // after a file is closed, so its size counts
+      void written(const std::string &file)
+      {
+        struct stat info;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stat(file.c_str(), &info) == 0)
+          live += info.st_size;
+        peak = std::max(peak, live);
+      }
+
+      void remove(const std::string &file)
+      {
+        struct stat info;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stat(file.c_str(), &info) == 0)
+          live -= info.st_size;
+        std::remove(file.c_str());
+      }
+
+      std::uint64_t peak_bytes() const { return peak; }
+
+    private:
+      std::string path;
+      std::vector<std::string> files;
+      std::uint64_t live = 0;
+      std::uint64_t peak = 0;
+      std::mutex mutex;
+    };
+
+    // numbers to a file in the order they come, a buffer at a time
+    template <typename T>
+    class FileWriter
+    {
+    public:
+      explicit FileWriter(const std::string &path) : path(path), file(std::fopen(path.c_str(), "wb"))
+      {
+        if (!file)
+          throw std::runtime_error("Cannot write " + path);
+        buffer.reserve(buffer_size);
+      }
+
+      ~FileWriter()
+      {
+        if (file)
+          std::fclose(file);
+      }
+
+      void put(T value)
+      {
+        buffer.push_back(value);
+        if (buffer.size() == buffer_size)
+          flush();
+      }
+
+      void put(const T *values, std::size_t count)
+      {
+        flush();
+        if (count && std::fwrite(values, sizeof(T), count, file) != count)
+          throw std::runtime_error("Cannot write " + path);
+      }
+
+      void close()
+      {
+        flush();
+        int closed = std::fclose(file);
+        file = nullptr;
+        if (closed != 0)
+          throw std::runtime_error("Cannot write " + path);
+      }
+
+    private:
+      static constexpr std::size_t buffer_size = 1 << 16;
+
+      void flush()
+      {
+        if (!buffer.empty() && std::fwrite(buffer.data(), sizeof(T), buffer.size(), file) != buffer.size())
+          throw std::runtime_error("Cannot write " + path);
+        buffer.clear();
+      }
+
+      std::string path;
+      std::FILE *file;
+      std::vector<T> buffer;
+    };
+
+    // and back, starting from the first'th number
+    template <typename T>
+    class FileReader
+    {
+    public:
+      explicit FileReader(const std::string &path, std::uint64_t first = 0) : file(std::fopen(path.c_str(), "rb"))
+      {
+        if (!file || std::fseek(file, static_cast<long>(first * sizeof(T)), SEEK_SET) != 0)
+        {
+          if (file)
+            std::fclose(file);
+          throw std::runtime_error("Cannot read " + path);
+        }
+        buffer.resize(buffer_size);
+      }
+
+      ~FileReader() { std::fclose(file); }
+
+      bool next(T &value)
+      {
+        if (at == filled)
+        {
+          filled = std::fread(buffer.data(), sizeof(T), buffer_size, file);
+          at = 0;
+          if (!filled)
+            return false;
+        }
+        value = buffer[at++];
+        return true;
+      }
+
+    private:
+      static constexpr std::size_t buffer_size = 1 << 16;
+
+      std::FILE *file;
+      std::vector<T> buffer;
+      std::size_t at = 0;
+      std::size_t filled = 0;
+    };
+
+    void write_numbers(WorkDir &work, const std::string &path, const std::vector<std::uint64_t> &values)
+    {
+      FileWriter<std::uint64_t> out(path);
+      out.put(values.data(), values.size());
+      out.close();
+      work.written(path);
+    }
+
+    // takes numbers in any order and writes them out sorted, without repeats, capacity at a time
+    class RunSorter
+    {
+    public:
+      RunSorter(WorkDir &work, const std::string &name, std::size_t capacity)
+          : work(work), name(name), capacity(capacity)
+      {
+      }
+
+      void add(std::uint64_t value)
+      {
+        buffer.push_back(value);
+        if (buffer.size() == capacity)
+          spill();
+      }
+
+      std::vector<std::string> finish()
+      {
+        spill();
+        std::vector<std::uint64_t>().swap(buffer);
+        return runs;
+      }
+
+    private:
+      void spill()
+      {
+        if (buffer.empty())
+          return;
+        std::sort(buffer.begin(), buffer.end());
+        buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+        runs.push_back(work.file(name + "." + std::to_string(runs.size())));
+        write_numbers(work, runs.back(), buffer);
+        buffer.clear();
+      }
+
+      WorkDir &work;
+      std::string name;
+      std::size_t capacity;
+      std::vector<std::uint64_t> buffer;
+      std::vector<std::string> runs;
+    };
+
+    // the sorted files merged into out without repeats, and without anything in the sorted file
+    // minus (if there is one). returns how many numbers out got. it doesn't touch the inputs
+    std::uint64_t merge_files(WorkDir &work, const std::vector<std::string> &inputs, const std::string &out,
+                              const std::string &minus = std::string())
+    {
+      typedef std::pair<std::uint64_t, std::size_t> Head;
+      std::vector<std::unique_ptr<FileReader<std::uint64_t>>> readers;
+      std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+      for (const std::string &input : inputs)
+      {
+        readers.emplace_back(new FileReader<std::uint64_t>(input));
+        std::uint64_t value;
+        if (readers.back()->next(value))
+          heads.push({value, readers.size() - 1});
+      }
+
+      std::unique_ptr<FileReader<std::uint64_t>> skip;
+      std::uint64_t skip_value = 0;
+      bool skipping = false;
+      if (!minus.empty())
+      {
+        skip.reset(new FileReader<std::uint64_t>(minus));
+        skipping = skip->next(skip_value);
+      }
+
+      FileWriter<std::uint64_t> writer(out);
+      std::uint64_t written = 0;
+      bool any = false;
+      std::uint64_t last = 0;
+      while (!heads.empty())
+      {
+        Head head = heads.top();
+        heads.pop();
+        std::uint64_t value;
+        if (readers[head.second]->next(value))
+          heads.push({value, head.second});
+
+        if (any && head.first == last)
+          continue;
+        any = true;
+        last = head.first;
+        while (skipping && skip_value < head.first)
+          skipping = skip->next(skip_value);
+        if (skipping && skip_value == head.first)
+          continue;
+        writer.put(head.first);
+        ++written;
+      }
+      writer.close();
+      work.written(out);
+      return written;
+    }
+
+    // merges runs into out, a few at a time when there are more than can be open at once. the runs are removed
+    std::uint64_t merge_runs(WorkDir &work, std::vector<std::string> runs, const std::string &out,
+                             const std::string &minus = std::string())
+    {
+      std::size_t rounds = 0;
+      while (runs.size() > max_fan_in)
+      {
+        std::vector<std::string> group(runs.begin(), runs.begin() + max_fan_in);
+        runs.erase(runs.begin(), runs.begin() + max_fan_in);
+        runs.push_back(work.file("round." + std::to_string(rounds++)));
+        merge_files(work, group, runs.back());
+        for (const std::string &run : group)
+          work.remove(run);
+      }
+      std::uint64_t written = merge_files(work, runs, out, minus);
+      for (const std::string &run : runs)
+        work.remove(run);
+      return written;
+    }
+
+    // job(t) on each of threads threads, and the first thing any of them threw is thrown again here
+    template <typename Job>
+    void run_threads(int threads, Job job)
+    {
+      std::vector<std::thread> workers;
+      std::vector<std::exception_ptr> errors(threads);
+      for (int t = 0; t < threads; ++t)
+      {
+        auto guarded = [&, t]
+        {
+          try
+          {
+            job(t);
+          }
+          catch (...)
+          {
+            errors[t] = std::current_exception();
+          }
+        };
+        workers.emplace_back(guarded);
+      }
+      for (std::thread &worker : workers)
+        worker.join();
+      for (std::exception_ptr &error : errors)
+      {
+        if (error)
+          std::rethrow_exception(error);
+      }
+    }
+
+    // thread t's share of count things
+    std::uint64_t share_start(std::uint64_t count, int t, int threads)
+    {
+      return count * t / threads;
+    }
+
+    double since(Clock::time_point start)
+    {
+      return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    const std::uint8_t *map_table(const std::string &path, std::size_t &size)
+    {
+      int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+        throw std::runtime_error("Cannot open " + path);
+      struct stat info;
+      if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(SurvivalHeader))
+      {
+        ::close(fd);
+        throw std::runtime_error(path + " is too short to be a survival table");
+      }
+      size = info.st_size;
+      void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd); // the mapping keeps the file
+      if (memory == MAP_FAILED)
+        throw std::runtime_error("Cannot map " + path);
+
+      const SurvivalHeader *head = static_cast<const SurvivalHeader *>(memory);
+      bool fits = head->magic == magic_value && head->version == current_version && head->width >= 4 &&
+                  head->width <= 16 && head->rows >= 1 && head->width * head->rows <= 64 &&
+                  sizeof(SurvivalHeader) + head->count * (sizeof(PileState) + 2) == size;
+      if (!fits)
+      {
+        munmap(memory, size);
+        throw std::runtime_error(path + " is not a survival table this version understands");
+      }
+      return static_cast<const std::uint8_t *>(memory);
+    }
+  }
+
+  SurvivalRules::SurvivalRules(int width, int rows) : w(width), r(rows)
+  {
+    if (width < 4 || width > 16 || rows < 1 || width * rows > 64)
+      throw std::invalid_argument("the survival solver needs a width from 4 to 16 and width * rows up to 64");
+
+    // the turns are GameBoard's own, the standard set's, and the ones that come out the same as
+    // one before (O always, I, S and Z every other time) are left out
+    const PieceSet &standard = PieceSet::standard();
+    for (int piece = 1; piece <= 7; ++piece)
+    {
+      for (int turn = 0; turn < 4; ++turn)
+      {
+        const PieceShape &shape = standard.shape(piece, turn);
+        int top = shape.size, bottom = -1, left = shape.size, right = -1;
+        for (int i = 0; i < shape.cell_count; ++i)
+        {
+          top = std::min(top, int(shape.cells_y[i]));
+          bottom = std::max(bottom, int(shape.cells_y[i]));
+          left = std::min(left, int(shape.cells_x[i]));
+          right = std::max(right, int(shape.cells_x[i]));
+        }
+
+        Orientation orientation = {{0, 0, 0, 0}, bottom - top + 1, right - left + 1};
+        for (int y = top; y <= bottom; ++y)
+          orientation.rows[bottom - y] = shape.rows[y] >> left;
+        bool seen = false;
+        for (const Orientation &other : orientations[piece])
+        {
+          seen = seen || (other.width == orientation.width &&
+                          std::equal(other.rows, other.rows + 4, orientation.rows));
+        }
+        if (!seen)
+          orientations[piece].push_back(orientation);
+      }
+    }
+
+    reversed.resize(std::size_t(1) << w);
+    for (std::uint32_t row = 0; row < reversed.size(); ++row)
+    {
+      for (int x = 0; x < w; ++x)
+      {
+        if (row >> x & 1)
+          reversed[row] |= 1u << (w - 1 - x);
+      }
+    }
+  }
+
+  void SurvivalRules::successors(PileState pile, int piece, std::vector<PileState> &out) const
+  {
+    out.clear();
+    const std::uint32_t full = (1u << w) - 1;
+    // the pile's rows with room for a piece above them, 16 is the most rows there can be
+    std::uint32_t start[16 + 4] = {};
+    for (int y = 0; y < r; ++y)
+      start[y] = pile >> (y * w) & full;
+
+    for (const Orientation &orientation : orientations[piece])
+    {
+      for (int x = 0; x + orientation.width <= w; ++x)
+      {
+        // comes down from just above the cap until the row below is in the way
+        int y = r;
+        for (; y > 0; --y)
+        {
+          bool blocked = false;
+          for (int i = 0; i < orientation.height; ++i)
+            blocked = blocked || (start[y - 1 + i] & orientation.rows[i] << x);
+          if (blocked)
+            break;
+        }
+
+        std::uint32_t rows[16 + 4];
+        std::copy(start, start + r + 4, rows);
+        for (int i = 0; i < orientation.height; ++i)
+          rows[y + i] |= orientation.rows[i] << x;
+
+        // full rows go, the rest drop down, and anything that's left above the cap loses
+        PileState next = 0;
+        int kept = 0;
+        bool over = false;
+        for (int row = 0; row < r + 4 && !over; ++row)
+        {
+          if (rows[row] == full)
+            continue;
+          if (kept < r)
+            next |= PileState(rows[row]) << (kept++ * w);
+          else
+            over = rows[row] != 0;
+        }
+        if (!over)
+          out.push_back(canonical(next));
+      }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+  }
+
+  PileState SurvivalRules::mirror(PileState pile) const
+  {
+    const std::uint32_t full = (1u << w) - 1;
+    PileState mirrored = 0;
+    for (int y = 0; y < r; ++y)
+      mirrored |= PileState(reversed[pile >> (y * w) & full]) << (y * w);
+    return mirrored;
+  }
+
+  bool SurvivalRules::from_board(GameBoard &board, PileState &pile) const
+  {
+    if (board.getWidth() != w)
+      return false;
+    int height = board.getHeight();
+    const Grid &grid = board.getGameState();
+    pile = 0;
+    for (int y = 0; y < height; ++y)
+    {
+      int row = height - 1 - y; // from the floor up
+      for (int x = 0; x < w; ++x)
+      {
+        if (!grid[y][x])
+          continue;
+        if (row >= r)
+          return false;
+        pile |= PileState(1) << (row * w + x);
+      }
+    }
+    return true;
+  }
+
+  SolverStats solve_survival(const SolverOptions &options, std::ostream &log)
+  {
+    SurvivalRules rules(options.width, options.rows);
+    int threads = std::max(1, options.threads);
+    // each thread sorts its own runs
+    std::size_t capacity = std::max<std::size_t>(64, options.memory / sizeof(PileState) / threads);
+    auto started = Clock::now();
+    SolverStats stats;
+    WorkDir work(options.work_dir);
+
+    // every pile the empty board can get to, a piece at a time. the level is the piles that were
+    // new last time round, what they lead to is merged without the ones already known
+    std::string all = work.file("piles.0");
+    std::string level = work.file("level.0");
+    write_numbers(work, all, {0});
+    write_numbers(work, level, {0});
+    std::uint64_t level_count = 1;
+    stats.states = 1;
+    for (int depth = 1; level_count; ++depth)
+    {
+      auto start = Clock::now();
+      std::vector<std::vector<std::string>> runs(threads);
+      auto expand = [&](int t)
+      {
+        std::uint64_t first = share_start(level_count, t, threads);
+        std::uint64_t last = share_start(level_count, t + 1, threads);
+        FileReader<PileState> in(level, first);
+        RunSorter sorter(work, "next." + std::to_string(depth) + "." + std::to_string(t), capacity);
+        std::vector<PileState> moves;
+        PileState pile;
+        for (std::uint64_t i = first; i < last && in.next(pile); ++i)
+        {
+          for (int piece = 1; piece <= 7; ++piece)
+          {
+            rules.successors(pile, piece, moves);
+            for (PileState next : moves)
+              sorter.add(next);
+          }
+        }
+        runs[t] = sorter.finish();
+      };
+      run_threads(threads, expand);
+
+      std::vector<std::string> all_runs;
+      for (const std::vector<std::string> &thread_runs : runs)
+        all_runs.insert(all_runs.end(), thread_runs.begin(), thread_runs.end());
+      std::size_t run_count = all_runs.size();
+      std::string next_level = work.file("level." + std::to_string(depth));
+      level_count = merge_runs(work, all_runs, next_level, all);
+      work.remove(level);
+      level = next_level;
+
+      std::string next_all = work.file("piles." + std::to_string(depth));
+      stats.states = merge_files(work, {all, level}, next_all);
+      work.remove(all);
+      all = next_all;
+      if (level_count)
+      {
+        stats.levels = depth;
+        log << "level " << depth << ": " << level_count << " new piles from " << run_count << " sorted run(s), "
+            << stats.states << " in all (" << since(start) << "s)" << std::endl;
+      }
+    }
+    work.remove(level);
+
+    std::uint64_t count = stats.states;
+    if (count * 7 > UINT32_MAX)
+      throw std::runtime_error("too many piles for the solver to number them all");
+    std::vector<PileState> piles(count);
+    {
+      FileReader<PileState> in(all);
+      for (PileState &pile : piles)
+        in.next(pile);
+    }
+
+    // the moves, forwards as (count, then the pile numbers) for every (pile, piece) into a file per
+    // thread, and backwards as (to << 32 | from * 7 + piece - 1), sorted, so every pile's moves into it are together
+    auto start = Clock::now();
+    std::vector<std::uint8_t> moves_left(count * 7);
+    std::vector<std::string> forward(threads);
+    std::vector<std::vector<std::string>> back_runs(threads);
+    std::atomic<std::uint64_t> edges{0};
+    auto list_moves = [&](int t)
+    {
+      std::uint64_t first = share_start(count, t, threads);
+      std::uint64_t last = share_start(count, t + 1, threads);
+      forward[t] = work.file("forward." + std::to_string(t));
+      FileWriter<std::uint32_t> out(forward[t]);
+      RunSorter sorter(work, "back." + std::to_string(t), capacity);
+      std::vector<PileState> moves;
+      std::uint64_t made = 0;
+      for (std::uint64_t i = first; i < last; ++i)
+      {
+        for (int piece = 1; piece <= 7; ++piece)
+        {
+          rules.successors(piles[i], piece, moves);
+          std::uint64_t from = i * 7 + piece - 1;
+          moves_left[from] = static_cast<std::uint8_t>(moves.size());
+          out.put(static_cast<std::uint32_t>(moves.size()));
+          for (PileState next : moves)
+          {
+            // everything a known pile leads to is known, that's how they were found
+            std::uint64_t to = std::lower_bound(piles.begin(), piles.end(), next) - piles.begin();
+            out.put(static_cast<std::uint32_t>(to));
+            sorter.add(to << 32 | from);
+          }
+          made += moves.size();
+        }
+      }
+      out.close();
+      work.written(forward[t]);
+      back_runs[t] = sorter.finish();
+      edges.fetch_add(made);
+    };
+    run_threads(threads, list_moves);
+    stats.edges = edges.load();
+
+    std::vector<std::string> all_back;
+    for (const std::vector<std::string> &thread_runs : back_runs)
+      all_back.insert(all_back.end(), thread_runs.begin(), thread_runs.end());
+    std::string back = work.file("back");
+    merge_runs(work, all_back, back);
+    log << "moves: " << stats.edges << " between " << count << " piles (" << since(start) << "s)" << std::endl;
+
+    // retrograde analysis, the piles that are lost whatever is played are found first and every
+    // one of them takes a move away from the piles that lead to it. it goes a pile at a time
+    // (every loss depends on the ones before it), reading the backwards moves straight off the disk
+    start = Clock::now();
+    std::vector<std::uint64_t> first_back(count + 1, 0);
+    {
+      FileReader<std::uint64_t> in(back);
+      std::uint64_t edge;
+      while (in.next(edge))
+        ++first_back[(edge >> 32) + 1];
+      for (std::uint64_t i = 0; i < count; ++i)
+        first_back[i + 1] += first_back[i];
+    }
+
+    std::vector<std::uint8_t> lost(count, 0);
+    std::vector<std::uint32_t> losing;
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+      for (int piece = 0; piece < 7 && !lost[i]; ++piece)
+      {
+        if (!moves_left[i * 7 + piece])
+        {
+          lost[i] = 1;
+          losing.push_back(static_cast<std::uint32_t>(i));
+        }
+      }
+    }
+    if (stats.edges)
+    {
+      std::size_t back_bytes = stats.edges * sizeof(std::uint64_t);
+      int fd = open(back.c_str(), O_RDONLY | O_CLOEXEC);
+      void *memory = fd < 0 ? MAP_FAILED : mmap(nullptr, back_bytes, PROT_READ, MAP_SHARED, fd, 0);
+      if (fd >= 0)
+        ::close(fd);
+      if (memory == MAP_FAILED)
+        throw std::runtime_error("Cannot map " + back);
+      const std::uint64_t *back_edges = static_cast<const std::uint64_t *>(memory);
+
+      while (!losing.empty())
+      {
+        std::uint32_t pile = losing.back();
+        losing.pop_back();
+        for (std::uint64_t e = first_back[pile]; e < first_back[pile + 1]; ++e)
+        {
+          std::uint32_t from = static_cast<std::uint32_t>(back_edges[e]);
+          std::uint32_t before = from / 7;
+          if (!lost[before] && --moves_left[from] == 0)
+          {
+            lost[before] = 1;
+            losing.push_back(before);
+          }
+        }
+      }
+      munmap(memory, back_bytes);
+    }
+    work.remove(back);
+    std::vector<std::uint64_t>().swap(first_back);
+    std::vector<std::uint8_t>().swap(moves_left);
+    for (std::uint8_t pile_lost : lost)
+      stats.survivors += !pile_lost;
+    log << "worst case: " << stats.survivors << " of " << count << " piles survive forever (" << since(start) << "s)"
+        << std::endl;
+
+    // random pieces: chance[n] of a pile is the chance of getting through n more pieces, 1 for n = 0,
+    // and for n + 1 it's the average over the pieces of the best chance[n] one of the moves gets to.
+    // every pass is the threads going through their own forward files
+    start = Clock::now();
+    std::vector<float> chance(count, 1.0f);
+    std::vector<float> next_chance(count);
+    for (int pass = 0; pass < options.horizon; ++pass)
+    {
+      auto step = [&](int t)
+      {
+        std::uint64_t first = share_start(count, t, threads);
+        std::uint64_t last = share_start(count, t + 1, threads);
+        FileReader<std::uint32_t> in(forward[t]);
+        for (std::uint64_t i = first; i < last; ++i)
+        {
+          float total = 0;
+          for (int piece = 0; piece < 7; ++piece)
+          {
+            std::uint32_t moves = 0, to = 0;
+            in.next(moves);
+            float best = 0;
+            for (std::uint32_t m = 0; m < moves; ++m)
+            {
+              in.next(to);
+              best = std::max(best, chance[to]);
+            }
+            total += best;
+          }
+          next_chance[i] = total / 7;
+        }
+      };
+      run_threads(threads, step);
+      chance.swap(next_chance);
+    }
+    for (const std::string &file : forward)
+      work.remove(file);
+    log << "random pieces: " << options.horizon << " pieces ahead (" << since(start) << "s)" << std::endl;
+
+    // the table, written next to where it goes and renamed into place when it's all there
+    std::string temporary = options.out + ".tmp";
+    try
+    {
+      SurvivalHeader header = {magic_value, current_version, static_cast<std::uint8_t>(options.width),
+                               static_cast<std::uint8_t>(options.rows), static_cast<std::uint32_t>(options.horizon),
+                               0, count};
+      FileWriter<std::uint8_t> out(temporary);
+      out.put(reinterpret_cast<const std::uint8_t *>(&header), sizeof(header));
+      out.put(reinterpret_cast<const std::uint8_t *>(piles.data()), count * sizeof(PileState));
+      for (std::uint8_t pile_lost : lost)
+        out.put(pile_lost ? 0 : flag_survives);
+      for (std::uint64_t i = 0; i < count; ++i)
+      {
+        // 255 is kept for the ones that are sure to make it, a near miss rounds down
+        int quantized = static_cast<int>(chance[i] * 255 + 0.5f);
+        out.put(static_cast<std::uint8_t>(lost[i] ? std::min(quantized, 254) : 255));
+      }
+      out.close();
+    }
+    catch (const std::runtime_error &)
+    {
+      std::remove(temporary.c_str());
+      throw;
+    }
+    if (std::rename(temporary.c_str(), options.out.c_str()) != 0)
+    {
+      std::remove(temporary.c_str());
+      throw std::runtime_error("Cannot write " + options.out);
+    }
+
+    stats.disk_bytes = work.peak_bytes();
+    stats.seconds = since(started);
+    return stats;
+  }
+
+  SurvivalTable::SurvivalTable(const std::string &path)
+      : base(map_table(path, size_bytes)),
+        table_rules(base[6], base[7])
+  {
+    const SurvivalHeader *head = reinterpret_cast<const SurvivalHeader *>(base);
+    table_horizon = static_cast<int>(head->horizon);
+    count = head->count;
+    states = reinterpret_cast<const PileState *>(base + sizeof(SurvivalHeader));
+    flags = base + sizeof(SurvivalHeader) + count * sizeof(PileState);
+    chances = flags + count;
+  }
+
+  SurvivalTable::~SurvivalTable()
+  {
+    munmap(const_cast<std::uint8_t *>(base), size_bytes);
+  }
+
+  SurvivalAnswer SurvivalTable::lookup(PileState pile) const
+  {
+    SurvivalAnswer answer;
+    pile = table_rules.canonical(pile);
+    const PileState *found = std::lower_bound(states, states + count, pile);
+    if (found == states + count || *found != pile)
+      return answer;
+    std::size_t i = found - states;
+    answer.known = true;
+    answer.survives = flags[i] & flag_survives;
+    answer.chance = chances[i] / 255.0;
+    return answer;
+  }
+
+  SurvivalAnswer SurvivalTable::query(GameBoard &board) const
+  {
+    PileState pile;
+    if (!table_rules.from_board(board, pile))
+      return SurvivalAnswer();
+    return lookup(pile);
+  }
+
+}
@@ -0,0 +1,133 @@
+#ifndef SURVIVAL_HPP
+#define SURVIVAL_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // A pile in the bottom rows of a board, bit-packed: row r counting up from the floor is bits
+    // r * width to r * width + width - 1, and column x is bit x of its row
+    typedef std::uint64_t PileState;
+
+    // The game the survival solver works on: a board width wide whose pile has to stay inside its
+    // bottom rows rows. As long as it does, the top of the board is empty, so every turn of the
+    // piece and every column it fits in can be got to from wherever it spawns, and a placement is
+    // an orientation and a column to drop it straight down from. A pile that can be kept under the
+    // cap forever can be kept on the real board forever, so what the solver calls survivable
+    // really is (a pile that has to go over the cap for a while and comes back is missed)
+    class SurvivalRules
+    {
+    public:
+        SurvivalRules(int width, int rows); // throws std::invalid_argument unless 4 <= width <= 16 and width * rows <= 64
+
+        int width() const { return w; }
+        int rows() const { return r; }
+
+        // the piles piece (1 to 7, the color numbers) can leave on pile, in canonical form and
+        // without repeats. placements that go over the cap aren't in it, out is cleared first
+        void successors(PileState pile, int piece, std::vector<PileState> &out) const;
+
+        PileState mirror(PileState pile) const;
+
+        // the smaller of the pile and its mirror image. mirroring swaps S with Z and L with J and
+        // the pieces all come up alike, so a pile and its mirror image go the same way
+        PileState canonical(PileState pile) const { return std::min(pile, mirror(pile)); }
+
+        // the board's pile, false if the board is another width or has something above the cap
+        bool from_board(GameBoard &board, PileState &pile) const;
+
+    private:
+        struct Orientation
+        {
+            std::uint32_t rows[4]; // the piece's rows from its bottom up, column 0 is bit 0
+            int height;
+            int width;
+        };
+
+        int w;
+        int r;
+        std::vector<Orientation> orientations[8];  // the distinct ones of each piece
+        std::vector<std::uint32_t> reversed;       // a row mirrored, for every row there can be
+    };
+
+    struct SolverOptions
+    {
+        int width = 7;
+        int rows = 4;
+        int threads = 1;
+        int horizon = 100;                  // how many pieces the random sequence chances look ahead
+        std::size_t memory = 1ull << 30;    // bytes of states it sorts in memory before they go to disk
+        std::string work_dir = "/tmp";      // where the sorted runs and edges go while it works
+        std::string out = "survival.tbl";   // the table
+    };
+
+    struct SolverStats
+    {
+        std::uint64_t states = 0;     // canonical piles that can be got to from the empty board
+        std::uint64_t edges = 0;      // (pile, piece) to pile moves, without repeats
+        std::uint64_t survivors = 0;  // piles that last forever whatever pieces come
+        std::uint64_t disk_bytes = 0; // the most the work files took up at once
+        int levels = 0;               // pieces it took to get to the last new pile
+        double seconds = 0;
+    };
+
+    // Works the whole game out and writes the table. It goes in passes, each one spread over the
+    // threads, with everything that can get big in sorted files of states on disk:
+    //  - every pile the empty board can get to, a level (a piece) at a time. each thread writes
+    //    what its share of the level leads to as sorted runs, and the runs are merged, without
+    //    the piles that were already known, into the next level and into the file of them all
+    //  - the moves between them, forwards (a file per thread, read back by the last pass) and
+    //    backwards, sorted by the pile they lead to
+    //  - retrograde analysis for the worst case: every (pile, piece) starts with its number of
+    //    moves that stay under the cap, a pile with a piece that has none is lost, and every lost
+    //    pile takes one off the moves of each pile that leads to it, losing those that get to
+    //    none. what's never lost can go on forever against the worst pieces there are
+    //  - for random pieces, the chance of getting through the next horizon pieces playing as well
+    //    as can be, a pass per piece over the forward moves
+    // The steps go to log as they finish. throws std::runtime_error when a file can't be made
+    SolverStats solve_survival(const SolverOptions &options, std::ostream &log);
+
+    struct SurvivalAnswer
+    {
+        bool known = false;    // false when the table doesn't have the pile
+        bool survives = false; // lasts forever under the cap whatever the pieces are
+        double chance = 0;     // of lasting the table's horizon under random pieces
+    };
+
+    // The table solve_survival writes, memory mapped: the piles (sorted, so a lookup is a binary
+    // search) and what's known about each of them. Bots can ask it about the pile a placement leaves
+    class SurvivalTable
+    {
+    public:
+        explicit SurvivalTable(const std::string &path); // throws std::runtime_error
+        ~SurvivalTable();
+
+        SurvivalTable(const SurvivalTable &) = delete;
+        SurvivalTable &operator=(const SurvivalTable &) = delete;
+
+        const SurvivalRules &rules() const { return table_rules; }
+        std::uint64_t size() const { return count; }
+        int horizon() const { return table_horizon; }
+
+        SurvivalAnswer lookup(PileState pile) const; // canonical or not
+        SurvivalAnswer query(GameBoard &board) const;
+
+    private:
+        std::size_t size_bytes = 0;
+        const std::uint8_t *base = nullptr; // the mapping comes first, the rules are read out of it
+        SurvivalRules table_rules;
+        int table_horizon = 0;
+        std::uint64_t count = 0;
+        const PileState *states = nullptr;
+        const std::uint8_t *flags = nullptr;
+        const std::uint8_t *chances = nullptr; // 255 is certain
+    };
+
+}
+#endif // SURVIVAL_HPP
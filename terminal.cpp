@@ -0,0 +1,336 @@
+#include "terminal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // the nearest of the 6x6x6 color cube in the 256 color palette
+    int palette_index(const sf::Color &color)
+    {
+      auto level = [](int value)
+      { return (value * 5 + 127) / 255; };
+      return 16 + 36 * level(color.r) + 6 * level(color.g) + level(color.b);
+    }
+
+    void write_all(int fd, const char *data, std::size_t size)
+    {
+      while (size > 0)
+      {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return; // the terminal went away, there's nobody to tell
+        }
+        data += written;
+        size -= written;
+      }
+    }
+  }
+
+  TerminalRenderer::TerminalRenderer(int height, int width, int fd)
+      : height(height), width(width), fd(fd), shown(height * width, 0), next(height * width, 0)
+  {
+    // the worst frame is a full redraw where every cell needs a move and a color (about 25 bytes),
+    // plus the border and the status line
+    out.resize(static_cast<std::size_t>(height + 4) * (width + 2) * 32 + 256);
+
+    color_codes[0] = "\x1b[0m";
+    for (int color = 1; color <= PieceSet::max_pieces; ++color)
+    {
+      color_codes[color] = "\x1b[48;5;" + std::to_string(palette_index(palette(color))) + "m";
+    }
+  }
+
+  void TerminalRenderer::draw(const BoardSnapshot &snap)
+  {
+    used = 0;
+
+    // this frame's cells, the pile and then the falling piece over it
+    for (int y = 0; y < height; ++y)
+    {
+      const std::vector<int> &row = snap.grid[y];
+      for (int x = 0; x < width; ++x)
+        next[y * width + x] = static_cast<std::uint8_t>(row[x]);
+    }
+    int box = snap.shape.size;
+    for (int y = 0; y < box; ++y)
+    {
+      for (int x = 0; x < box; ++x)
+      {
+        int cell_x = snap.b_x + x;
+        int cell_y = snap.b_y + y;
+        if (snap.shape.has(y, x) && cell_x >= 0 && cell_x < width && cell_y >= 0 && cell_y < height)
+          next[cell_y * width + cell_x] = static_cast<std::uint8_t>(snap.block);
+      }
+    }
+
+    bool redrawing = full;
+    if (full)
+    {
+      put("\x1b[0m\x1b[2J");
+      current_color = 0;
+      cursor_row = -1;
+      draw_frame_border();
+    }
+
+    // the board starts at row 2, column 2 (inside the border), a cell is two columns wide
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        int i = y * width + x;
+        if (!full && next[i] == shown[i])
+          continue;
+        move_cursor(y + 2, 2 * x + 2);
+        set_color(next[i]);
+        put("  ", 2);
+        cursor_column += 2;
+        shown[i] = next[i];
+      }
+    }
+    draw_status(snap);
+    full = false;
+
+    flush();
+    if (redrawing)
+      full_bytes = used;
+  }
+
+  void TerminalRenderer::put(const char *text, std::size_t size)
+  {
+    // can't run out, the buffer is sized for the worst frame, but a cut frame beats a crash
+    size = std::min(size, out.size() - used);
+    std::memcpy(out.data() + used, text, size);
+    used += size;
+  }
+
+  void TerminalRenderer::put(const char *text)
+  {
+    put(text, std::strlen(text));
+  }
+
+  void TerminalRenderer::put_number(int value)
+  {
+    char digits[12];
+    int count = 0;
+    unsigned magnitude = value < 0 ? 0u - static_cast<unsigned>(value) : static_cast<unsigned>(value);
+    do
+    {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+      put("-", 1);
+    while (count > 0)
+      put(&digits[--count], 1);
+  }
+
+  void TerminalRenderer::move_cursor(int row, int column)
+  {
+    if (row == cursor_row && column == cursor_column)
+      return;
+    put("\x1b[", 2);
+    put_number(row);
+    put(";", 1);
+    put_number(column);
+    put("H", 1);
+    cursor_row = row;
+    cursor_column = column;
+  }
+
+  void TerminalRenderer::set_color(int color)
+  {
+    if (color == current_color)
+      return;
+    put(color_codes[color].data(), color_codes[color].size());
+    current_color = color;
+  }
+
+  void TerminalRenderer::draw_frame_border()
+  {
+    set_color(0);
+    for (int row = 1; row <= height + 2; ++row)
+    {
+      bool edge = row == 1 || row == height + 2;
+      move_cursor(row, 1);
+      put(edge ? "+" : "|", 1);
+      if (edge)
+      {
+        for (int x = 0; x < 2 * width; ++x)
+          put("-", 1);
+      }
+      else
+      {
+        move_cursor(row, 2 * width + 2);
+      }
+      put(edge ? "+" : "|", 1);
+      cursor_row = -1; // wherever the border left it, the next move has to be written out
+    }
+  }
+
+  void TerminalRenderer::draw_status(const BoardSnapshot &snap)
+  {
+    if (!full && snap.score == shown_score && snap.lines_cleared == shown_lines && snap.game_over == shown_over)
+      return;
+
+    move_cursor(height + 3, 1);
+    set_color(0);
+    put("score ");
+    put_number(snap.score);
+    put("  lines ");
+    put_number(snap.lines_cleared);
+    if (snap.game_over)
+      put("  GAME OVER");
+    put("\x1b[K"); // whatever the last status had past this goes
+    cursor_row = -1;
+
+    shown_score = snap.score;
+    shown_lines = snap.lines_cleared;
+    shown_over = snap.game_over;
+  }
+
+  void TerminalRenderer::flush()
+  {
+    ++frame_count;
+    byte_count += used;
+    max_bytes = std::max(max_bytes, used);
+    if (used)
+      write_all(fd, out.data(), used);
+  }
+
+  RawTerminal::RawTerminal(int in, int out) : in(in), out(out)
+  {
+    if (isatty(in) && tcgetattr(in, &saved) == 0)
+    {
+      // no line buffering or echo and no signals from Ctrl-C (it comes in as a key), output stays
+      // cooked so the newlines after the game still work
+      termios settings = saved;
+      settings.c_iflag &= ~static_cast<tcflag_t>(IXON | ICRNL);
+      settings.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO | ISIG | IEXTEN);
+      settings.c_cc[VMIN] = 0;
+      settings.c_cc[VTIME] = 0;
+      raw = tcsetattr(in, TCSANOW, &settings) == 0;
+    }
+    const char *enter = "\x1b[?1049h\x1b[?25l"; // the alternate screen, no cursor
+    write_all(out, enter, std::strlen(enter));
+  }
+
+  RawTerminal::~RawTerminal()
+  {
+    const char *leave = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    write_all(out, leave, std::strlen(leave));
+    if (raw)
+      tcsetattr(in, TCSANOW, &saved);
+  }
+
+  TerminalKey RawTerminal::read_key(int timeout_ms)
+  {
+    if (!raw)
+    {
+      if (timeout_ms > 0)
+        poll(nullptr, 0, timeout_ms);
+      return TerminalKey::None;
+    }
+
+    if (pending_count == 0)
+    {
+      pollfd waiting = {in, POLLIN, 0};
+      if (poll(&waiting, 1, std::max(0, timeout_ms)) <= 0)
+        return TerminalKey::None;
+      ssize_t got = read(in, pending, sizeof(pending));
+      if (got <= 0)
+        return TerminalKey::None;
+      pending_count = static_cast<int>(got);
+    }
+
+    // an arrow is three bytes, everything else is one
+    int taken = 1;
+    TerminalKey key = TerminalKey::None;
+    if (pending[0] == '\x1b' && pending_count >= 3 && pending[1] == '[')
+    {
+      taken = 3;
+      switch (pending[2])
+      {
+      case 'A':
+        key = TerminalKey::Rotate;
+        break;
+      case 'B':
+        key = TerminalKey::Down;
+        break;
+      case 'C':
+        key = TerminalKey::Right;
+        break;
+      case 'D':
+        key = TerminalKey::Left;
+        break;
+      }
+    }
+    else
+    {
+      switch (pending[0])
+      {
+      case 'a':
+      case 'A':
+        key = TerminalKey::Left;
+        break;
+      case 'd':
+      case 'D':
+        key = TerminalKey::Right;
+        break;
+      case 's':
+      case 'S':
+        key = TerminalKey::Down;
+        break;
+      case 'w':
+      case 'W':
+        key = TerminalKey::Rotate;
+        break;
+      case ' ':
+        key = TerminalKey::Drop;
+        break;
+      case 'q':
+      case 'Q':
+      case '\x1b': // Escape on its own
+      case '\x03': // Ctrl-C
+        key = TerminalKey::Quit;
+        break;
+      }
+    }
+    pending_count -= taken;
+    std::memmove(pending, pending + taken, pending_count);
+    return key;
+  }
+
+  bool key_input(TerminalKey key, Input &input)
+  {
+    switch (key)
+    {
+    case TerminalKey::Left:
+      input = Input::Left;
+      return true;
+    case TerminalKey::Right:
+      input = Input::Right;
+      return true;
+    case TerminalKey::Down:
+      input = Input::Down;
+      return true;
+    case TerminalKey::Drop:
+      input = Input::Drop;
+      return true;
+    case TerminalKey::Rotate:
+      input = Input::Rotate;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+}
@@ -0,0 +1,111 @@
+#ifndef TERMINAL_HPP
+#define TERMINAL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <termios.h>
+#include "simulation.hpp"
+
+namespace tetris
+{
+
+    // Draws snapshots into a terminal with ANSI escapes, for playing over SSH where there's no display.
+    // A block is two character cells with a background from the 256 color palette (the nearest one
+    // to its tetris::palette() color). It remembers what the terminal is showing, so a frame is only the
+    // cells that changed: a cursor move when the next changed cell isn't where the cursor already
+    // is, a color change when it isn't the color already set, and two spaces. All of it goes out in
+    // one write, from a buffer sized for the worst frame up front, so drawing never allocates
+    class TerminalRenderer
+    {
+    public:
+        TerminalRenderer(int height, int width, int fd = 1);
+
+        void draw(const BoardSnapshot &snap);
+
+        // the next frame clears the screen and draws everything, for when something else wrote to it
+        void redraw() { full = true; }
+
+        // what went out so far, to see what a link needs
+        std::uint64_t frames() const { return frame_count; }
+        std::uint64_t bytes() const { return byte_count; }
+        std::size_t last_frame_bytes() const { return used; }
+        std::size_t max_frame_bytes() const { return max_bytes; }
+        std::size_t full_frame_bytes() const { return full_bytes; } // the latest complete redraw
+
+    private:
+        void put(const char *text, std::size_t size);
+        void put(const char *text);
+        void put_number(int value);
+        void move_cursor(int row, int column); // 1 based, like the escapes
+        void set_color(int color);
+        void draw_frame_border();
+        void draw_status(const BoardSnapshot &snap);
+        void flush();
+
+        int height;
+        int width;
+        int fd;
+        std::vector<std::uint8_t> shown;  // the color number of each cell as the terminal has it
+        std::vector<std::uint8_t> next;   // the frame being drawn
+        std::vector<char> out;            // the frame's bytes
+        std::size_t used = 0;
+        std::string color_codes[PieceSet::max_pieces + 1]; // the escape for each color number, 0 is an empty cell
+
+        // where the terminal is, -1 when we don't know
+        int cursor_row = -1;
+        int cursor_column = -1;
+        int current_color = -1;
+        int shown_score = -1;
+        int shown_lines = -1;
+        bool shown_over = false;
+        bool full = true;
+
+        std::uint64_t frame_count = 0;
+        std::uint64_t byte_count = 0;
+        std::size_t max_bytes = 0;
+        std::size_t full_bytes = 0;
+    };
+
+    // What a key press in the terminal means to the game
+    enum class TerminalKey
+    {
+        None,
+        Left,
+        Right,
+        Down,
+        Drop,
+        Rotate,
+        Quit
+    };
+
+    // The terminal in raw mode for as long as it's around: keys come in one at a time without being
+    // echoed, and the game is drawn on the alternate screen with the cursor hidden. Everything is put
+    // back when it's destroyed. When stdin isn't a terminal it leaves it alone and no keys come
+    class RawTerminal
+    {
+    public:
+        RawTerminal(int in = 0, int out = 1);
+        ~RawTerminal();
+
+        RawTerminal(const RawTerminal &) = delete;
+        RawTerminal &operator=(const RawTerminal &) = delete;
+
+        // the next key, waiting up to timeout_ms for one. arrows or WASD move, space drops, q, Escape
+        // or Ctrl-C quit
+        TerminalKey read_key(int timeout_ms);
+
+    private:
+        int in;
+        int out;
+        bool raw = false;
+        termios saved;
+        char pending[64]; // read but not handed out yet
+        int pending_count = 0;
+    };
+
+    // how the keys map onto the board's inputs, false for the ones that aren't one
+    bool key_input(TerminalKey key, Input &input);
+
+}
+#endif // TERMINAL_HPP
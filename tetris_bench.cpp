@@ -0,0 +1,282 @@
+// Benchmarks for the board engine, run with "make bench"
+// each benchmark is run on the runtime sized GameBoard and on the FixedGameBoard of the same size
+#include "grid.hpp"
+#include "fixed_board.hpp"
+#include "huge_board.hpp"
+#include "event_bus.hpp"
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+namespace
+{
+
+    // keeps the optimizer from throwing away the results we are timing
+    volatile long long sink = 0;
+
+    // runs the body and returns the nanoseconds per operation
+    double time_ns_per_op(long long ops, const std::function<void()> &body)
+    {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+    }
+
+    void report(const std::string &name, int width, int height, double runtime_ns, double fixed_ns)
+    {
+        std::printf("%-14s %2dx%-2d  runtime %8.2f ns/op   fixed %8.2f ns/op   x%.1f\n",
+                    name.c_str(), width, height, runtime_ns, fixed_ns, runtime_ns / fixed_ns);
+    }
+
+    // for the benchmarks that only have the one version
+    void report(const std::string &name, double ns)
+    {
+        std::printf("%-14s        %8.2f ns/op\n", name.c_str(), ns);
+    }
+
+    // the two boards are written to differently, this hides that from the benchmarks
+    void set_cell(tetris::GameBoard &board, int y, int x, int value)
+    {
+        board.getGameState()[y][x] = value;
+    }
+
+    template <int W, int H>
+    void set_cell(tetris::FixedGameBoard<W, H> &board, int y, int x, int value)
+    {
+        board.set_cell(y, x, value);
+    }
+
+    void set_cell(tetris::HugeGameBoard &board, int y, int x, int value)
+    {
+        board.set_cell(y, x, value);
+    }
+
+    // checks the piece against every position on the board, like TestHasHitPile does
+    template <typename Board>
+    double bench_has_hit_pile(Board &board, int rounds)
+    {
+        board.generate_new_piece();
+        long long ops = static_cast<long long>(rounds) * (board.getHeight() + 4) * (board.getWidth() + 4);
+        return time_ns_per_op(ops, [&]()
+                              {
+            long long hits = 0;
+            for (int r = 0; r < rounds; ++r)
+            {
+                for (int b_y = -4; b_y < board.getHeight(); ++b_y)
+                {
+                    for (int b_x = -4; b_x < board.getWidth(); ++b_x)
+                    {
+                        board.b_x = b_x;
+                        board.b_y = b_y;
+                        hits += board.has_hit_pile();
+                    }
+                }
+                board.rotate();
+            }
+            sink += hits; });
+    }
+
+    // scans for full lines on a board that is half full but has no complete lines
+    template <typename Board>
+    double bench_shift_down(Board &board, int rounds)
+    {
+        for (int y = board.getHeight() / 2; y < board.getHeight(); ++y)
+        {
+            for (int x = 0; x < board.getWidth(); ++x)
+            {
+                if (x != y % board.getWidth())
+                    set_cell(board, y, x, 1 + x % 7);
+            }
+        }
+        return time_ns_per_op(rounds, [&]()
+                              {
+            for (int r = 0; r < rounds; ++r)
+                board.shift_down();
+            sink += board.get_score(); });
+    }
+
+    // drops pieces straight down until the game is over, then starts a new board
+    template <typename MakeBoard>
+    double bench_drop(int rounds, MakeBoard make_board)
+    {
+        long long moves = 0;
+        double ns = time_ns_per_op(1, [&]()
+                                   {
+            for (int r = 0; r < rounds; ++r)
+            {
+                auto board = make_board();
+                board.generate_new_piece();
+                while (!board.is_game_over())
+                {
+                    ++moves;
+                    board.move_down();
+                }
+                sink += board.get_score();
+            } });
+        return ns / moves;
+    }
+
+    // fills the bottom four rows and clears them, a tetris used to cost 80ms of sleeping
+    template <typename Board>
+    double bench_clear_tetris(Board &board, int rounds)
+    {
+        return time_ns_per_op(rounds, [&]()
+                              {
+            for (int r = 0; r < rounds; ++r)
+            {
+                for (int y = board.getHeight() - 4; y < board.getHeight(); ++y)
+                    for (int x = 0; x < board.getWidth(); ++x)
+                        set_cell(board, y, x, 2);
+                board.shift_down();
+            }
+            sink += board.lines_cleared_count(); });
+    }
+
+    // locks an I piece into a gap left in the bottom row, so every lock clears a line. the line
+    // is refilled for the next round, all of that is in the time too
+    double bench_lock_clear(tetris::HugeGameBoard &board, int rounds)
+    {
+        int bottom = board.getHeight() - 1;
+        return time_ns_per_op(rounds, [&]()
+                              {
+            for (int r = 0; r < rounds; ++r)
+            {
+                for (int x = 0; x < board.getWidth(); ++x)
+                    board.set_cell(bottom, x, x < 4 ? 0 : 1 + x % 7);
+                while (board.getBlock() != 2 || board.getRotation() != 0)
+                    board.generate_new_piece();
+                board.b_x = 0;
+                board.b_y = bottom - 1; // the I is the second row of its 4x4
+                board.move_down();
+            }
+            sink += board.lines_cleared_count(); });
+    }
+
+    // a cascade chain step, a clear and the groups it cut loose falling, on a pile of ragged rows
+    // with a full one in the middle of it. the pile is built again between rounds, outside the time
+    template <typename Board>
+    double bench_cascade_step(Board &board, int rounds, int pile, int &steps)
+    {
+        board.set_cascade(true);
+        int height = board.getHeight();
+        int width = board.getWidth();
+        double ns = 0;
+        steps = 0;
+        for (int r = 0; r < rounds; ++r)
+        {
+            board.reset();
+            for (int y = height - pile; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    unsigned hash = static_cast<unsigned>(x * 73856093 ^ y * 19349663 ^ r * 83492791);
+                    bool full = y == height - pile / 2;
+                    if (full || (hash >> 7) % 100 < 55 || x == y % width)
+                        set_cell(board, y, x, full || x != y % width ? 1 + x % 7 : 0);
+                }
+            }
+            ns += time_ns_per_op(1, [&]()
+                                 {
+                board.shift_down();
+                ++steps;
+                while (board.settle())
+                {
+                    board.shift_down();
+                    ++steps;
+                } });
+        }
+        sink += board.lines_cleared_count();
+        return ns / steps;
+    }
+
+    // what it costs the board to publish one event, with nobody reading
+    double bench_event_publish(long long rounds)
+    {
+        static tetris::EventBus bus;
+        tetris::Event event;
+        return time_ns_per_op(rounds, [&]()
+                              {
+            for (long long r = 0; r < rounds; ++r)
+            {
+                event.x = static_cast<std::int16_t>(r);
+                bus.publish(event);
+            }
+            sink += bus.published(); });
+    }
+
+    template <int W, int H>
+    void bench_size()
+    {
+        int height = H;
+        int width = W;
+
+        tetris::GameBoard runtime(height, width);
+        tetris::FixedGameBoard<W, H> fixed;
+        report("has_hit_pile", W, H, bench_has_hit_pile(runtime, 2000), bench_has_hit_pile(fixed, 2000));
+
+        tetris::GameBoard runtime_lines(height, width);
+        tetris::FixedGameBoard<W, H> fixed_lines;
+        report("shift_down", W, H, bench_shift_down(runtime_lines, 200000), bench_shift_down(fixed_lines, 200000));
+
+        tetris::GameBoard runtime_tetris(height, width);
+        tetris::FixedGameBoard<W, H> fixed_tetris;
+        report("clear_tetris", W, H, bench_clear_tetris(runtime_tetris, 100000), bench_clear_tetris(fixed_tetris, 100000));
+    }
+
+}
+
+int main()
+{
+    bench_size<15, 25>();
+    bench_size<10, 20>();
+    bench_size<7, 15>();
+
+    int height = 20;
+    int width = 10;
+    report("drop", width, height,
+           bench_drop(2000, [&]()
+                      { return tetris::GameBoard(height, width); }),
+           bench_drop(2000, []()
+                      { return tetris::FixedGameBoard<10, 20>(); }));
+
+    report("event_publish", bench_event_publish(10000000));
+
+    // the massive mode board, first next to GameBoard at the biggest size GameBoard allows
+    int side = 50;
+    tetris::GameBoard runtime_side(side, side);
+    tetris::HugeGameBoard huge_side(side, side);
+    std::printf("HugeGameBoard in place of the fixed one:\n");
+    report("shift_down", side, side, bench_shift_down(runtime_side, 20000), bench_shift_down(huge_side, 20000));
+    report("drop", side, side,
+           bench_drop(200, [&]()
+                      { return tetris::GameBoard(side, side); }),
+           bench_drop(200, [&]()
+                      { return tetris::HugeGameBoard(side, side); }));
+
+    for (int huge : {1000, 10000})
+    {
+        tetris::HugeGameBoard board(huge, huge);
+        board.seed(1);
+        board.generate_new_piece();
+        std::string size = std::to_string(huge) + "x" + std::to_string(huge);
+        report("lock_clear " + size, bench_lock_clear(board, 2000));
+        report("shift_down " + size, bench_shift_down(board, 20));
+        std::printf("%-14s        %8.1f MB\n", ("bytes " + size).c_str(), board.bytes() / 1e6);
+    }
+
+    // cascade gravity, the most GameBoard allows and then the most HugeGameBoard does
+    std::printf("cascade chain steps, 32 rows of pile:\n");
+    int steps = 0;
+    tetris::GameBoard runtime_cascade(side, side);
+    double ns = bench_cascade_step(runtime_cascade, 2000, 32, steps);
+    report("GameBoard " + std::to_string(side) + "x" + std::to_string(side), ns);
+    for (int huge : {side, 1000, tetris::HugeGameBoard::max_side})
+    {
+        tetris::HugeGameBoard board(huge, huge);
+        ns = bench_cascade_step(board, huge < 1000 ? 2000 : 10, 32, steps);
+        report("Huge " + std::to_string(huge) + "x" + std::to_string(huge), ns);
+    }
+    return 0;
+}
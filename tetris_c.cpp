@@ -0,0 +1,194 @@
+// The C API in tetris_c.h, a thin layer over GameBoard and the bot's placement helpers. Nothing may
+// throw out of here, the callers are C
+#include "tetris_c.h"
+#include "bot.hpp"
+#include "grid.hpp"
+#include <vector>
+
+struct tetris_env
+{
+    tetris_env(int height, int width) : board(height, width), scratch(height, width) {}
+
+    tetris::GameBoard board;
+    tetris::GameBoard scratch; // where placements get tried
+    tetris::BoardState start;
+    std::vector<tetris::Placement> placements;
+
+    // the caller's buffers, any of them can be missing
+    uint8_t *board_out = nullptr;
+    int32_t *piece_out = nullptr;
+    float *features_out = nullptr;
+};
+
+namespace
+{
+    void write_observation(tetris_env &env)
+    {
+        tetris::GameBoard &board = env.board;
+        if (env.board_out)
+        {
+            // everything the loop needs is in locals first, a store through a uint8_t pointer could
+            // alias anything so the compiler would otherwise load the grid over again for every cell
+            uint8_t *out = env.board_out;
+            const int width = board.getWidth();
+            const tetris::Grid &grid = board.getGameState();
+            for (const std::vector<int> &row : grid)
+            {
+                const int *cells = row.data();
+                for (int x = 0; x < width; ++x)
+                {
+                    out[x] = cells[x] != 0;
+                }
+                out += width;
+            }
+        }
+        if (env.piece_out)
+        {
+            env.piece_out[0] = board.getBlock();
+            env.piece_out[1] = board.b_x;
+            env.piece_out[2] = board.b_y;
+            env.piece_out[3] = board.getRotation();
+        }
+        if (env.features_out)
+        {
+            tetris::BoardFeatures features = tetris::board_features(board);
+            float *out = env.features_out;
+            out[TETRIS_FEATURE_AGGREGATE_HEIGHT] = static_cast<float>(features.aggregate_height);
+            out[TETRIS_FEATURE_MAX_HEIGHT] = static_cast<float>(features.max_height);
+            out[TETRIS_FEATURE_HOLES] = static_cast<float>(features.holes);
+            out[TETRIS_FEATURE_BUMPINESS] = static_cast<float>(features.bumpiness);
+            out[TETRIS_FEATURE_LINES] = static_cast<float>(board.lines_cleared_count());
+            out[TETRIS_FEATURE_SCORE] = static_cast<float>(board.get_score());
+            out[TETRIS_FEATURE_PIECES] = static_cast<float>(board.pieces_placed());
+        }
+    }
+
+    // what every step ends with: the reward, the observation and whether it's over
+    int32_t finish_step(tetris_env &env, int score_before, float *reward)
+    {
+        if (reward)
+            *reward = static_cast<float>(env.board.get_score() - score_before);
+        write_observation(env);
+        return env.board.is_game_over() ? 1 : 0;
+    }
+}
+
+extern "C"
+{
+
+    int32_t tetris_abi_version(void)
+    {
+        return TETRIS_ABI_VERSION;
+    }
+
+    tetris_env *tetris_create(int32_t height, int32_t width)
+    {
+        if (height < 5 || height > 50 || width < 5 || width > 50)
+            return nullptr;
+        try
+        {
+            tetris_env *env = new tetris_env(height, width);
+            tetris_reset(env, 0);
+            return env;
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    void tetris_destroy(tetris_env *env)
+    {
+        delete env;
+    }
+
+    int32_t tetris_bind_observation(tetris_env *env, uint8_t *board, int32_t *piece, float *features)
+    {
+        if (!env)
+            return -1;
+        env->board_out = board;
+        env->piece_out = piece;
+        env->features_out = features;
+        write_observation(*env);
+        return 0;
+    }
+
+    void tetris_reset(tetris_env *env, uint32_t seed)
+    {
+        env->board.reset();
+        env->board.seed(seed);
+        env->board.generate_new_piece();
+        write_observation(*env);
+    }
+
+    int32_t tetris_step(tetris_env *env, int32_t action, float *reward)
+    {
+        if (action < TETRIS_LEFT || action > TETRIS_NOTHING)
+            return -1;
+
+        tetris::GameBoard &board = env->board;
+        int before = board.get_score();
+        if (!board.is_game_over())
+        {
+            if (action != TETRIS_NOTHING)
+                board.handle_input(static_cast<tetris::Input>(action));
+            if (!board.is_game_over())
+                board.move_down();
+        }
+        return finish_step(*env, before, reward);
+    }
+
+    int32_t tetris_legal_placements(tetris_env *env, tetris_placement *out, int32_t capacity)
+    {
+        try
+        {
+            tetris::legal_placements(env->board, env->scratch, env->start, env->placements);
+        }
+        catch (...)
+        {
+            return 0;
+        }
+
+        int32_t count = static_cast<int32_t>(env->placements.size());
+        for (int32_t i = 0; i < count && i < capacity; ++i)
+        {
+            out[i].turns = env->placements[i].turns;
+            out[i].x = env->placements[i].x;
+        }
+        return count;
+    }
+
+    int32_t tetris_place(tetris_env *env, tetris_placement placement, float *reward)
+    {
+        tetris::GameBoard &board = env->board;
+        if (board.is_game_over() || placement.turns < 0 || placement.turns > 3)
+            return -1;
+
+        // tried on the scratch board first, the real one can't be left half way there
+        board.save_state(env->start);
+        env->scratch.load_state(env->start);
+        if (!tetris::move_to(env->scratch, {placement.turns, placement.x}))
+            return -1;
+
+        int before = board.get_score();
+        tetris::move_to(board, {placement.turns, placement.x});
+        board.handle_input(tetris::Input::Drop);
+        return finish_step(*env, before, reward);
+    }
+
+    int32_t tetris_step_batch(tetris_env *const *envs, int32_t count, const int32_t *actions, float *rewards,
+                              uint8_t *dones)
+    {
+        int32_t over = 0;
+        for (int32_t i = 0; i < count; ++i)
+        {
+            int32_t done = tetris_step(envs[i], actions[i], rewards ? &rewards[i] : nullptr);
+            if (done < 0)
+                return -1;
+            if (dones)
+                dones[i] = static_cast<uint8_t>(done);
+            over += done;
+        }
+        return over;
+    }
+}
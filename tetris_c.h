@@ -0,0 +1,99 @@
+/* The C API of libtetris.so, for driving boards from outside C++ (Python through ctypes or cffi,
+ * Rust, Julia, ...). Everything is plain C: an opaque handle, fixed width integers and caller owned
+ * arrays. Nothing in here throws, allocates memory the caller has to free (apart from the env
+ * itself) or keeps a pointer it wasn't given through tetris_bind_observation.
+ *
+ * Observations are written straight into memory the caller owns. Bind the buffers once, after that
+ * every reset and step fills them in, so a binding can hand out numpy arrays (or whatever) that wrap
+ * the same memory and never copy anything:
+ *
+ *   board     height * width uint8, row by row from the top, 1 where the pile has a block
+ *   piece     TETRIS_PIECE_FIELDS int32: the falling piece's id (1-7), x, y and rotation
+ *   features  TETRIS_FEATURE_COUNT float, see enum tetris_feature
+ *
+ * The ABI only grows: new functions get added, the ones here and the layouts above keep their
+ * meaning. tetris_abi_version() says what the library has. */
+#ifndef TETRIS_C_H
+#define TETRIS_C_H
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TETRIS_ABI_VERSION 1
+#define TETRIS_PIECE_FIELDS 4
+
+/* the library is built with everything hidden, only these get exported */
+#if defined(__GNUC__)
+#define TETRIS_API __attribute__((visibility("default")))
+#else
+#define TETRIS_API
+#endif
+
+    typedef struct tetris_env tetris_env;
+
+    /* the low level actions, one per step, every step also lets gravity move the piece a row */
+    enum tetris_action
+    {
+        TETRIS_LEFT = 0,
+        TETRIS_RIGHT = 1,
+        TETRIS_DOWN = 2,
+        TETRIS_DROP = 3,
+        TETRIS_ROTATE = 4,
+        TETRIS_NOTHING = 5
+    };
+
+    enum tetris_feature
+    {
+        TETRIS_FEATURE_AGGREGATE_HEIGHT = 0,
+        TETRIS_FEATURE_MAX_HEIGHT = 1,
+        TETRIS_FEATURE_HOLES = 2,
+        TETRIS_FEATURE_BUMPINESS = 3,
+        TETRIS_FEATURE_LINES = 4,  /* lines cleared this game */
+        TETRIS_FEATURE_SCORE = 5,
+        TETRIS_FEATURE_PIECES = 6, /* pieces locked this game */
+        TETRIS_FEATURE_COUNT = 7
+    };
+
+    /* a whole move at once: turn the piece this many times (0-3), move it until its x is x, drop it */
+    typedef struct tetris_placement
+    {
+        int32_t turns;
+        int32_t x;
+    } tetris_placement;
+
+    TETRIS_API int32_t tetris_abi_version(void);
+
+    /* a board of width x height (5 to 50 each), already reset with seed 0. NULL if the size is wrong */
+    TETRIS_API tetris_env *tetris_create(int32_t height, int32_t width);
+    TETRIS_API void tetris_destroy(tetris_env *env);
+
+    /* where observations go from now on, any of them can be NULL. returns 0, or -1 for a NULL env */
+    TETRIS_API int32_t tetris_bind_observation(tetris_env *env, uint8_t *board, int32_t *piece, float *features);
+
+    /* an empty board whose pieces come from seed, the observation is written */
+    TETRIS_API void tetris_reset(tetris_env *env, uint32_t seed);
+
+    /* one action and a row of gravity. reward (if not NULL) gets the points scored, returns 1 when
+     * the game is over, 0 when it isn't and -1 for an action that doesn't exist */
+    TETRIS_API int32_t tetris_step(tetris_env *env, int32_t action, float *reward);
+
+    /* the placements the falling piece can get to, at most capacity of them go in out. returns how
+     * many there are in all (so a short buffer can be noticed), 0 once the game is over */
+    TETRIS_API int32_t tetris_legal_placements(tetris_env *env, tetris_placement *out, int32_t capacity);
+
+    /* plays a placement in one go, rewards and returns like tetris_step (-1 if it isn't legal) */
+    TETRIS_API int32_t tetris_place(tetris_env *env, tetris_placement placement, float *reward);
+
+    /* tetris_step on count envs, actions[i] goes to envs[i]. rewards and dones (either can be NULL)
+     * get one value per env. returns how many of the envs are over, or -1 if an action was bad
+     * (the envs before it have already stepped) */
+    TETRIS_API int32_t tetris_step_batch(tetris_env *const *envs, int32_t count, const int32_t *actions,
+                                         float *rewards, uint8_t *dones);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* TETRIS_C_H */
@@ -0,0 +1,116 @@
+/* What a call into libtetris.so costs, run with "make bench". It's plain C on purpose, it goes
+ * through the library the same way a binding would */
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include "tetris_c.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define HEIGHT 20
+#define WIDTH 10
+#define BATCH 64
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, double ns)
+{
+    printf("%-22s %8.1f ns/call\n", name, ns);
+}
+
+int main(void)
+{
+    uint8_t board[HEIGHT * WIDTH];
+    int32_t piece[TETRIS_PIECE_FIELDS];
+    float features[TETRIS_FEATURE_COUNT];
+    tetris_placement placements[256];
+    float reward;
+    long calls;
+    long i;
+    double start;
+
+    tetris_env *env = tetris_create(HEIGHT, WIDTH);
+    if (!env || tetris_abi_version() != TETRIS_ABI_VERSION)
+    {
+        fprintf(stderr, "libtetris.so doesn't match tetris_c.h\n");
+        return 1;
+    }
+    srand(1);
+
+    /* a step with only the board and the piece written, then with the features too */
+    tetris_bind_observation(env, board, piece, NULL);
+    calls = 2000000;
+    start = now_ns();
+    for (i = 0; i < calls; ++i)
+    {
+        if (tetris_step(env, rand() % 6, &reward))
+            tetris_reset(env, (uint32_t)i);
+    }
+    report("step", (now_ns() - start) / calls);
+
+    tetris_bind_observation(env, board, piece, features);
+    start = now_ns();
+    for (i = 0; i < calls; ++i)
+    {
+        if (tetris_step(env, rand() % 6, &reward))
+            tetris_reset(env, (uint32_t)i);
+    }
+    report("step with features", (now_ns() - start) / calls);
+
+    calls = 200000;
+    start = now_ns();
+    for (i = 0; i < calls; ++i)
+        tetris_legal_placements(env, placements, 256);
+    report("legal_placements", (now_ns() - start) / calls);
+
+    start = now_ns();
+    for (i = 0; i < calls; ++i)
+    {
+        int32_t count = tetris_legal_placements(env, placements, 256);
+        if (tetris_place(env, placements[rand() % count], &reward))
+            tetris_reset(env, (uint32_t)i);
+    }
+    report("legal + place", (now_ns() - start) / calls);
+    tetris_destroy(env);
+
+    /* a batch of envs, each with its own buffers, the cost is per env */
+    {
+        tetris_env *envs[BATCH];
+        static uint8_t boards[BATCH][HEIGHT * WIDTH];
+        static int32_t pieces[BATCH][TETRIS_PIECE_FIELDS];
+        int32_t actions[BATCH];
+        float rewards[BATCH];
+        uint8_t dones[BATCH];
+        int e;
+
+        for (e = 0; e < BATCH; ++e)
+        {
+            envs[e] = tetris_create(HEIGHT, WIDTH);
+            tetris_bind_observation(envs[e], boards[e], pieces[e], NULL);
+            tetris_reset(envs[e], (uint32_t)e);
+        }
+        calls = 30000;
+        start = now_ns();
+        for (i = 0; i < calls; ++i)
+        {
+            for (e = 0; e < BATCH; ++e)
+                actions[e] = rand() % 6;
+            if (tetris_step_batch(envs, BATCH, actions, rewards, dones) > 0)
+            {
+                for (e = 0; e < BATCH; ++e)
+                {
+                    if (dones[e])
+                        tetris_reset(envs[e], (uint32_t)(i * BATCH + e));
+                }
+            }
+        }
+        report("step_batch (per env)", (now_ns() - start) / ((double)calls * BATCH));
+        for (e = 0; e < BATCH; ++e)
+            tetris_destroy(envs[e]);
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+// Plays headless games a placement at a time and writes every placement out as a training sample
+// usage: ./tetris_dataset.exe [--out data/run] [--games 1000] [--threads N] [--board 10x20] [--seed 1]
+//                             [--policy bot|random] [--max-pieces 10000] [--chunk-rows 65536]
+//
+// Each thread plays its share into its own files, data/run-<thread>-00000.tds and on (the format is
+// at the top of dataset.hpp). --policy bot is the El-Tetris bot, random picks any legal placement.
+// A game stopped by --max-pieces doesn't have done set on its last sample, it wasn't lost.
+// Without --out the games are played and nothing is written, to see what the export costs
+#include "bot.hpp"
+#include "dataset.hpp"
+#include "grid.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace tetris;
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        std::string out;
+        long games = 1000;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        int width = 10;
+        int height = 20;
+        unsigned seed = 1;
+        bool bot = true;
+        long max_pieces = 10000;
+        int chunk_rows = 1 << 16;
+    };
+
+    struct Result
+    {
+        std::uint64_t samples = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t stalled_ns = 0;
+        int files = 0;
+        std::string error;
+    };
+
+    void play_games(const Options &options, int thread, long games, unsigned seed, Result &result)
+    {
+        try
+        {
+            std::unique_ptr<DatasetWriter> out;
+            if (!options.out.empty())
+                out.reset(new DatasetWriter(options.out + "-" + std::to_string(thread), options.height, options.width,
+                                            options.chunk_rows));
+
+            int height = options.height;
+            int width = options.width;
+            std::mt19937 rng(seed);
+            GameBoard board(height, width);
+            Bot bot(height, width);
+            GameBoard scratch(height, width);
+            BoardState start;
+            std::vector<Placement> placements;
+            for (long game = 0; game < games; ++game)
+            {
+                board.reset();
+                board.seed(rng());
+                board.generate_new_piece();
+
+                for (long piece = 0; piece < options.max_pieces && !board.is_game_over(); ++piece)
+                {
+                    Placement placement;
+                    if (options.bot)
+                    {
+                        if (!bot.best_placement(board, placement))
+                            break;
+                    }
+                    else
+                    {
+                        legal_placements(board, scratch, start, placements);
+                        if (placements.empty())
+                            break;
+                        placement = placements[rng() % placements.size()];
+                    }
+
+                    if (out)
+                        out->add(board, placement);
+                    int before = board.get_score();
+                    move_to(board, placement);
+                    board.handle_input(Input::Drop);
+                    if (out)
+                        out->finish(board.get_score() - before, board.is_game_over());
+                    ++result.samples;
+                }
+            }
+
+            if (out)
+            {
+                out->close();
+                result.bytes = out->bytes();
+                result.stalled_ns = out->stalled_ns();
+                result.files = out->files();
+            }
+        }
+        catch (const std::exception &error)
+        {
+            result.error = error.what();
+        }
+    }
+
+    bool parse_options(int argc, char **argv, Options &options)
+    {
+        try
+        {
+            for (int i = 1; i + 1 < argc; i += 2)
+            {
+                std::string option = argv[i];
+                std::string value = argv[i + 1];
+                if (option == "--out")
+                    options.out = value;
+                else if (option == "--games")
+                    options.games = std::stol(value);
+                else if (option == "--threads")
+                    options.threads = std::max(1, std::stoi(value));
+                else if (option == "--board")
+                {
+                    if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2)
+                        options.width = 0; // caught below
+                }
+                else if (option == "--seed")
+                    options.seed = static_cast<unsigned>(std::stoul(value));
+                else if (option == "--policy" && (value == "bot" || value == "random"))
+                    options.bot = value == "bot";
+                else if (option == "--max-pieces")
+                    options.max_pieces = std::stol(value);
+                else if (option == "--chunk-rows")
+                    options.chunk_rows = std::stoi(value);
+                else
+                    return false;
+            }
+        }
+        catch (const std::logic_error &)
+        {
+            return false;
+        }
+        if (argc % 2 == 0)
+            return false; // an option without its value
+        if (options.width < 5 || options.height < 5 || options.width > 50 || options.height > 50)
+        {
+            std::cerr << "Boards go from 5x5 to 50x50" << std::endl;
+            return false;
+        }
+        return options.chunk_rows > 0;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::cerr << "usage: " << argv[0] << " [--out data/run] [--games 1000] [--threads N] [--board 10x20] [--seed 1]\n"
+                  << "       [--policy bot|random] [--max-pieces 10000] [--chunk-rows 65536]" << std::endl;
+        return 1;
+    }
+
+    auto start = Clock::now();
+    std::vector<Result> results(options.threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; ++t)
+    {
+        long share = options.games / options.threads + (t < options.games % options.threads ? 1 : 0);
+        workers.emplace_back(play_games, std::cref(options), t, share, options.seed * 1000003u + t, std::ref(results[t]));
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Result total;
+    for (const Result &result : results)
+    {
+        if (!result.error.empty())
+        {
+            std::cerr << result.error << std::endl;
+            return 1;
+        }
+        total.samples += result.samples;
+        total.bytes += result.bytes;
+        total.stalled_ns += result.stalled_ns;
+        total.files += result.files;
+    }
+
+    std::printf("%ld games on %dx%d, %d thread(s), %.2fs, %llu samples (%.0f samples/s)\n", options.games,
+                options.width, options.height, options.threads, seconds,
+                static_cast<unsigned long long>(total.samples), total.samples / seconds);
+    if (!options.out.empty())
+    {
+        std::printf("%d file(s), %llu bytes, %.2f bytes/sample, %.1f ms waiting on the writer threads\n",
+                    total.files, static_cast<unsigned long long>(total.bytes),
+                    total.samples ? static_cast<double>(total.bytes) / total.samples : 0.0,
+                    total.stalled_ns / 1e6);
+    }
+    return 0;
+}
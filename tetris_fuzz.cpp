@@ -0,0 +1,238 @@
+// Differential fuzzer: plays random seeds and inputs on GameBoard (the reference) and on the other
+// boards in lockstep and stops at the first step where they disagree
+// usage: ./tetris_fuzz.exe [--backend all|fixed|huge] [--board 10x20] [--threads N] [--seconds 10]
+//                          [--seed N] [--max-steps 2000]
+//
+// --seconds 0 runs until something differs (or it's killed), for leaving it going for hours.
+// fixed is the FixedGameBoard of the size, so it has to be one of the difficulty sizes (all skips
+// it for other sizes). A failing case is shrunk to the fewest steps that still fail and printed
+// as a seed and the steps, exit code 1. How far it got goes to stderr every 10 seconds
+#include "fixed_board.hpp"
+#include "fuzz.hpp"
+#include "grid.hpp"
+#include "huge_board.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace tetris;
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        std::string backend = "all";
+        int width = 10;
+        int height = 20;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        double seconds = 10;
+        unsigned seed = std::random_device{}();
+        std::size_t max_steps = 2000;
+    };
+
+    struct Failure
+    {
+        std::string backend;
+        FuzzCase found;
+        FuzzCase shrunk;
+        FuzzMismatch mismatch; // of the shrunk case
+    };
+
+    std::atomic<bool> stop{false};
+    std::atomic<long long> total_steps{0};
+    std::atomic<long long> total_cases{0};
+    std::mutex failure_mutex;
+    std::unique_ptr<Failure> failure; // the first one, the others are dropped
+
+    // one candidate against the reference, a difference is shrunk here on the thread that found it
+    template <typename Candidate>
+    void check(GameBoard &reference, Candidate &candidate, const char *name, const FuzzCase &fuzz_case, long long &steps)
+    {
+        if (!run_fuzz_case(reference, candidate, fuzz_case, &steps).found)
+            return;
+
+        std::unique_ptr<Failure> found(new Failure);
+        found->backend = name;
+        found->found = fuzz_case;
+        found->shrunk = shrink_fuzz_case(reference, candidate, fuzz_case);
+        found->mismatch = run_fuzz_case(reference, candidate, found->shrunk);
+
+        std::lock_guard<std::mutex> lock(failure_mutex);
+        if (!failure)
+            failure = std::move(found);
+        stop.store(true);
+    }
+
+    const char *name_of(HugeGameBoard &) { return "HugeGameBoard"; }
+    template <int W, int H>
+    const char *name_of(FixedGameBoard<W, H> &) { return "FixedGameBoard"; }
+
+    // every case goes to every candidate, the counters are only touched every so often so the
+    // threads don't fight over them
+    template <typename... Candidates>
+    void fuzz(const Options &options, int thread, Candidates &...candidates)
+    {
+        int height = options.height;
+        int width = options.width;
+        GameBoard reference(height, width);
+        std::minstd_rand rng(options.seed + 7919u * thread);
+        FuzzCase fuzz_case;
+        long long steps = 0;
+        long long cases = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            random_fuzz_case(rng, options.max_steps, fuzz_case);
+            int checked[] = {(check(reference, candidates, name_of(candidates), fuzz_case, steps), 0)...};
+            (void)checked;
+            if (++cases % 64 == 0)
+            {
+                total_steps.fetch_add(steps, std::memory_order_relaxed);
+                total_cases.fetch_add(cases, std::memory_order_relaxed);
+                steps = cases = 0;
+            }
+        }
+        total_steps.fetch_add(steps, std::memory_order_relaxed);
+        total_cases.fetch_add(cases, std::memory_order_relaxed);
+    }
+
+    // the fixed board of the size (if there is one) along with the huge one, whichever are asked for
+    void worker(const Options &options, int thread)
+    {
+        bool with_fixed = options.backend != "huge";
+        bool with_huge = options.backend != "fixed";
+        HugeGameBoard huge(options.height, options.width);
+        auto run = [&](auto &fixed)
+        {
+            if (with_huge)
+                fuzz(options, thread, fixed, huge);
+            else
+                fuzz(options, thread, fixed);
+        };
+
+        if (with_fixed && options.width == 15 && options.height == 25)
+        {
+            FixedGameBoard<15, 25> fixed;
+            run(fixed);
+        }
+        else if (with_fixed && options.width == 10 && options.height == 20)
+        {
+            FixedGameBoard<10, 20> fixed;
+            run(fixed);
+        }
+        else if (with_fixed && options.width == 7 && options.height == 15)
+        {
+            FixedGameBoard<7, 15> fixed;
+            run(fixed);
+        }
+        else
+            fuzz(options, thread, huge);
+    }
+
+    bool parse_options(int argc, char **argv, Options &options)
+    {
+        try
+        {
+            for (int i = 1; i + 1 < argc; i += 2)
+            {
+                std::string option = argv[i];
+                std::string value = argv[i + 1];
+                if (option == "--backend" && (value == "all" || value == "fixed" || value == "huge"))
+                    options.backend = value;
+                else if (option == "--board")
+                {
+                    if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2)
+                        options.width = 0; // caught below
+                }
+                else if (option == "--threads")
+                    options.threads = std::max(1, std::stoi(value));
+                else if (option == "--seconds")
+                    options.seconds = std::stod(value);
+                else if (option == "--seed")
+                    options.seed = static_cast<unsigned>(std::stoul(value));
+                else if (option == "--max-steps")
+                    options.max_steps = std::max(1, std::stoi(value));
+                else
+                    return false;
+            }
+        }
+        catch (const std::logic_error &)
+        {
+            return false;
+        }
+        if (argc % 2 == 0)
+            return false; // an option without its value
+        if (options.width < 5 || options.height < 5 || options.width > 50 || options.height > 50)
+        {
+            std::cerr << "Boards go from 5x5 to 50x50, GameBoard is the reference" << std::endl;
+            return false;
+        }
+        bool fixed_size = (options.width == 15 && options.height == 25) || (options.width == 10 && options.height == 20) ||
+                          (options.width == 7 && options.height == 15);
+        if (options.backend == "fixed" && !fixed_size)
+        {
+            std::cerr << "FixedGameBoard only comes in 15x25, 10x20 and 7x15" << std::endl;
+            return false;
+        }
+        return options.seconds >= 0;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::cerr << "usage: " << argv[0] << " [--backend all|fixed|huge] [--board 10x20] [--threads N] [--seconds 10]\n"
+                  << "       [--seed N] [--max-steps 2000]" << std::endl;
+        return 1;
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; ++t)
+        workers.emplace_back(worker, std::cref(options), t);
+
+    // this thread only keeps the time and says how it's going
+    auto next_report = start + std::chrono::seconds(10);
+    while (!stop.load())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto now = Clock::now();
+        if (options.seconds > 0 && now - start >= std::chrono::duration<double>(options.seconds))
+            stop.store(true);
+        if (now >= next_report)
+        {
+            double seconds = std::chrono::duration<double>(now - start).count();
+            std::fprintf(stderr, "%.0fs: %lld cases, %lld steps (%.2f M steps/s)\n", seconds, total_cases.load(),
+                         total_steps.load(), total_steps.load() / seconds / 1e6);
+            next_report += std::chrono::seconds(10);
+        }
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("seed %u, %s on %dx%d, %d thread(s): %lld cases, %lld steps in %.2fs (%.2f M steps/s)\n", options.seed,
+                options.backend.c_str(), options.width, options.height, options.threads, total_cases.load(),
+                total_steps.load(), seconds, total_steps.load() / seconds / 1e6);
+    if (!failure)
+    {
+        std::printf("no differences\n");
+        return 0;
+    }
+    std::printf("%s differs from GameBoard (%s) after %zu step(s), shrunk from %zu:\n%s\n", failure->backend.c_str(),
+                failure->mismatch.what.c_str(), failure->mismatch.step, failure->found.steps.size(),
+                format_fuzz_case(failure->shrunk).c_str());
+    return 1;
+}
@@ -0,0 +1,310 @@
+// Load generator for tetris_server.exe, opens lots of sessions and plays random moves on them
+// usage: ./tetris_loadgen.exe [--host 127.0.0.1] [--port 7777] [--sessions 1000] [--seconds 10]
+//                             [--rate 10] [--threads N]
+//
+// rate is inputs per second per session. Every input carries a sequence number and the server acks
+// the last one it applied in its update, so the time from sending an input to getting the update
+// that acks it is the latency we report
+#include "grid.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    using namespace tetris;
+    typedef std::chrono::steady_clock Clock;
+
+    const int board_width = 10;
+    const int board_height = 20;
+
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = 7777;
+        int sessions = 1000;
+        int seconds = 10;
+        int rate = 10;
+        int threads = 1;
+    };
+
+    struct Connection
+    {
+        int fd = -1;
+        bool connected = false;
+        std::uint32_t seq = 0;
+        std::uint32_t waiting_for = 0; // the seq we are timing, 0 if none
+        Clock::time_point sent_at;
+        Clock::time_point next_input;
+        protocol::BoardView view;
+        protocol::Buffer in;
+        protocol::Buffer out;
+    };
+
+    // what one thread saw, added up at the end
+    struct Results
+    {
+        std::vector<std::uint32_t> latencies_us;
+        std::uint64_t inputs = 0;
+        std::uint64_t updates = 0;
+        std::uint64_t bytes_in = 0;
+        std::uint64_t games = 0;
+        int connected = 0;
+        int failed = 0;
+    };
+
+    void send_out(Connection &connection)
+    {
+        while (!connection.out.empty())
+        {
+            ssize_t wrote = send(connection.fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+            if (wrote <= 0)
+                return;
+            connection.out.erase(connection.out.begin(), connection.out.begin() + wrote);
+        }
+    }
+
+    void run_thread(const Options &options, int sessions, Results &results)
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+
+        int epoll_fd = epoll_create1(0);
+        std::vector<Connection> connections(sessions);
+        std::mt19937 rng(std::random_device{}());
+        std::uniform_int_distribution<int> pick_input(0, 4);
+        auto interval = std::chrono::microseconds(1000000 / std::max(1, options.rate));
+
+        for (int i = 0; i < sessions; ++i)
+        {
+            Connection &connection = connections[i];
+            connection.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int on = 1;
+            setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            if (connect(connection.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 && errno != EINPROGRESS)
+            {
+                close(connection.fd);
+                connection.fd = -1;
+                ++results.failed;
+                continue;
+            }
+            protocol::write_hello(connection.out, board_width, board_height);
+
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.u32 = i;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection.fd, &event);
+        }
+
+        // the clock starts once everything is connecting, opening thousands of sockets takes a while.
+        // the first inputs are spread out so the sessions don't all fire together
+        auto start = Clock::now();
+        for (int i = 0; i < sessions; ++i)
+        {
+            connections[i].next_input = start + interval * i / sessions;
+        }
+        auto end = start + std::chrono::seconds(options.seconds);
+        std::vector<epoll_event> events(256);
+        while (Clock::now() < end)
+        {
+            int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 1);
+            for (int e = 0; e < ready; ++e)
+            {
+                Connection &connection = connections[events[e].data.u32];
+                if (events[e].events & (EPOLLERR | EPOLLHUP))
+                {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+                    close(connection.fd);
+                    connection.fd = -1;
+                    ++results.failed;
+                    continue;
+                }
+                if ((events[e].events & EPOLLOUT) && !connection.connected)
+                {
+                    // connected, from now on we only care about reading
+                    connection.connected = true;
+                    ++results.connected;
+                    epoll_event event{};
+                    event.events = EPOLLIN;
+                    event.data.u32 = events[e].data.u32;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+                    send_out(connection);
+                }
+                if (events[e].events & EPOLLIN)
+                {
+                    std::uint8_t chunk[16384];
+                    ssize_t got = read(connection.fd, chunk, sizeof(chunk));
+                    if (got <= 0)
+                        continue;
+                    results.bytes_in += got;
+                    connection.in.insert(connection.in.end(), chunk, chunk + got);
+
+                    std::size_t used = 0;
+                    protocol::MessageType type;
+                    const std::uint8_t *payload;
+                    std::size_t payload_size;
+                    while (protocol::next_message(connection.in.data() + used, connection.in.size() - used, type, payload, payload_size))
+                    {
+                        used += protocol::header_size + payload_size;
+                        if (type != protocol::MessageType::Update)
+                            continue;
+
+                        protocol::UpdateHeader header;
+                        connection.view.resize(board_width * board_height);
+                        if (!protocol::read_update(payload, payload_size, header, connection.view, board_width))
+                            continue;
+                        ++results.updates;
+
+                        if (connection.waiting_for && header.ack >= connection.waiting_for)
+                        {
+                            auto waited = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - connection.sent_at);
+                            results.latencies_us.push_back(static_cast<std::uint32_t>(waited.count()));
+                            connection.waiting_for = 0;
+                        }
+                        if (header.game_over)
+                        {
+                            // start another one straight away, a new game starts from an empty board
+                            ++results.games;
+                            std::fill(connection.view.begin(), connection.view.end(), 0);
+                            protocol::write_hello(connection.out, board_width, board_height);
+                            send_out(connection);
+                        }
+                    }
+                    connection.in.erase(connection.in.begin(), connection.in.begin() + used);
+                }
+            }
+
+            auto now = Clock::now();
+            for (Connection &connection : connections)
+            {
+                if (!connection.connected || connection.fd < 0 || now < connection.next_input)
+                    continue;
+
+                connection.next_input += interval;
+                protocol::write_input(connection.out, static_cast<Input>(pick_input(rng)), ++connection.seq);
+                if (!connection.waiting_for)
+                {
+                    connection.waiting_for = connection.seq;
+                    connection.sent_at = now;
+                }
+                ++results.inputs;
+                send_out(connection);
+            }
+        }
+
+        for (Connection &connection : connections)
+        {
+            if (connection.fd >= 0)
+                close(connection.fd);
+        }
+        close(epoll_fd);
+    }
+
+    double percentile(const std::vector<std::uint32_t> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        std::size_t index = static_cast<std::size_t>(p / 100.0 * (sorted.size() - 1));
+        return sorted[index] / 1000.0;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    bool good = true;
+    try
+    {
+        for (int i = 1; good && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            std::string value = argv[i + 1];
+            if (option == "--host")
+                options.host = value;
+            else if (option == "--port")
+                options.port = std::stoi(value);
+            else if (option == "--sessions")
+                options.sessions = std::stoi(value);
+            else if (option == "--seconds")
+                options.seconds = std::stoi(value);
+            else if (option == "--rate")
+                options.rate = std::stoi(value);
+            else if (option == "--threads")
+                options.threads = std::stoi(value);
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good)
+    {
+        std::cerr << "usage: " << argv[0] << " [--host 127.0.0.1] [--port 7777] [--sessions 1000]"
+                  << " [--seconds 10] [--rate 10] [--threads N]" << std::endl;
+        return 1;
+    }
+    options.threads = std::max(1, std::min(options.threads, options.sessions));
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::vector<Results> results(options.threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < options.threads; ++t)
+    {
+        int sessions = options.sessions / options.threads + (t < options.sessions % options.threads ? 1 : 0);
+        threads.emplace_back(run_thread, std::cref(options), sessions, std::ref(results[t]));
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    Results total;
+    for (Results &r : results)
+    {
+        total.latencies_us.insert(total.latencies_us.end(), r.latencies_us.begin(), r.latencies_us.end());
+        total.inputs += r.inputs;
+        total.updates += r.updates;
+        total.bytes_in += r.bytes_in;
+        total.games += r.games;
+        total.connected += r.connected;
+        total.failed += r.failed;
+    }
+    std::sort(total.latencies_us.begin(), total.latencies_us.end());
+
+    double seconds = options.seconds;
+    std::printf("sessions  %d connected, %d failed\n", total.connected, total.failed);
+    std::printf("inputs    %.0f/s\n", total.inputs / seconds);
+    std::printf("updates   %.0f/s  (%.1f bytes each)\n", total.updates / seconds,
+                total.updates ? static_cast<double>(total.bytes_in) / total.updates : 0.0);
+    std::printf("games     %llu finished\n", static_cast<unsigned long long>(total.games));
+    std::printf("latency   p50 %.3f ms  p99 %.3f ms  p99.9 %.3f ms  max %.3f ms  (%zu samples)\n",
+                percentile(total.latencies_us, 50), percentile(total.latencies_us, 99),
+                percentile(total.latencies_us, 99.9), percentile(total.latencies_us, 100),
+                total.latencies_us.size());
+    return 0;
+}
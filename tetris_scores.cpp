@@ -0,0 +1,134 @@
+// Shows the high scores tetris.exe keeps, and can fill them up with headless games
+// usage: ./tetris_scores.exe [--file tetris_scores.dat] [--board 10x20] [--top 10] [--play N]
+//
+// --play N plays N games on the board with a random bot and adds every one of them, then the top
+// scores are printed like always
+#include "grid.hpp"
+#include "leaderboard.hpp"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace tetris;
+    typedef std::chrono::steady_clock Clock;
+
+    // a random bot with a row of gravity after every move, so the games end quickly
+    ScoreRecord play(int height, int width, unsigned seed, std::mt19937 &bot)
+    {
+        auto start = Clock::now();
+        GameBoard board(height, width);
+        board.seed(seed);
+        board.generate_new_piece();
+        std::uniform_int_distribution<int> pick(0, 4);
+        while (!board.is_game_over())
+        {
+            board.handle_input(static_cast<Input>(pick(bot)));
+            board.move_down();
+        }
+
+        ScoreRecord record;
+        record.timestamp = static_cast<std::uint64_t>(std::time(nullptr));
+        record.score = board.get_score();
+        record.lines = board.lines_cleared_count();
+        record.seed = seed;
+        record.duration_ms = static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+        record.width = width;
+        record.height = height;
+        return record;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    std::string file = "tetris_scores.dat";
+    int width = 10;
+    int height = 20;
+    int count = 10;
+    long games = 0;
+
+    bool good = true;
+    try
+    {
+        for (int i = 1; good && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            std::string value = argv[i + 1];
+            if (option == "--file")
+                file = value;
+            else if (option == "--board")
+            {
+                if (std::sscanf(value.c_str(), "%dx%d", &width, &height) != 2)
+                    width = 0; // caught below
+            }
+            else if (option == "--top")
+                count = std::stoi(value);
+            else if (option == "--play")
+                games = std::stol(value);
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good)
+    {
+        std::cerr << "usage: " << argv[0] << " [--file tetris_scores.dat] [--board 10x20] [--top 10] [--play N]" << std::endl;
+        return 1;
+    }
+    if (width < 5 || height < 5 || width > 50 || height > 50)
+    {
+        std::cerr << "Boards go from 5x5 to 50x50" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        Leaderboard leaderboard(file);
+
+        if (games > 0)
+        {
+            std::mt19937 bot(std::random_device{}());
+            auto start = Clock::now();
+            for (long game = 0; game < games; ++game)
+            {
+                leaderboard.add(play(height, width, bot(), bot));
+            }
+            // once for the whole run, not once a game
+            leaderboard.flush();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            std::printf("played %ld games in %.2fs (%.0f/s)\n", games, seconds, games / seconds);
+        }
+
+        auto start = Clock::now();
+        std::vector<ScoreRecord> best = leaderboard.top(width, height, count);
+        double query_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+        std::printf("%llu games in %s, the best %zu on %dx%d (%.1f us):\n",
+                    static_cast<unsigned long long>(leaderboard.size()), file.c_str(), best.size(), width, height, query_us);
+        for (std::size_t i = 0; i < best.size(); ++i)
+        {
+            char when[32];
+            std::time_t timestamp = static_cast<std::time_t>(best[i].timestamp);
+            std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M", std::localtime(&timestamp));
+            std::printf("%4zu. %8u  %5u lines  seed %10u  %7.1fs  %s\n", i + 1, best[i].score, best[i].lines,
+                        best[i].seed, best[i].duration_ms / 1000.0, when);
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
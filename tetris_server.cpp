@@ -0,0 +1,428 @@
+// Headless game server, every TCP connection plays its own game on the server
+// usage: ./tetris_server.exe [--port 7777] [--threads N]
+//
+// Each worker thread has its own listening socket on the same port (SO_REUSEPORT, the kernel spreads
+// the connections out), its own epoll loop and its own pool of sessions, so the threads never share
+// anything. Inputs that arrive together are applied together and answered with one delta update.
+#include "grid.hpp"
+#include "object_pool.hpp"
+#include "protocol.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    using namespace tetris;
+
+    std::atomic<bool> stopping{false};
+
+    // gravity is half a second like the real game, but the sessions are split into slots that each
+    // get their turn on a different timer tick, so the work doesn't all land at once
+    const int gravity_slots = 8;
+    const long long gravity_tick_ns = 500000000LL / gravity_slots;
+
+    // a client that doesn't read its updates gets dropped instead of growing the buffer forever
+    const std::size_t max_pending_output = 1 << 20;
+
+    struct Session
+    {
+        int fd = -1;
+        std::size_t index = 0; // where it is in Worker::sessions
+        int gravity_slot = 0;
+        GameBoard board;
+        bool playing = false;
+        bool dirty = false;   // the client needs an update
+        bool writing = false; // waiting for EPOLLOUT
+        std::uint32_t ack = 0;
+        protocol::BoardView sent; // what the client has
+        protocol::BoardView view; // what it should have
+        protocol::Buffer in;      // read but not handled yet
+        protocol::Buffer out;     // not written yet
+    };
+
+    class Worker
+    {
+    public:
+        explicit Worker(int port) : port(port) {}
+
+        void run()
+        {
+            if (!setup())
+                return;
+
+            std::vector<epoll_event> events(256);
+            while (!stopping.load(std::memory_order_relaxed))
+            {
+                int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 200);
+                for (int i = 0; i < ready; ++i)
+                {
+                    epoll_event &event = events[i];
+                    if (event.data.ptr == &listen_fd)
+                        accept_all();
+                    else if (event.data.ptr == &timer_fd)
+                        gravity();
+                    else
+                        handle(static_cast<Session *>(event.data.ptr), event.events);
+                }
+                flush_dirty();
+            }
+
+            while (!sessions.empty())
+                drop(sessions.back());
+            close(timer_fd);
+            close(listen_fd);
+            close(epoll_fd);
+        }
+
+        std::size_t served() const
+        {
+            return total_sessions;
+        }
+
+    private:
+        bool setup()
+        {
+            listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int on = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port);
+            if (bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+                listen(listen_fd, SOMAXCONN) != 0)
+            {
+                std::cerr << "Cannot listen on port " << port << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+
+            epoll_fd = epoll_create1(0);
+            watch(listen_fd, EPOLLIN, &listen_fd);
+
+            timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+            itimerspec interval{};
+            interval.it_interval.tv_nsec = gravity_tick_ns;
+            interval.it_value.tv_nsec = gravity_tick_ns;
+            timerfd_settime(timer_fd, 0, &interval, nullptr);
+            watch(timer_fd, EPOLLIN, &timer_fd);
+            return true;
+        }
+
+        void watch(int fd, std::uint32_t flags, void *tag)
+        {
+            epoll_event event{};
+            event.events = flags;
+            event.data.ptr = tag;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        void accept_all()
+        {
+            for (;;)
+            {
+                int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+                if (fd < 0)
+                    return;
+
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+                Session *session = pool.acquire();
+                session->fd = fd;
+                session->index = sessions.size();
+                session->gravity_slot = static_cast<int>(total_sessions % gravity_slots);
+                session->playing = false;
+                session->dirty = false;
+                session->writing = false;
+                session->ack = 0;
+                session->sent.clear();
+                session->in.clear();
+                session->out.clear();
+                sessions.push_back(session);
+                ++total_sessions;
+
+                watch(fd, EPOLLIN | EPOLLRDHUP, session);
+            }
+        }
+
+        void drop(Session *session)
+        {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->fd, nullptr);
+            close(session->fd);
+
+            // swap it with the last one so removing is O(1)
+            Session *last = sessions.back();
+            sessions[session->index] = last;
+            last->index = session->index;
+            sessions.pop_back();
+
+            session->dirty = false;
+            session->fd = -1;
+            pool.release(session);
+        }
+
+        void handle(Session *session, std::uint32_t flags)
+        {
+            if (flags & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+            {
+                drop(session);
+                return;
+            }
+            if ((flags & EPOLLOUT) && !write_out(session))
+                return;
+            if (flags & EPOLLIN)
+                read_in(session);
+        }
+
+        void read_in(Session *session)
+        {
+            std::uint8_t chunk[4096];
+            ssize_t got = read(session->fd, chunk, sizeof(chunk));
+            if (got <= 0)
+            {
+                if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                    drop(session);
+                return;
+            }
+            session->in.insert(session->in.end(), chunk, chunk + got);
+
+            std::size_t used = 0;
+            protocol::MessageType type;
+            const std::uint8_t *payload;
+            std::size_t payload_size;
+            while (protocol::next_message(session->in.data() + used, session->in.size() - used, type, payload, payload_size))
+            {
+                used += protocol::header_size + payload_size;
+                if (!apply(session, type, payload, payload_size))
+                {
+                    drop(session);
+                    return;
+                }
+            }
+            session->in.erase(session->in.begin(), session->in.begin() + used);
+        }
+
+        // returns false for a message the client shouldn't have sent
+        bool apply(Session *session, protocol::MessageType type, const std::uint8_t *payload, std::size_t size)
+        {
+            if (type == protocol::MessageType::Hello)
+            {
+                int width, height;
+                if (!protocol::read_hello(payload, size, width, height))
+                    return false;
+
+                // a pooled session keeps its board if the size is the same
+                if (session->board.getWidth() == width && session->board.getHeight() == height)
+                    session->board.reset();
+                else
+                    session->board = GameBoard(height, width);
+                session->board.generate_new_piece();
+                session->playing = true;
+                session->sent.clear();
+                mark_dirty(session);
+                return true;
+            }
+
+            if (type == protocol::MessageType::Input)
+            {
+                Input input;
+                std::uint32_t seq;
+                if (!protocol::read_input(payload, size, input, seq))
+                    return false;
+                if (session->playing)
+                    session->board.handle_input(input);
+                session->ack = seq;
+                mark_dirty(session);
+                return true;
+            }
+            return false;
+        }
+
+        void gravity()
+        {
+            std::uint64_t expirations = 0;
+            if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                return;
+
+            for (std::uint64_t e = 0; e < expirations; ++e)
+            {
+                int slot = static_cast<int>(gravity_tick++ % gravity_slots);
+                for (Session *session : sessions)
+                {
+                    if (session->playing && session->gravity_slot == slot)
+                    {
+                        session->board.move_down();
+                        mark_dirty(session);
+                    }
+                }
+            }
+        }
+
+        void mark_dirty(Session *session)
+        {
+            if (!session->dirty)
+            {
+                session->dirty = true;
+                dirty.push_back(session);
+            }
+        }
+
+        // one update per session per loop, however many inputs it sent
+        void flush_dirty()
+        {
+            for (std::size_t i = 0; i < dirty.size(); ++i)
+            {
+                Session *session = dirty[i];
+                if (!session->dirty || session->fd < 0)
+                    continue;
+                session->dirty = false;
+
+                protocol::UpdateHeader header;
+                header.ack = session->ack;
+                header.score = session->board.get_score();
+                header.lines = session->board.lines_cleared_count();
+                header.game_over = session->playing && session->board.is_game_over();
+                if (header.game_over)
+                    session->playing = false;
+
+                protocol::render_view(session->board, session->view);
+                protocol::write_update(session->out, header, session->sent, session->view, session->board.getWidth());
+                if (!session->writing)
+                    write_out(session);
+            }
+            dirty.clear();
+        }
+
+        // returns false if the session got dropped
+        bool write_out(Session *session)
+        {
+            while (!session->out.empty())
+            {
+                ssize_t wrote = send(session->fd, session->out.data(), session->out.size(), MSG_NOSIGNAL);
+                if (wrote < 0)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        break;
+                    drop(session);
+                    return false;
+                }
+                session->out.erase(session->out.begin(), session->out.begin() + wrote);
+            }
+
+            if (session->out.size() > max_pending_output)
+            {
+                drop(session);
+                return false;
+            }
+
+            // only ask for EPOLLOUT while there is something waiting, otherwise it fires all the time
+            bool want_write = !session->out.empty();
+            if (want_write != session->writing)
+            {
+                session->writing = want_write;
+                epoll_event event{};
+                event.events = EPOLLIN | EPOLLRDHUP | (want_write ? static_cast<std::uint32_t>(EPOLLOUT) : 0u);
+                event.data.ptr = session;
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->fd, &event);
+            }
+            return true;
+        }
+
+        int port;
+        int listen_fd = -1;
+        int epoll_fd = -1;
+        int timer_fd = -1;
+        std::uint64_t gravity_tick = 0;
+        std::size_t total_sessions = 0;
+        ObjectPool<Session> pool;
+        std::vector<Session *> sessions;
+        std::vector<Session *> dirty;
+    };
+
+    void on_signal(int)
+    {
+        stopping.store(true);
+    }
+
+    // tens of thousands of sockets need more than the usual 1024 file descriptors
+    void raise_fd_limit()
+    {
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    int port = 7777;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    bool good = true;
+    try
+    {
+        for (int i = 1; good && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            if (option == "--port")
+                port = std::stoi(argv[i + 1]);
+            else if (option == "--threads")
+                threads = std::stoi(argv[i + 1]);
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good)
+    {
+        std::cerr << "usage: " << argv[0] << " [--port 7777] [--threads N]" << std::endl;
+        return 1;
+    }
+    if (threads < 1)
+        threads = 1;
+
+    raise_fd_limit();
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> running;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back(new Worker(port));
+        running.emplace_back(&Worker::run, workers.back().get());
+    }
+    std::cout << "tetris_server listening on port " << port << " with " << threads << " thread(s)" << std::endl;
+
+    std::size_t served = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        running[i].join();
+        served += workers[i]->served();
+    }
+    std::cout << "served " << served << " session(s)" << std::endl;
+    return 0;
+}
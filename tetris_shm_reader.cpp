@@ -0,0 +1,78 @@
+// Prints the state of a running tetris.exe that was started with TETRIS_SHM set
+// usage: ./tetris_shm_reader.exe [name] [--watch]
+#include "shared_state.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+    void print_state(const tetris::SharedGameSnapshot &snap)
+    {
+        std::cout << "score " << snap.score << "  lines " << snap.lines_cleared
+                  << "  block " << snap.block << " at (" << snap.b_x << ", " << snap.b_y << ")"
+                  << "  rotation " << snap.rotation << (snap.game_over ? "  GAME OVER" : "") << std::endl;
+
+        for (int y = 0; y < snap.height; ++y)
+        {
+            std::string line;
+            for (int x = 0; x < snap.width; ++x)
+            {
+                int py = y - snap.b_y;
+                int px = x - snap.b_x;
+                bool piece = py >= 0 && py < snap.piece_size && px >= 0 && px < snap.piece_size && snap.piece[py][px];
+                if (piece)
+                    line += '@';
+                else if (snap.cells[y][x])
+                    line += '#';
+                else
+                    line += '.';
+            }
+            std::cout << line << std::endl;
+        }
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    std::string name = "/tetris";
+    bool watch = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--watch") == 0)
+            watch = true;
+        else
+            name = argv[i];
+    }
+
+    try
+    {
+        tetris::SharedStateReader reader(name);
+        tetris::SharedGameSnapshot snap;
+        do
+        {
+            if (reader.read(snap))
+            {
+                print_state(snap);
+                if (snap.game_over)
+                    break;
+            }
+            else
+            {
+                std::cout << "waiting for the first tick..." << std::endl;
+            }
+            if (watch)
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        } while (watch);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Works out every pile a small board can get to and which of them can be kept going forever, then
+// writes it all into a binary table bots can look piles up in (survival.hpp)
+// usage: ./tetris_solve.exe [--width 7] [--rows 4] [--threads N] [--horizon 100] [--memory-mb 1024]
+//                           [--tmp /tmp] [--out survival.tbl]
+//
+// The board is width wide and the pile has to stay in its bottom rows rows (the rest of the board
+// can be as tall as you like, it's only ever empty). The piles are worked through a piece at a time
+// in sorted files in the --tmp directory, --memory-mb is how much of them is sorted in memory
+// before it goes to disk, so a big solve takes disk rather than memory. Each pass is split over
+// the threads. When it's done it prints how many piles survive whatever pieces come, and what
+// the table says about the empty board
+#include "survival.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+int main(int argc, char **argv)
+{
+    tetris::SolverOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    bool good = argc % 2 == 1;
+    try
+    {
+        for (int i = 1; good && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            std::string value = argv[i + 1];
+            if (option == "--width")
+                options.width = std::stoi(value);
+            else if (option == "--rows")
+                options.rows = std::stoi(value);
+            else if (option == "--threads")
+                options.threads = std::max(1, std::stoi(value));
+            else if (option == "--horizon")
+                options.horizon = std::max(0, std::stoi(value));
+            else if (option == "--memory-mb")
+                options.memory = std::size_t(std::max(1, std::stoi(value))) << 20;
+            else if (option == "--tmp")
+                options.work_dir = value;
+            else if (option == "--out")
+                options.out = value;
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good)
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [--width 7] [--rows 4] [--threads N] [--horizon 100] [--memory-mb 1024] [--tmp /tmp]"
+                     " [--out survival.tbl]"
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        tetris::SolverStats stats = tetris::solve_survival(options, std::cout);
+        tetris::SurvivalTable table(options.out);
+        tetris::SurvivalAnswer empty = table.lookup(0);
+        std::printf("%dx%d: %llu piles, %llu moves, %llu (%.2f%%) survive forever, found in %d pieces\n",
+                    options.width, options.rows, static_cast<unsigned long long>(stats.states),
+                    static_cast<unsigned long long>(stats.edges), static_cast<unsigned long long>(stats.survivors),
+                    100.0 * stats.survivors / stats.states, stats.levels);
+        std::printf("the empty board %s survive forever and gets through %d random pieces %.1f%% of the time\n",
+                    empty.survives ? "can" : "can't", table.horizon(), 100 * empty.chance);
+        std::printf("%.1fs with %d thread(s), the work files took up to %.1f MB, %s\n", stats.seconds,
+                    options.threads, stats.disk_bytes / 1e6, options.out.c_str());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
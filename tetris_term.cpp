@@ -0,0 +1,131 @@
+// Plays the game in the terminal, for machines with no display (over SSH, say)
+// usage: ./tetris_term.exe [--board 10x20] [--seed N] [--policy human|bot] [--max-speed]
+//
+// Arrows or WASD move, space drops, q quits. The board runs on a simulation thread like in
+// tetris.exe and 30 times a second the newest snapshot is drawn, only the cells that changed go
+// out. When it's over it says how many bytes the frames took, next to what redrawing the whole
+// board every frame would have
+#include "bot.hpp"
+#include "grid.hpp"
+#include "simulation.hpp"
+#include "terminal.hpp"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int frames_per_second = 30;
+    const int bot_move_ticks = 6; // the same pace as tetris.exe
+}
+
+int main(int argc, char **argv)
+{
+    int width = 10;
+    int height = 20;
+    unsigned seed = std::random_device{}();
+    bool bot_plays = false;
+    bool max_speed = false;
+
+    bool good = true;
+    try
+    {
+        for (int i = 1; good && i < argc; ++i)
+        {
+            std::string option = argv[i];
+            bool has_value = i + 1 < argc;
+            if (option == "--board" && has_value)
+            {
+                if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2)
+                    width = 0; // caught below
+            }
+            else if (option == "--seed" && has_value)
+                seed = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (option == "--policy" && has_value && (std::string(argv[i + 1]) == "human" || std::string(argv[i + 1]) == "bot"))
+                bot_plays = std::string(argv[++i]) == "bot";
+            else if (option == "--max-speed")
+                max_speed = true;
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good)
+    {
+        std::cerr << "usage: " << argv[0] << " [--board 10x20] [--seed N] [--policy human|bot] [--max-speed]" << std::endl;
+        return 1;
+    }
+    if (width < 5 || height < 5 || width > 50 || height > 50)
+    {
+        std::cerr << "Boards go from 5x5 to 50x50" << std::endl;
+        return 1;
+    }
+
+    tetris::GameBoard board(height, width);
+    board.seed(seed);
+    board.generate_new_piece();
+    tetris::Bot bot(height, width);
+    tetris::Simulation simulation(board);
+    simulation.set_max_speed(max_speed);
+    if (bot_plays)
+        simulation.set_bot(&bot, bot_move_ticks);
+
+    tetris::TerminalRenderer renderer(height, width);
+    double seconds = 0;
+    {
+        tetris::RawTerminal terminal;
+        auto start = Clock::now();
+        auto next_frame = start;
+        bool quit = false;
+        simulation.start();
+
+        while (!quit)
+        {
+            // keys until it's time for the next frame
+            next_frame += std::chrono::microseconds(1000000 / frames_per_second);
+            for (;;)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next_frame - Clock::now()).count();
+                if (left <= 0)
+                    break;
+                tetris::TerminalKey key = terminal.read_key(static_cast<int>(left));
+                tetris::Input input;
+                if (key == tetris::TerminalKey::Quit)
+                    quit = true;
+                else if (key_input(key, input))
+                    simulation.push_input(input);
+            }
+
+            simulation.update_snapshot();
+            renderer.draw(simulation.snapshot());
+            if (simulation.snapshot().game_over)
+            {
+                // the last frame stays up for a moment so the GAME OVER can be read
+                terminal.read_key(1500);
+                quit = true;
+            }
+        }
+        simulation.stop();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    std::cout << "Your Score was " << board.get_score() << std::endl;
+    std::cout << "You cleared " << board.lines_cleared_count() << " line(s)" << std::endl;
+
+    // the first frame is a full redraw, the rest are the changes
+    std::uint64_t frames = renderer.frames();
+    std::printf("%llu frames, %.1f bytes/frame on average (%zu at most), %.0f bytes/s. A full redraw is %zu bytes,\n"
+                "%.0f bytes/s at %d frames a second\n",
+                static_cast<unsigned long long>(frames), frames ? static_cast<double>(renderer.bytes()) / frames : 0.0,
+                renderer.max_frame_bytes(), seconds > 0 ? renderer.bytes() / seconds : 0.0, renderer.full_frame_bytes(),
+                static_cast<double>(renderer.full_frame_bytes()) * frames_per_second, frames_per_second);
+    return 0;
+}
@@ -0,0 +1,184 @@
+// Checks submitted scores: plays every replay in a directory back through GameBoard and compares
+// the score and lines it ends with to the ones the replay says it got
+// usage: ./tetris_verify.exe --dir replays [--threads N]
+//
+// The replays are memory mapped and parsed where they are, each thread takes the next file as it
+// finishes one and plays it on a board of its own (kept between replays of the same size). Nothing
+// is drawn and gravity comes from the tick count, so a game plays out as fast as the board can go.
+// Every replay that doesn't check out is printed with what's wrong with it, the totals and how fast
+// it went come at the end. The exit code is 1 when any of them didn't check out
+#include "grid.hpp"
+#include "replay.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // the mapping is only around while the replay is parsed, the moves are copied out of it
+    tetris::Replay map_replay(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            throw std::runtime_error(path + " is empty");
+        }
+        std::size_t size = info.st_size;
+        void *memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping keeps the file
+        if (memory == MAP_FAILED)
+            throw std::runtime_error("Cannot map " + path);
+        madvise(memory, size, MADV_SEQUENTIAL);
+
+        try
+        {
+            tetris::Replay replay = tetris::Replay::parse(static_cast<const char *>(memory), size);
+            munmap(memory, size);
+            return replay;
+        }
+        catch (const std::runtime_error &e)
+        {
+            munmap(memory, size);
+            throw std::runtime_error(path + " " + e.what());
+        }
+    }
+
+    // the boards a thread has made so far, one per size, GameBoard takes a while to make
+    tetris::GameBoard &board_for(std::vector<std::unique_ptr<tetris::GameBoard>> &boards, int height, int width)
+    {
+        for (std::unique_ptr<tetris::GameBoard> &board : boards)
+        {
+            if (board->getHeight() == height && board->getWidth() == width)
+                return *board;
+        }
+        boards.emplace_back(new tetris::GameBoard(height, width));
+        return *boards.back();
+    }
+
+    // every file in the directory but the hidden ones, sorted so the report comes out the same every time
+    std::vector<std::string> list_replays(const std::string &dir)
+    {
+        DIR *listing = opendir(dir.c_str());
+        if (!listing)
+            throw std::runtime_error("Cannot open the directory " + dir);
+        std::vector<std::string> paths;
+        while (dirent *entry = readdir(listing))
+        {
+            if (entry->d_name[0] == '.' || entry->d_type == DT_DIR)
+                continue;
+            paths.push_back(dir + "/" + entry->d_name);
+        }
+        closedir(listing);
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool good = argc % 2 == 1;
+    try
+    {
+        for (int i = 1; good && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            std::string value = argv[i + 1];
+            if (option == "--dir")
+                dir = value;
+            else if (option == "--threads")
+                threads = std::max(1, std::stoi(value));
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good || dir.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " --dir replays [--threads N]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    try
+    {
+        paths = list_replays(dir);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // problems[i] stays empty when paths[i] checked out
+    std::vector<std::string> problems(paths.size());
+    std::atomic<std::size_t> next{0};
+    std::atomic<long long> total_ticks{0};
+    std::atomic<int> unreadable{0};
+    auto start = Clock::now();
+
+    auto verify = [&]()
+    {
+        std::vector<std::unique_ptr<tetris::GameBoard>> boards;
+        long long ticks = 0;
+        for (std::size_t i = next++; i < paths.size(); i = next++)
+        {
+            try
+            {
+                tetris::Replay replay = map_replay(paths[i]);
+                tetris::ReplayCheck check = tetris::verify_replay(replay, board_for(boards, replay.height, replay.width));
+                ticks += check.ticks;
+                if (!check.ok)
+                    problems[i] = paths[i] + " " + check.problem;
+            }
+            catch (const std::runtime_error &e)
+            {
+                problems[i] = e.what();
+                unreadable.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        total_ticks.fetch_add(ticks, std::memory_order_relaxed);
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back(verify);
+    for (std::thread &worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::size_t failed = 0;
+    for (const std::string &problem : problems)
+    {
+        if (problem.empty())
+            continue;
+        std::printf("%s\n", problem.c_str());
+        ++failed;
+    }
+    std::printf("%zu replay(s): %zu ok, %zu wrong, %d unreadable in %.3fs with %d thread(s) (%.0f replays/s, %.1f M ticks/s)\n",
+                paths.size(), paths.size() - failed, failed - unreadable.load(), unreadable.load(), seconds, threads,
+                paths.size() / seconds, total_ticks.load() / seconds / 1e6);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,295 @@
+// Two player versus over UDP with rollback, headless with a random bot on each side
+// usage: ./tetris_versus.exe --player 0|1 [--port 9000] [--peer-port 9001] [--host 127.0.0.1]
+//                            [--seed 1] [--ticks 1200] [--latency 0] [--jitter 0] [--loss 0]
+//
+// Run one process per player, e.g. on loopback:
+//   ./tetris_versus.exe --player 0 --port 9000 --peer-port 9001 --latency 60 --jitter 20 --loss 0.1 &
+//   ./tetris_versus.exe --player 1 --port 9001 --peer-port 9000 --latency 60 --jitter 20 --loss 0.1
+// Both print the checksum of the last tick, and they have to match. latency and jitter are in ms
+// and loss is the fraction of packets dropped, all applied on the sending side
+#include "versus.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <netinet/in.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    using namespace tetris;
+    typedef std::chrono::steady_clock Clock;
+
+    const int ticks_per_second = 60;
+
+    // the most inputs one packet carries (the count is a byte)
+    const std::uint32_t max_inputs = 255;
+
+    // [first_tick u32][count u8][count inputs][confirmed u32][checksum_tick u32][checksum u32]
+    struct Packet
+    {
+        std::uint32_t first_tick = 0;
+        std::vector<TickInput> inputs;
+        std::uint32_t confirmed = 0; // the sender has all of our inputs before this tick
+        std::uint32_t checksum_tick = 0;
+        std::uint32_t checksum = 0;
+        bool has_checksum = false;
+    };
+
+    void put_u32(std::vector<std::uint8_t> &out, std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back((value >> (8 * i)) & 0xff);
+    }
+
+    std::uint32_t get_u32(const std::uint8_t *data)
+    {
+        return static_cast<std::uint32_t>(data[0]) | static_cast<std::uint32_t>(data[1]) << 8 |
+               static_cast<std::uint32_t>(data[2]) << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+    }
+
+    std::vector<std::uint8_t> encode(const Packet &packet)
+    {
+        std::vector<std::uint8_t> out;
+        put_u32(out, packet.first_tick);
+        out.push_back(static_cast<std::uint8_t>(packet.inputs.size()));
+        out.insert(out.end(), packet.inputs.begin(), packet.inputs.end());
+        put_u32(out, packet.confirmed);
+        out.push_back(packet.has_checksum);
+        put_u32(out, packet.checksum_tick);
+        put_u32(out, packet.checksum);
+        return out;
+    }
+
+    bool decode(const std::uint8_t *data, std::size_t size, Packet &packet)
+    {
+        if (size < 5)
+            return false;
+        packet.first_tick = get_u32(data);
+        std::size_t count = data[4];
+        if (size != 5 + count + 13)
+            return false;
+        packet.inputs.assign(data + 5, data + 5 + count);
+        const std::uint8_t *rest = data + 5 + count;
+        packet.confirmed = get_u32(rest);
+        packet.has_checksum = rest[4] != 0;
+        packet.checksum_tick = get_u32(rest + 5);
+        packet.checksum = get_u32(rest + 9);
+        return true;
+    }
+
+    // Pretends the network is worse than loopback: holds packets back for latency +- jitter and
+    // drops some. Packets can come out in a different order, like on a real network
+    class LossyLink
+    {
+    public:
+        LossyLink(int fd, sockaddr_in peer, int latency_ms, int jitter_ms, double loss, unsigned seed)
+            : fd(fd), peer(peer), latency_ms(latency_ms), jitter_ms(jitter_ms), loss(loss), rng(seed) {}
+
+        void send(std::vector<std::uint8_t> bytes)
+        {
+            if (std::uniform_real_distribution<double>(0, 1)(rng) < loss)
+                return;
+            int delay = latency_ms;
+            if (jitter_ms > 0)
+                delay += std::uniform_int_distribution<int>(-jitter_ms, jitter_ms)(rng);
+            waiting.push_back({Clock::now() + std::chrono::milliseconds(std::max(0, delay)), std::move(bytes)});
+        }
+
+        // sends whatever is due
+        void flush()
+        {
+            auto now = Clock::now();
+            for (auto it = waiting.begin(); it != waiting.end();)
+            {
+                if (it->first <= now)
+                {
+                    sendto(fd, it->second.data(), it->second.size(), 0, reinterpret_cast<sockaddr *>(&peer), sizeof(peer));
+                    it = waiting.erase(it);
+                }
+                else
+                    ++it;
+            }
+        }
+
+    private:
+        int fd;
+        sockaddr_in peer;
+        int latency_ms;
+        int jitter_ms;
+        double loss;
+        std::mt19937 rng;
+        std::deque<std::pair<Clock::time_point, std::vector<std::uint8_t>>> waiting;
+    };
+
+}
+
+int main(int argc, char **argv)
+{
+    int player = -1;
+    int port = 9000;
+    int peer_port = 9001;
+    std::string host = "127.0.0.1";
+    unsigned seed = 1;
+    std::uint32_t ticks = 1200;
+    int latency = 0;
+    int jitter = 0;
+    double loss = 0;
+    int height = 20;
+    int width = 10;
+
+    try
+    {
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            std::string value = argv[i + 1];
+            if (option == "--player")
+                player = std::stoi(value);
+            else if (option == "--port")
+                port = std::stoi(value);
+            else if (option == "--peer-port")
+                peer_port = std::stoi(value);
+            else if (option == "--host")
+                host = value;
+            else if (option == "--seed")
+                seed = static_cast<unsigned>(std::stoul(value));
+            else if (option == "--ticks")
+                ticks = static_cast<std::uint32_t>(std::stoul(value));
+            else if (option == "--latency")
+                latency = std::stoi(value);
+            else if (option == "--jitter")
+                jitter = std::stoi(value);
+            else if (option == "--loss")
+                loss = std::stod(value);
+            else
+                player = -1, i = argc;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        player = -1;
+    }
+    if (player != 0 && player != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " --player 0|1 [--port 9000] [--peer-port 9001] [--host 127.0.0.1]"
+                  << " [--seed 1] [--ticks 1200] [--latency 0] [--jitter 0] [--loss 0]" << std::endl;
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0)
+    {
+        std::cerr << "Cannot bind port " << port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(peer_port);
+    inet_pton(AF_INET, host.c_str(), &peer.sin_addr);
+
+    LossyLink link(fd, peer, latency, jitter, loss, seed * 2 + player);
+    RollbackSession session(height, width, seed, player);
+
+    // the bot presses something on about one tick in six
+    std::mt19937 bot(seed * 7 + player);
+    std::uniform_int_distribution<int> pick(0, 29);
+
+    std::uint32_t remote_confirmed = 0; // the remote has our inputs before this tick
+    std::uint64_t stalls = 0;
+    std::uint64_t checksums_compared = 0;
+    auto period = std::chrono::nanoseconds(1000000000LL / ticks_per_second);
+    auto next_tick = Clock::now();
+    auto give_up = Clock::now() + std::chrono::seconds(ticks / ticks_per_second + 30);
+    Clock::time_point done_at;
+    bool done = false;
+
+    // keeps going a little after we're done so the other side gets our last inputs too
+    while (Clock::now() < give_up && !(done && Clock::now() > done_at + std::chrono::seconds(1)))
+    {
+        std::uint8_t buffer[512];
+        ssize_t got;
+        while ((got = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        {
+            Packet packet;
+            if (!decode(buffer, got, packet))
+                continue;
+            for (std::size_t i = 0; i < packet.inputs.size(); ++i)
+                session.add_remote_input(packet.first_tick + static_cast<std::uint32_t>(i), packet.inputs[i]);
+            remote_confirmed = std::max(remote_confirmed, packet.confirmed);
+            if (packet.has_checksum)
+            {
+                session.check_remote_checksum(packet.checksum_tick, packet.checksum);
+                ++checksums_compared;
+            }
+        }
+
+        if (Clock::now() >= next_tick)
+        {
+            next_tick += period;
+            if (session.current_tick() < ticks)
+            {
+                if (session.can_advance())
+                {
+                    int roll = pick(bot);
+                    session.advance(roll < 5 ? static_cast<TickInput>(roll) : no_input);
+                }
+                else
+                {
+                    ++stalls;
+                }
+            }
+            else if (!done && session.confirmed_ticks() >= ticks)
+            {
+                // settles the rollback for the last inputs
+                session.advance(no_input);
+                done = true;
+                done_at = Clock::now();
+            }
+
+            // all the inputs the remote doesn't have yet, as far as we know, so lost packets get covered
+            Packet packet;
+            std::uint32_t now = session.current_tick();
+            std::uint32_t from = std::max(remote_confirmed, now > max_inputs ? now - max_inputs : 0u);
+            packet.first_tick = from;
+            for (std::uint32_t tick = from; tick < now; ++tick)
+                packet.inputs.push_back(session.local_input(tick));
+            packet.confirmed = session.confirmed_ticks();
+            packet.has_checksum = session.latest_checksum(packet.checksum_tick, packet.checksum);
+            link.send(encode(packet));
+        }
+
+        link.flush();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    close(fd);
+
+    std::uint32_t last_tick = ticks - 1;
+    std::uint32_t checksum = 0;
+    session.checksum_at(last_tick, checksum);
+    std::printf("player %d  tick %u  checksum %08x  %s\n", player, last_tick, checksum,
+                session.desynced() ? "DESYNC" : "in sync");
+    std::printf("rollbacks %llu  resimulated %llu ticks  deepest %u  stalls %llu  checksums compared %llu\n",
+                static_cast<unsigned long long>(session.rollbacks()),
+                static_cast<unsigned long long>(session.resimulated_ticks()), session.deepest_rollback(),
+                static_cast<unsigned long long>(stalls), static_cast<unsigned long long>(checksums_compared));
+    for (int p = 0; p < VersusGame::players; ++p)
+    {
+        GameBoard &board = session.current_game().board(p);
+        std::printf("board %d  score %d  lines %d%s\n", p, board.get_score(), board.lines_cleared_count(),
+                    board.is_game_over() ? "  (game over)" : "");
+    }
+    return session.desynced() || !done ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+// Turns a replay recorded with tetris.exe --record into video frames, without a screen recorder
+// usage: ./tetris_video.exe --replay game.tr [--out -] [--format y4m|ppm] [--fps 60] [--cell 20] [--threads N]
+//
+// The frames go to stdout (or --out) as a Y4M stream by default, which an encoder can take as it is:
+//   ./tetris.exe --board 10x20 --seed 1 --policy bot --headless --max-speed --record game.tr
+//   ./tetris_video.exe --replay game.tr | ffmpeg -i - -pix_fmt yuv420p game.mp4
+// --format ppm writes raw RGB frames instead (ffmpeg -f image2pipe -c:v ppm -i - ...). How fast it
+// went goes to stderr
+#include "replay.hpp"
+#include "video.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+int main(int argc, char **argv)
+{
+    std::string replay_path;
+    std::string out_path = "-";
+    tetris::VideoOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    bool good = argc % 2 == 1;
+    try
+    {
+        for (int i = 1; good && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            std::string value = argv[i + 1];
+            if (option == "--replay")
+                replay_path = value;
+            else if (option == "--out")
+                out_path = value;
+            else if (option == "--format" && (value == "y4m" || value == "ppm"))
+                options.format = value == "ppm" ? tetris::VideoFormat::PPM : tetris::VideoFormat::Y4M;
+            else if (option == "--fps")
+                options.fps = std::stoi(value);
+            else if (option == "--cell")
+                options.cell = std::stoi(value);
+            else if (option == "--threads")
+                options.threads = std::max(1, std::stoi(value));
+            else
+                good = false;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        good = false;
+    }
+    if (!good || replay_path.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " --replay game.tr [--out -] [--format y4m|ppm] [--fps 60] [--cell 20] [--threads N]"
+                  << std::endl;
+        return 1;
+    }
+    options.border = std::max(1, options.cell / 10);
+
+    try
+    {
+        tetris::Replay replay = tetris::Replay::load(replay_path);
+        std::FILE *out = out_path == "-" ? stdout : std::fopen(out_path.c_str(), "wb");
+        if (!out)
+            throw std::runtime_error("Cannot write " + out_path);
+        tetris::VideoStats stats = tetris::export_video(replay, options, out);
+        if (out != stdout)
+            std::fclose(out);
+
+        double game_seconds = static_cast<double>(replay.ticks) / replay.tick_rate;
+        std::fprintf(stderr, "%lld frames (%dx%d), %.1f MB in %.2fs with %d thread(s): %.0f frames/s, %.1fx real time\n",
+                     stats.frames, replay.width * options.cell, replay.height * options.cell, stats.bytes / 1e6,
+                     stats.seconds, options.threads, stats.frames / stats.seconds, game_seconds / stats.seconds);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
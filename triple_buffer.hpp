@@ -0,0 +1,57 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+#include <array>
+#include <atomic>
+
+namespace tetris
+{
+
+    // A triple buffer for one writer thread and one reader thread. The writer always has a buffer of
+    // its own to fill (the back), the reader always has one of its own to look at (the front), and the
+    // third one sits in the middle. Publishing and picking up just swap an index with the middle one,
+    // so neither side ever waits on the other, the reader just sees the newest finished buffer
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        explicit TripleBuffer(const T &initial = T()) : buffers{{initial, initial, initial}} {}
+
+        // writer side: fill this in, then publish() it
+        T &write_buffer()
+        {
+            return buffers[back];
+        }
+
+        // writer side: hands the back buffer over and takes the old middle one to write into next
+        void publish()
+        {
+            back = middle.exchange(back | fresh, std::memory_order_acq_rel) & index_mask;
+        }
+
+        // reader side: picks up the newest published buffer, returns false if nothing new came in
+        bool update()
+        {
+            if ((middle.load(std::memory_order_relaxed) & fresh) == 0)
+                return false;
+            front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+            return true;
+        }
+
+        // reader side: the buffer picked up by the last update()
+        const T &read_buffer() const
+        {
+            return buffers[front];
+        }
+
+    private:
+        static constexpr int index_mask = 3; // the low bits of middle are the buffer index
+        static constexpr int fresh = 4;      // set when the middle buffer hasn't been picked up yet
+
+        std::array<T, 3> buffers;
+        alignas(64) int back = 0;             // only touched by the writer
+        alignas(64) int front = 1;            // only touched by the reader
+        alignas(64) std::atomic<int> middle{2};
+    };
+
+}
+#endif // TRIPLE_BUFFER_HPP
@@ -0,0 +1,167 @@
+#include "undo.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // x and y go from -4 (a piece set's 5x5 box can hang off the top and the left by all but a
+    // column) to 49, 54 values in 6 bits each, and the rotation takes 2 more
+    const int lock_offset = max_piece_size - 1;
+
+    std::uint16_t pack_lock(const PieceLock &lock)
+    {
+      return static_cast<std::uint16_t>((lock.x + lock_offset) | (lock.y + lock_offset) << 6 | lock.rotation << 12);
+    }
+
+    PieceLock unpack_lock(std::uint16_t packed)
+    {
+      PieceLock lock;
+      lock.x = (packed & 63) - lock_offset;
+      lock.y = (packed >> 6 & 63) - lock_offset;
+      lock.rotation = packed >> 12;
+      return lock;
+    }
+
+    template <typename T>
+    void put(std::vector<std::uint8_t> &out, T value)
+    {
+      std::size_t at = out.size();
+      out.resize(at + sizeof(T));
+      std::memcpy(&out[at], &value, sizeof(T));
+    }
+
+    template <typename T>
+    T take(const std::uint8_t *&in)
+    {
+      T value;
+      std::memcpy(&value, in, sizeof(T));
+      in += sizeof(T);
+      return value;
+    }
+  }
+
+  UndoHistory::UndoHistory(int height, int width, int keyframe_every)
+      : height(height), width(width), keyframe_every(keyframe_every)
+  {
+    if (keyframe_every < 1)
+      throw std::invalid_argument("keyframe_every has to be at least 1");
+  }
+
+  void UndoHistory::start(const GameBoard &board)
+  {
+    moves.clear();
+    keyframes.clear();
+    keyframe_at.clear();
+    add_keyframe(board);
+  }
+
+  void UndoHistory::record(const GameBoard &board)
+  {
+    moves.push_back(pack_lock(board.last_lock()));
+    if (moves.size() % keyframe_every == 0)
+      add_keyframe(board);
+  }
+
+  void UndoHistory::add_keyframe(const GameBoard &board)
+  {
+    board.save_state(scratch);
+    keyframe_at.push_back(static_cast<std::uint32_t>(keyframes.size()));
+
+    // the rows above the pile are all empty, they're left out
+    int top = 0;
+    while (top < height && std::all_of(&scratch.cells[top * width], &scratch.cells[(top + 1) * width], [](std::uint8_t c)
+                                       { return c == 0; }))
+      ++top;
+    put<std::uint8_t>(keyframes, static_cast<std::uint8_t>(top));
+    std::size_t first = static_cast<std::size_t>(top) * width;
+    for (std::size_t i = first; i < scratch.cells.size(); i += 2)
+    {
+      std::uint8_t high = i + 1 < scratch.cells.size() ? scratch.cells[i + 1] : 0;
+      keyframes.push_back(static_cast<std::uint8_t>(scratch.cells[i] | high << 4));
+    }
+
+    // the piece is the block's shape turned rotation times, it doesn't need its own 16 cells
+    put<std::uint8_t>(keyframes, static_cast<std::uint8_t>(scratch.block));
+    put<std::uint8_t>(keyframes, static_cast<std::uint8_t>(scratch.rotation));
+    put<std::int8_t>(keyframes, static_cast<std::int8_t>(scratch.b_x));
+    put<std::int8_t>(keyframes, static_cast<std::int8_t>(scratch.b_y));
+    put<std::int32_t>(keyframes, scratch.score);
+    put<std::int32_t>(keyframes, scratch.lines_cleared);
+    put<std::int32_t>(keyframes, scratch.pieces);
+    // the generator as it is in memory, it never leaves the process
+    put<std::minstd_rand>(keyframes, scratch.rng);
+  }
+
+  void UndoHistory::restore(std::size_t step, GameBoard &board)
+  {
+    if (step >= steps())
+      throw std::out_of_range("There's no undo step " + std::to_string(step));
+
+    std::size_t keyframe = step / keyframe_every;
+    const std::uint8_t *in = keyframes.data() + keyframe_at[keyframe];
+    int top = take<std::uint8_t>(in);
+    scratch.cells.assign(static_cast<std::size_t>(height) * width, 0);
+    for (std::size_t i = static_cast<std::size_t>(top) * width; i < scratch.cells.size(); i += 2)
+    {
+      std::uint8_t two = take<std::uint8_t>(in);
+      scratch.cells[i] = two & 15;
+      if (i + 1 < scratch.cells.size())
+        scratch.cells[i + 1] = two >> 4;
+    }
+
+    scratch.block = take<std::uint8_t>(in);
+    scratch.rotation = take<std::uint8_t>(in);
+    scratch.b_x = take<std::int8_t>(in);
+    scratch.b_y = take<std::int8_t>(in);
+    scratch.score = take<std::int32_t>(in);
+    scratch.lines_cleared = take<std::int32_t>(in);
+    scratch.pieces = take<std::int32_t>(in);
+    scratch.rng = take<std::minstd_rand>(in);
+    board.load_state(scratch);
+
+    // and the pieces from the keyframe up to the step lock where they locked the first time, each
+    // lock spawns the next piece out of the same generator
+    for (std::size_t i = keyframe * keyframe_every; i < step; ++i)
+    {
+      PieceLock lock = unpack_lock(moves[i]);
+      for (int turn = 0; turn < lock.rotation; ++turn)
+        board.rotate();
+      board.b_x = lock.x;
+      board.b_y = lock.y;
+      board.move_down();
+    }
+  }
+
+  void UndoHistory::truncate(std::size_t step)
+  {
+    if (step + 1 >= steps())
+      return;
+    moves.resize(step);
+    std::size_t keep = step / keyframe_every + 1;
+    if (keep < keyframe_at.size())
+    {
+      keyframes.resize(keyframe_at[keep]);
+      keyframe_at.resize(keep);
+    }
+  }
+
+  bool UndoHistory::undo(GameBoard &board)
+  {
+    if (steps() < 2)
+      return false;
+    restore(steps() - 2, board);
+    truncate(steps() - 2);
+    return true;
+  }
+
+  std::size_t UndoHistory::bytes() const
+  {
+    return moves.capacity() * sizeof(std::uint16_t) + keyframes.capacity() + keyframe_at.capacity() * sizeof(std::uint32_t);
+  }
+
+}
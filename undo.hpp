@@ -0,0 +1,55 @@
+#ifndef UNDO_HPP
+#define UNDO_HPP
+#include <cstdint>
+#include <vector>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // Every placement of a game, for practice mode to take back as many as it likes or scrub
+    // through. A step is the board as a piece has just spawned on it, step 0 is where start() was
+    // called and each locked piece makes one more. Whole boards aren't kept: a step is where its
+    // piece locked (x, y and rotation packed into 2 bytes), and every keyframe_every steps there's
+    // a keyframe with the pile packed two cells a byte from its top row down. A step is got back
+    // by loading the keyframe before it and locking the pieces after that again, which is at most
+    // keyframe_every - 1 locks however long the game has gone on
+    class UndoHistory
+    {
+    public:
+        static constexpr int default_keyframe_every = 64;
+
+        UndoHistory(int height, int width, int keyframe_every = default_keyframe_every);
+
+        void start(const GameBoard &board);  // forgets everything, board is step 0
+        void record(const GameBoard &board); // call it after every lock, board has the next piece on it
+
+        std::size_t steps() const { return moves.size() + 1; }
+
+        // puts the board (the same size) back to how it was at step, the later steps are kept so
+        // it can go forward again. the board's listener and bus see the pieces being locked again,
+        // take them off first if that matters
+        void restore(std::size_t step, GameBoard &board);
+
+        // forgets the steps after step, for when the game goes on from a restored one
+        void truncate(std::size_t step);
+
+        // takes the last placement back, restore and truncate to the step before. false at step 0
+        bool undo(GameBoard &board);
+
+        std::size_t bytes() const; // everything it has allocated
+
+    private:
+        void add_keyframe(const GameBoard &board);
+
+        int height;
+        int width;
+        int keyframe_every;
+        std::vector<std::uint16_t> moves;         // moves[i] is where step i's piece locked
+        std::vector<std::uint8_t> keyframes;      // all of them back to back
+        std::vector<std::uint32_t> keyframe_at;   // where keyframe k (step k * keyframe_every) starts
+        BoardState scratch;                       // a keyframe unpacked, reused
+    };
+
+}
+#endif // UNDO_HPP
@@ -16,6 +16,13 @@
 #include <algorithm>
 #include <exception>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <streambuf>
+#include <thread>
 
 // For compatibility with Visual Studio
 #include <ciso646>
@@ -43,13 +50,95 @@ struct TestCase {
     TestCase(const std::string& name_, Test_func_t test_func_)
         : name(name_), test_func(test_func_) {}
 
-    void run(bool quiet_mode);
+    // runs it once with the random numbers starting from seed, the first
+    // failure is kept (with its seed) if it's run more than once
+    void run(bool quiet_mode, unsigned seed);
     void print(bool quiet_mode);
 
     std::string name;
     Test_func_t test_func;
     std::string failure_msg{};
     std::string exception_msg{};
+    unsigned failed_seed = 0;
+    int runs = 0;
+    double total_ms = 0;
+    double slowest_ms = 0;
+};
+
+// Tests take their random numbers from here instead of std::rand(). Every
+// run of a test starts it over from that run's seed (--seed, and --repeat
+// gives each repetition the next one), and it's per thread, so tests that
+// run side by side with -j don't take numbers out of each other's sequences.
+std::minstd_rand& test_rng() {
+    thread_local std::minstd_rand rng;
+    return rng;
+}
+
+unsigned& current_test_seed() {
+    thread_local unsigned seed = 0;
+    return seed;
+}
+
+// the seed the running test started from, for tests that seed things of
+// their own
+unsigned test_seed() {
+    return current_test_seed();
+}
+
+int test_rand() {
+    return static_cast<int>(test_rng()());
+}
+
+void test_srand(unsigned seed) {
+    test_rng().seed(seed);
+}
+
+// Stands in for a standard stream's buffer while tests run in parallel. A
+// thread that has a capture string set for the stream writes into it and
+// everything else goes through to the real buffer, so each test's output can
+// be printed in one piece when it's done. std::cout has one capture string
+// and std::cerr and std::clog share the other, since they both end up on
+// stderr. There's no put area, every write comes straight to xsputn or
+// overflow, which only touch the writing thread's own string.
+class ThreadOutputBuf : public std::streambuf {
+public:
+    enum Stream { Out, Err };
+
+    ThreadOutputBuf(std::streambuf* original_, Stream stream_)
+        : original(original_), stream(stream_) {}
+
+    static std::string*& capture(Stream stream) {
+        thread_local std::string* targets[2] = {nullptr, nullptr};
+        return targets[stream];
+    }
+
+protected:
+    int overflow(int c) override {
+        if (c == traits_type::eof()) {
+            return traits_type::not_eof(c);
+        }
+        if (capture(stream)) {
+            capture(stream)->push_back(static_cast<char>(c));
+            return c;
+        }
+        return original->sputc(static_cast<char>(c));
+    }
+
+    std::streamsize xsputn(const char* text, std::streamsize count) override {
+        if (capture(stream)) {
+            capture(stream)->append(text, static_cast<std::size_t>(count));
+            return count;
+        }
+        return original->sputn(text, count);
+    }
+
+    int sync() override {
+        return capture(stream) ? 0 : original->pubsync();
+    }
+
+private:
+    std::streambuf* original;
+    Stream stream;
 };
 
 
@@ -100,11 +189,17 @@ private:
     ~TestSuite() {}
 
     std::vector<std::string> get_test_names_to_run(int argc, char** argv);
+    void run_in_parallel(const std::vector<std::string>& test_names,
+                         unsigned seed);
+    void print_slowest(std::size_t count);
 
     static TestSuite* instance;
     std::map<std::string, TestCase> tests_;
 
     bool quiet_mode = false;
+    int jobs = 1;       // -j, how many tests run at once
+    int repeat = 1;     // --repeat, every test is run this many times
+    unsigned seed = 1;  // --seed, the first run's seed
     static bool incomplete;
 };
 
@@ -411,7 +506,11 @@ void assert_sequence_equal(First&& first, Second&& second, int line_number,
     bool TestSuite::incomplete = false;                                       \
     TestSuite* TestSuite::instance = &TestSuite::get()
 
-void TestCase::run(bool quiet_mode) {
+void TestCase::run(bool quiet_mode, unsigned seed) {
+    bool failed_before = not failure_msg.empty() or not exception_msg.empty();
+    current_test_seed() = seed;
+    test_srand(seed);
+    auto start = std::chrono::steady_clock::now();
     try {
         if (not quiet_mode) {
             std::cout << "Running test: " << name << std::endl;
@@ -424,23 +523,34 @@ void TestCase::run(bool quiet_mode) {
         }
     }
     catch (TestFailure& failure) {
-        failure_msg = failure.to_string();
+        if (not failed_before) {
+            failure_msg = failure.to_string();
+            failed_seed = seed;
+        }
 
         if (not quiet_mode) {
             std::cout << "FAIL" << std::endl;
         }
     }
     catch (std::exception& e) {
-        std::ostringstream oss;
-        oss << "Uncaught " << demangle(typeid(e).name()) << " in test \""
-            << name << "\": \n";
-        oss << e.what() << '\n';
-        exception_msg = oss.str();
+        if (not failed_before) {
+            std::ostringstream oss;
+            oss << "Uncaught " << demangle(typeid(e).name()) << " in test \""
+                << name << "\": \n";
+            oss << e.what() << '\n';
+            exception_msg = oss.str();
+            failed_seed = seed;
+        }
 
         if (not quiet_mode) {
             std::cout << "ERROR" << std::endl;
         }
     }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+    ++runs;
+    total_ms += ms;
+    slowest_ms = std::max(slowest_ms, ms);
 }
 
 void TestCase::print(bool quiet_mode) {
@@ -451,20 +561,33 @@ void TestCase::print(bool quiet_mode) {
         std::cout << "** Test case \"" << name << "\": ";
     }
 
+    std::ostringstream timing;
+    if (not quiet_mode) {
+        timing << std::fixed << std::setprecision(1) << " ("
+               << total_ms / std::max(1, runs) << " ms";
+        if (runs > 1) {
+            timing << " avg, " << slowest_ms << " ms max, " << runs
+                   << " runs";
+        }
+        timing << ")";
+    }
+
     if (not failure_msg.empty()) {
-        std::cout << "FAIL" << std::endl;
+        std::cout << "FAIL" << timing.str() << std::endl;
         if (not quiet_mode) {
-            std::cout << failure_msg << std::endl;
+            std::cout << "With --seed " << failed_seed << ":\n"
+                      << failure_msg << std::endl;
         }
     }
     else if (not exception_msg.empty()) {
-        std::cout << "ERROR" << std::endl;
+        std::cout << "ERROR" << timing.str() << std::endl;
         if (not quiet_mode) {
-            std::cout << exception_msg << std::endl;
+            std::cout << "With --seed " << failed_seed << ":\n"
+                      << exception_msg << std::endl;
         }
     }
     else {
-        std::cout << "PASS" << std::endl;
+        std::cout << "PASS" << timing.str() << std::endl;
     }
 }
 
@@ -505,9 +628,20 @@ int TestSuite::run_tests(int argc, char** argv) {
         }
     }
 
-    for (auto test_name : test_names_to_run) {
-        tests_.at(test_name).run(quiet_mode);
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < repeat; ++round) {
+        // a whole round finishes before the next starts, so a test never
+        // runs at the same time as another run of itself
+        if (jobs > 1) {
+            run_in_parallel(test_names_to_run, seed + round);
+            continue;
+        }
+        for (auto test_name : test_names_to_run) {
+            tests_.at(test_name).run(quiet_mode, seed + round);
+        }
     }
+    double wall_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start).count();
 
     std::cout << "\n*** Results ***" << std::endl;
     for (auto test_name : test_names_to_run) {
@@ -531,6 +665,9 @@ int TestSuite::run_tests(int argc, char** argv) {
                   << " tests run:" << std::endl;
         std::cout << num_failures << " failure(s), " << num_errors
                   << " error(s)" << std::endl;
+        std::cout << std::fixed << std::setprecision(1) << wall_ms
+                  << " ms with -j " << jobs << std::endl;
+        print_slowest(5);
     }
 
     if (num_failures == 0 and num_errors == 0) {
@@ -539,11 +676,98 @@ int TestSuite::run_tests(int argc, char** argv) {
     return 1;
 }
 
+// The tests are handed out to a pool of jobs threads one at a time, whoever
+// is free takes the next. std::cout, std::cerr and std::clog go through
+// ThreadOutputBufs while they run and each test's output is printed as soon
+// as it's done, in one piece, so tests running side by side don't
+// interleave. What a test writes to stderr comes out after what it wrote to
+// stdout, and printf and the like aren't captured at all.
+void TestSuite::run_in_parallel(const std::vector<std::string>& test_names,
+                                unsigned seed) {
+    std::cout << std::flush;
+    std::cerr << std::flush;
+    std::clog << std::flush;
+    ThreadOutputBuf routed(std::cout.rdbuf(), ThreadOutputBuf::Out);
+    ThreadOutputBuf routed_err(std::cerr.rdbuf(), ThreadOutputBuf::Err);
+    ThreadOutputBuf routed_log(std::clog.rdbuf(), ThreadOutputBuf::Err);
+    std::streambuf* original = std::cout.rdbuf(&routed);
+    std::streambuf* original_err = std::cerr.rdbuf(&routed_err);
+    std::streambuf* original_log = std::clog.rdbuf(&routed_log);
+    std::atomic<std::size_t> next{0};
+    std::mutex print_mutex;
+
+    auto worker = [&]() {
+        std::string output;
+        std::string errors;
+        ThreadOutputBuf::capture(ThreadOutputBuf::Out) = &output;
+        ThreadOutputBuf::capture(ThreadOutputBuf::Err) = &errors;
+        for (std::size_t i = next++; i < test_names.size(); i = next++) {
+            output.clear();
+            errors.clear();
+            tests_.at(test_names[i]).run(quiet_mode, seed);
+            std::lock_guard<std::mutex> lock(print_mutex);
+            original->sputn(output.data(),
+                            static_cast<std::streamsize>(output.size()));
+            original->pubsync();
+            original_err->sputn(errors.data(),
+                                static_cast<std::streamsize>(errors.size()));
+            original_err->pubsync();
+        }
+        ThreadOutputBuf::capture(ThreadOutputBuf::Out) = nullptr;
+        ThreadOutputBuf::capture(ThreadOutputBuf::Err) = nullptr;
+    };
+
+    std::vector<std::thread> pool;
+    std::size_t threads =
+        std::min(static_cast<std::size_t>(jobs), test_names.size());
+    for (std::size_t t = 0; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    std::cout.rdbuf(original);
+    std::cerr.rdbuf(original_err);
+    std::clog.rdbuf(original_log);
+}
+
+void TestSuite::print_slowest(std::size_t count) {
+    std::vector<const TestCase*> ran;
+    for (const auto& test_pair : tests_) {
+        if (test_pair.second.runs > 0) {
+            ran.push_back(&test_pair.second);
+        }
+    }
+    count = std::min(count, ran.size());
+    std::partial_sort(ran.begin(), ran.begin() + count, ran.end(),
+                      [](const TestCase* a, const TestCase* b) {
+                          return a->slowest_ms > b->slowest_ms;
+                      });
+    std::cout << "*** Slowest ***" << std::endl;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::cout << std::setw(10) << ran[i]->slowest_ms << " ms  "
+                  << ran[i]->name << std::endl;
+    }
+}
+
 std::vector<std::string> TestSuite::get_test_names_to_run(int argc,
                                                           char** argv) {
     std::vector<std::string> test_names_to_run;
     for (auto i = 1; i < argc; ++i) {
-        if (argv[i] == std::string("--show_test_names") or
+        bool has_value = i + 1 < argc;
+        if ((argv[i] == std::string("-j") or
+             argv[i] == std::string("--jobs")) and has_value) {
+            jobs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if ((argv[i] == std::string("-r") or
+                  argv[i] == std::string("--repeat")) and has_value) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if ((argv[i] == std::string("-s") or
+                  argv[i] == std::string("--seed")) and has_value) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argv[i] == std::string("--show_test_names") or
             argv[i] == std::string("-n")) {
 
             TestSuite::get().print_test_names(std::cout);
@@ -557,13 +781,21 @@ std::vector<std::string> TestSuite::get_test_names_to_run(int argc,
         else if (argv[i] == std::string("--help") or
                  argv[i] == std::string("-h")) {
             std::cout << "usage: " << argv[0]
-                      << " [-h] [-n] [-q] [[TEST_NAME] ...]\n";
+                      << " [-h] [-n] [-q] [-j N] [-r N] [-s SEED]"
+                         " [[TEST_NAME] ...]\n";
             std::cout
                 << "optional arguments:\n"
                 << " -h, --help\t\t show this help message and exit\n"
                 << " -n, --show_test_names\t print the names of all "
                    "discovered test cases and exit\n"
                 << " -q, --quiet\t\t print a reduced summary of test results\n"
+                << " -j, --jobs N\t\t run N tests at a time on a pool of "
+                   "threads, each one's std::cout and std::cerr output is "
+                   "printed in one piece\n"
+                << " -r, --repeat N\t\t run every test N times, each time "
+                   "with the next seed\n"
+                << " -s, --seed SEED\t where test_rand() starts from on the "
+                   "first run (1 by default)\n"
                 << " TEST_NAME ...\t\t run only the test cases whose names "
                    "are "
                    "listed here. Note: If no test names are specified, all "
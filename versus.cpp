@@ -0,0 +1,174 @@
+#include "versus.hpp"
+#include <algorithm>
+
+namespace tetris
+{
+
+  VersusGame::VersusGame(int height, int width, unsigned seed)
+  {
+    for (GameBoard &board : boards)
+    {
+      board = GameBoard(height, width);
+      board.seed(seed);
+      board.generate_new_piece();
+    }
+  }
+
+  void VersusGame::step(TickInput first, TickInput second)
+  {
+    TickInput inputs[players] = {first, second};
+    ++tick_count;
+    for (int player = 0; player < players; ++player)
+    {
+      GameBoard &board = boards[player];
+
+      // a finished board just sits there while the other one plays on
+      if (board.is_game_over())
+        continue;
+
+      if (inputs[player] != no_input)
+        board.handle_input(static_cast<Input>(inputs[player]));
+      if (tick_count % gravity_ticks == 0)
+        board.move_down();
+    }
+  }
+
+  void VersusGame::save(State &state) const
+  {
+    for (int player = 0; player < players; ++player)
+    {
+      boards[player].save_state(state.boards[player]);
+    }
+    state.tick = tick_count;
+  }
+
+  void VersusGame::load(const State &state)
+  {
+    for (int player = 0; player < players; ++player)
+    {
+      boards[player].load_state(state.boards[player]);
+    }
+    tick_count = state.tick;
+  }
+
+  std::uint32_t VersusGame::checksum() const
+  {
+    std::uint32_t hash = tick_count;
+    for (const GameBoard &board : boards)
+    {
+      hash = hash * 31 + board.checksum();
+    }
+    return hash;
+  }
+
+  RollbackSession::RollbackSession(int height, int width, unsigned seed, int local_player)
+      : game(height, width, seed), local_player(local_player)
+  {
+    local_inputs.fill(no_input);
+    remote_inputs.fill(no_input);
+    predicted.fill(no_input);
+  }
+
+  bool RollbackSession::can_advance() const
+  {
+    return game.tick() - next_remote < max_rollback;
+  }
+
+  void RollbackSession::add_remote_input(std::uint32_t tick, TickInput input)
+  {
+    // already have it, or it's so far ahead that it would overwrite history we still need
+    if (tick < next_remote || tick >= next_remote + history - max_rollback)
+      return;
+
+    std::uint32_t slot = tick % history;
+    if (remote_known[slot] && remote_tick[slot] == tick)
+      return;
+
+    remote_inputs[slot] = input;
+    remote_tick[slot] = tick;
+    remote_known[slot] = true;
+
+    // we already ran this tick on a guess, and the guess was wrong
+    if (tick < game.tick() && predicted[slot] != input)
+    {
+      if (!mismatch || tick < first_mismatch)
+        first_mismatch = tick;
+      mismatch = true;
+    }
+
+    while (remote_known[next_remote % history] && remote_tick[next_remote % history] == next_remote)
+    {
+      ++next_remote;
+    }
+  }
+
+  void RollbackSession::run_tick(std::uint32_t tick)
+  {
+    std::uint32_t slot = tick % history;
+    game.save(states[slot]);
+
+    bool known = remote_known[slot] && remote_tick[slot] == tick;
+    predicted[slot] = known ? remote_inputs[slot] : no_input;
+
+    if (local_player == 0)
+      game.step(local_inputs[slot], predicted[slot]);
+    else
+      game.step(predicted[slot], local_inputs[slot]);
+
+    // only counts once the tick is confirmed, a rollback through it writes it again
+    checksums[slot] = game.checksum();
+  }
+
+  void RollbackSession::advance(TickInput local)
+  {
+    std::uint32_t now = game.tick();
+
+    // put right whatever was guessed wrong, all within this one call
+    if (mismatch)
+    {
+      std::uint32_t depth = now - first_mismatch;
+      game.load(states[first_mismatch % history]);
+      for (std::uint32_t tick = first_mismatch; tick < now; ++tick)
+      {
+        run_tick(tick);
+      }
+      ++rollback_count;
+      resimulated += depth;
+      if (depth > deepest)
+        deepest = depth;
+      mismatch = false;
+    }
+
+    local_inputs[now % history] = local;
+    run_tick(now);
+
+    // ticks that are confirmed and simulated with the real inputs won't change anymore
+    checksummed = std::min(next_remote, game.tick());
+  }
+
+  bool RollbackSession::latest_checksum(std::uint32_t &tick, std::uint32_t &checksum) const
+  {
+    if (checksummed == 0)
+      return false;
+    tick = checksummed - 1;
+    checksum = checksums[tick % history];
+    return true;
+  }
+
+  bool RollbackSession::checksum_at(std::uint32_t tick, std::uint32_t &checksum) const
+  {
+    if (tick >= checksummed || game.tick() - tick > history)
+      return false;
+    checksum = checksums[tick % history];
+    return true;
+  }
+
+  void RollbackSession::check_remote_checksum(std::uint32_t tick, std::uint32_t checksum)
+  {
+    // only ticks we have checksummed too and that are still in the history can be compared
+    std::uint32_t ours;
+    if (checksum_at(tick, ours) && ours != checksum)
+      desync = true;
+  }
+
+}
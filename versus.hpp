@@ -0,0 +1,114 @@
+#ifndef VERSUS_HPP
+#define VERSUS_HPP
+#include <array>
+#include <cstdint>
+#include "grid.hpp"
+
+namespace tetris
+{
+
+    // one player's input for one tick, either an Input or no_input
+    typedef std::uint8_t TickInput;
+    const TickInput no_input = 0xff;
+
+    // Two boards side by side that only move when step() is called. Nothing in here looks at a clock,
+    // gravity is counted in ticks, so the same seed and the same inputs always give the same game
+    class VersusGame
+    {
+    public:
+        static constexpr int players = 2;
+        static constexpr int gravity_ticks = 30; // a row every half a second at 60 ticks a second
+
+        struct State
+        {
+            std::array<BoardState, players> boards;
+            std::uint32_t tick = 0;
+        };
+
+        // both players get the same pieces
+        VersusGame(int height, int width, unsigned seed);
+
+        void step(TickInput first, TickInput second);
+
+        void save(State &state) const;
+        void load(const State &state);
+        std::uint32_t checksum() const;
+
+        std::uint32_t tick() const { return tick_count; }
+        GameBoard &board(int player) { return boards[player]; }
+
+    private:
+        std::array<GameBoard, players> boards;
+        std::uint32_t tick_count = 0;
+    };
+
+    // Rollback for one side of a two player game. Every tick runs straight away with the local input
+    // and a guess for the remote one (that they did nothing, which is what happens most ticks). When
+    // the real remote input for a tick turns up and it isn't what was guessed, the game goes back to
+    // the state saved before that tick and runs forward again to now with what really happened.
+    // Ticks where both inputs are known are "confirmed", those get a checksum that the two sides
+    // compare to catch a desync
+    class RollbackSession
+    {
+    public:
+        static constexpr std::uint32_t max_rollback = 16; // how far ahead of the remote player we can run
+        static constexpr std::uint32_t history = 64;      // ticks of inputs and states kept, a power of two
+
+        RollbackSession(int height, int width, unsigned seed, int local_player);
+
+        // false while we are max_rollback ticks ahead of the last confirmed tick, then we wait for the remote
+        bool can_advance() const;
+
+        // runs the next tick with our input (rolling back first if a late remote input needs it)
+        void advance(TickInput local);
+
+        // an input the remote player used on a tick, repeats and old ones are fine and ignored
+        void add_remote_input(std::uint32_t tick, TickInput input);
+
+        // the remote side's checksum for one of its confirmed ticks
+        void check_remote_checksum(std::uint32_t tick, std::uint32_t checksum);
+
+        std::uint32_t current_tick() const { return game.tick(); }
+        std::uint32_t confirmed_ticks() const { return next_remote; } // ticks before this are confirmed
+        TickInput local_input(std::uint32_t tick) const { return local_inputs[tick % history]; }
+
+        // the checksum after the newest confirmed tick, false if there isn't one yet
+        bool latest_checksum(std::uint32_t &tick, std::uint32_t &checksum) const;
+
+        // the checksum after a confirmed tick that's still in the history
+        bool checksum_at(std::uint32_t tick, std::uint32_t &checksum) const;
+
+        bool desynced() const { return desync; }
+        std::uint64_t rollbacks() const { return rollback_count; }
+        std::uint64_t resimulated_ticks() const { return resimulated; }
+        std::uint32_t deepest_rollback() const { return deepest; }
+
+        VersusGame &current_game() { return game; }
+
+    private:
+        void run_tick(std::uint32_t tick);
+
+        VersusGame game;
+        int local_player;
+
+        std::array<TickInput, history> local_inputs{};
+        std::array<TickInput, history> remote_inputs{};
+        std::array<TickInput, history> predicted{};     // what the remote input was taken to be
+        std::array<std::uint32_t, history> remote_tick{}; // which tick remote_inputs holds, so old ones aren't mixed up
+        std::array<bool, history> remote_known{};
+        std::array<VersusGame::State, history> states;  // the state before each tick
+        std::array<std::uint32_t, history> checksums{}; // the checksum after each confirmed tick
+
+        std::uint32_t next_remote = 0;     // the first tick we don't have the remote input for
+        std::uint32_t checksummed = 0;     // checksums before this tick are final
+        std::uint32_t first_mismatch = 0;  // the earliest tick that was guessed wrong
+        bool mismatch = false;
+        bool desync = false;
+
+        std::uint64_t rollback_count = 0;
+        std::uint64_t resimulated = 0;
+        std::uint32_t deepest = 0;
+    };
+
+}
+#endif // VERSUS_HPP
@@ -0,0 +1,279 @@
+#include "video.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tetris
+{
+
+  namespace
+  {
+    // color number 0 is the background and the block borders
+    struct Palette
+    {
+      std::uint8_t rgb[8][3];
+      std::uint8_t yuv[8][3];
+    };
+
+    Palette make_palette()
+    {
+      Palette palette = {};
+      for (int color = 1; color < 8; ++color)
+      {
+        sf::Color c = tetris::palette(color);
+        palette.rgb[color][0] = c.r;
+        palette.rgb[color][1] = c.g;
+        palette.rgb[color][2] = c.b;
+      }
+      // BT.601 with video range, what a Y4M stream is taken to be
+      for (int color = 0; color < 8; ++color)
+      {
+        double r = palette.rgb[color][0], g = palette.rgb[color][1], b = palette.rgb[color][2];
+        palette.yuv[color][0] = static_cast<std::uint8_t>(16.5 + (65.481 * r + 128.553 * g + 24.966 * b) / 255);
+        palette.yuv[color][1] = static_cast<std::uint8_t>(128.5 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+        palette.yuv[color][2] = static_cast<std::uint8_t>(128.5 + (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+      }
+      return palette;
+    }
+
+    // Draws frames of one size into bytes of one format. A block only has two kinds of pixel rows,
+    // its border (black) and the rows through its middle (black, its color, black), and a board row
+    // of pixels is blocks side by side, so a frame is built out of memcpys of rows made up front
+    class Rasterizer
+    {
+    public:
+      Rasterizer(const Replay &replay, const VideoOptions &options)
+          : board_width(replay.width), board_height(replay.height), cell(options.cell), border(options.border),
+            format(options.format), pixel_width(replay.width * options.cell),
+            pixel_height(replay.height * options.cell)
+      {
+        Palette palette = make_palette();
+        if (format == VideoFormat::PPM)
+        {
+          header = "P6\n" + std::to_string(pixel_width) + " " + std::to_string(pixel_height) + "\n255\n";
+          planes = 1;
+          pixel_bytes = 3;
+        }
+        else
+        {
+          header = "FRAME\n";
+          planes = 3;
+          pixel_bytes = 1;
+        }
+        row_bytes = static_cast<std::size_t>(pixel_width) * pixel_bytes;
+
+        // a block's middle row in every color, and a row of black as wide as the frame
+        for (int plane = 0; plane < planes; ++plane)
+        {
+          for (int color = 0; color < 8; ++color)
+          {
+            std::vector<std::uint8_t> &row = block_rows[plane][color];
+            row.resize(cell * pixel_bytes);
+            for (int x = 0; x < cell; ++x)
+            {
+              int shown = x >= border && x < cell - border ? color : 0;
+              for (int b = 0; b < pixel_bytes; ++b)
+                row[x * pixel_bytes + b] = format == VideoFormat::PPM ? palette.rgb[shown][b] : palette.yuv[shown][plane];
+            }
+          }
+          black_rows[plane].assign(block_rows[plane][0].begin(), block_rows[plane][0].end());
+          black_rows[plane].resize(row_bytes);
+          for (std::size_t i = cell * pixel_bytes; i < row_bytes; ++i)
+            black_rows[plane][i] = black_rows[plane][i % (cell * pixel_bytes)];
+        }
+        middle_row.resize(row_bytes);
+      }
+
+      std::size_t frame_bytes() const { return header.size() + row_bytes * pixel_height * planes; }
+
+      // the stream header, once before the first frame
+      std::string stream_header(int fps) const
+      {
+        if (format == VideoFormat::PPM)
+          return "";
+        return "YUV4MPEG2 W" + std::to_string(pixel_width) + " H" + std::to_string(pixel_height) + " F" +
+               std::to_string(fps) + ":1 Ip A1:1 C444\n";
+      }
+
+      // the board as it is in state, frame_bytes() of it go to out
+      void draw(const BoardState &state, char *out)
+      {
+        // the color number of every block, the falling piece over the pile
+        colors_now.assign(state.cells.begin(), state.cells.end());
+        // replays are always of the seven pieces
+        const PieceShape &shape = PieceSet::standard().shape(state.block, state.rotation);
+        for (int i = 0; i < shape.cell_count; ++i)
+        {
+          int cell_x = state.b_x + shape.cells_x[i];
+          int cell_y = state.b_y + shape.cells_y[i];
+          if (cell_x >= 0 && cell_x < board_width && cell_y >= 0 && cell_y < board_height)
+            colors_now[cell_y * board_width + cell_x] = static_cast<std::uint8_t>(state.block);
+        }
+
+        std::memcpy(out, header.data(), header.size());
+        out += header.size();
+        std::size_t block_bytes = cell * pixel_bytes;
+        for (int plane = 0; plane < planes; ++plane)
+        {
+          for (int y = 0; y < board_height; ++y)
+          {
+            for (int x = 0; x < board_width; ++x)
+              std::memcpy(&middle_row[x * block_bytes], block_rows[plane][colors_now[y * board_width + x]].data(), block_bytes);
+
+            for (int py = 0; py < cell; ++py)
+            {
+              bool middle = py >= border && py < cell - border;
+              std::memcpy(out, middle ? middle_row.data() : black_rows[plane].data(), row_bytes);
+              out += row_bytes;
+            }
+          }
+        }
+      }
+
+    private:
+      int board_width;
+      int board_height;
+      int cell;
+      int border;
+      VideoFormat format;
+      int pixel_width;
+      int pixel_height;
+      int planes;      // Y, U and V one after the other, or RGB all in one
+      int pixel_bytes; // in a plane
+      std::size_t row_bytes;
+      std::string header;
+      std::vector<std::uint8_t> block_rows[3][8]; // [plane][color]
+      std::vector<std::uint8_t> black_rows[3];
+      std::vector<std::uint8_t> middle_row;       // the board row being drawn
+      std::vector<std::uint8_t> colors_now;
+    };
+
+    // one chunk's frames on their way out, chunk is -1 while the slot is free
+    struct Slot
+    {
+      std::vector<char> data;
+      std::size_t used = 0;
+      long long chunk = -1;
+      bool ready = false;
+    };
+  }
+
+  VideoStats export_video(const Replay &replay, const VideoOptions &options, std::FILE *out)
+  {
+    if (options.fps < 1 || replay.tick_rate % options.fps != 0)
+      throw std::runtime_error("The frame rate has to divide the replay's tick rate (" + std::to_string(replay.tick_rate) + ")");
+    if (options.cell < 1 || options.border < 0 || 2 * options.border >= options.cell || options.chunk_frames < 1)
+      throw std::runtime_error("Bad video sizes");
+
+    auto start = std::chrono::steady_clock::now();
+    const int ticks_per_frame = replay.tick_rate / options.fps;
+    const long long frames = replay.ticks / ticks_per_frame + 1;
+    const long long chunks = (frames + options.chunk_frames - 1) / options.chunk_frames;
+    const int threads = static_cast<int>(std::max<long long>(1, std::min<long long>(options.threads, chunks)));
+
+    // the one pass that has to be in order: the board at the start of every chunk
+    std::vector<BoardState> checkpoints(chunks);
+    {
+      int height = replay.height;
+      int width = replay.width;
+      GameBoard board(height, width);
+      ReplayPlayer player(replay, board);
+      for (long long chunk = 0; chunk < chunks; ++chunk)
+      {
+        board.save_state(checkpoints[chunk]);
+        for (long long t = 0; t < static_cast<long long>(options.chunk_frames) * ticks_per_frame && !player.finished(); ++t)
+          player.step();
+      }
+    }
+
+    VideoStats stats;
+    std::string header = Rasterizer(replay, options).stream_header(options.fps);
+    std::fwrite(header.data(), 1, header.size(), out);
+    stats.bytes += header.size();
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Slot> slots(2 * threads);
+
+    // thread t does chunks t, t + threads, ... and a chunk's slot is the one the chunk 2 * threads
+    // before it had, so the writer only ever waits for the next chunk and a thread only for its own
+    auto render = [&](int thread)
+    {
+      int height = replay.height;
+      int width = replay.width;
+      GameBoard board(height, width);
+      ReplayPlayer player(replay, board);
+      Rasterizer rasterizer(replay, options);
+      BoardState state;
+      for (long long chunk = thread; chunk < chunks; chunk += threads)
+      {
+        Slot &slot = slots[chunk % slots.size()];
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          changed.wait(lock, [&]
+                       { return slot.chunk == -1; });
+          slot.chunk = chunk;
+        }
+
+        board.load_state(checkpoints[chunk]);
+        player.jump(chunk * options.chunk_frames * ticks_per_frame);
+        long long first = chunk * options.chunk_frames;
+        long long count = std::min<long long>(options.chunk_frames, frames - first);
+        slot.data.resize(count * rasterizer.frame_bytes());
+        for (long long frame = 0; frame < count; ++frame)
+        {
+          if (frame > 0)
+          {
+            for (int t = 0; t < ticks_per_frame; ++t)
+              player.step();
+          }
+          board.save_state(state);
+          rasterizer.draw(state, slot.data.data() + frame * rasterizer.frame_bytes());
+        }
+        slot.used = count * rasterizer.frame_bytes();
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          slot.ready = true;
+        }
+        changed.notify_all();
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+      workers.emplace_back(render, t);
+
+    for (long long chunk = 0; chunk < chunks; ++chunk)
+    {
+      Slot &slot = slots[chunk % slots.size()];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]
+                     { return slot.chunk == chunk && slot.ready; });
+      }
+      std::fwrite(slot.data.data(), 1, slot.used, out);
+      stats.bytes += slot.used;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.chunk = -1;
+        slot.ready = false;
+      }
+      changed.notify_all();
+    }
+    for (std::thread &worker : workers)
+      worker.join();
+    std::fflush(out);
+
+    stats.frames = frames;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+  }
+
+}
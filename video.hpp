@@ -0,0 +1,41 @@
+#ifndef VIDEO_HPP
+#define VIDEO_HPP
+#include <cstdio>
+#include "replay.hpp"
+
+namespace tetris
+{
+
+    enum class VideoFormat
+    {
+        Y4M, // YUV4MPEG2 4:4:4, what ffmpeg reads from a pipe without being told anything
+        PPM  // one binary PPM after another, for ffmpeg -f image2pipe -c:v ppm
+    };
+
+    struct VideoOptions
+    {
+        VideoFormat format = VideoFormat::Y4M;
+        int fps = 60;          // has to divide the replay's tick rate, 60 is a frame every tick
+        int cell = 20;         // pixels a block, the same as the window
+        int border = 2;        // the black edge around each block
+        int threads = 1;
+        int chunk_frames = 32; // frames a thread renders at a time
+    };
+
+    struct VideoStats
+    {
+        long long frames = 0;
+        long long bytes = 0;
+        double seconds = 0;
+    };
+
+    // Plays the replay back and writes a frame of it every tick_rate / fps ticks, drawn in software
+    // the way the window draws the board (no GPU, no window). The frames are cut into chunks and the
+    // threads take turns at them: one pass over the game first saves the board at the start of every
+    // chunk, so each chunk can start from there instead of from the beginning. Chunks are written out
+    // in order as they finish, at most two per thread are held in memory at once. Throws
+    // std::runtime_error for options that don't work with the replay
+    VideoStats export_video(const Replay &replay, const VideoOptions &options, std::FILE *out);
+
+}
+#endif // VIDEO_HPP